@@ -8,47 +8,79 @@
 
 #include <ctype.h>
 #include <errno.h>
+#include <limits.h>
 #include <pwd.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/time.h>
 #include <sys/wait.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
 #include "isocline/include/isocline.h"
 
+#include "utils/array.h"
 #include "utils/charlist.h"
 #include "utils/doublelist.h"
 #include "utils/ealloc.h"
+#include "utils/environment.h"
+#include "utils/eventloop.h"
 #include "utils/mathparser.h"
+#include "utils/pathglob.h"
+#include "utils/pathindex.h"
+#include "utils/profiler.h"
+#include "utils/prompt.h"
+#include "utils/resourcelimits.h"
 #include "utils/stringhashmap.h"
 #include "utils/stringlinkedlist.h"
+#include "utils/trace.h"
 #include "utils/utils.h"
 
 #define BACKGROUND_CHAR '&'
 #define COMMAND_BUFFER_SIZE 4096
 #define COMMENT_CHAR '#'
 #define CWD_BUFFER_SIZE 4096
+#define DEFAULT_PROMPT "\\s:\\e[1;34m\\w\\e[0m\\$ "
+#define DEFAULT_ROOT_PROMPT "\\e[38;5;196;1m\\s-root:\\e[1;34m\\w\\e[0m\\$ "
 #define EXIT_COMMAND "exit"
+#define GLOB_WILDCARDS "*?["
 #define HISTORY_COMMAND "history"
 #define HISTORY_FILE_NAME ".alsh_history"
 #define SHELL_NAME "alsh"
 #define STARTING_HISTORY_CAPACITY 25
 #define TEST_COMMAND "chk"
+#define TIMEOUT_DEFAULT_GRACE_MS 2000
 #define USERNAME_MAX_LENGTH 32
 #define VARIABLE_PREFIX '$'
 
+#define QUOTED_WILDCARDS "\x01\x02\x03" //Stand-ins for quoted GLOB_WILDCARDS until pathname expansion
+
 #define MATH_PARSER_ERR_MSG(status) MathParser_printErrMsg(status, SHELL_NAME)
 
 static StringHashMap *aliases; //Stores command aliases
+static ArrayMap *arrays; //Stores user-defined array variables
 static StringLinkedList *bgCmdDoneMessages; //Stores background command complete messages
+static char *builtinCommands[] = { //Names of the commands that executeCommand runs itself
+    "alias", "cd", "exec", EXIT_COMMAND, "export", "false",
+    HISTORY_COMMAND, "let", "parallel", "profile", "run", "source", TEST_COMMAND, "time", "timeout", "true"
+};
 static char cwd[CWD_BUFFER_SIZE]; //Current working directory
+static unsigned long cwdVersion = 0; //Incremented whenever cwd is updated
+static ResourceLimits *defaultLimits = NULL; //Limits of every external command, set by run without a command
+static Environment *environment; //Environment variables, mirrored from environ at startup
+static EventLoop *eventLoop = NULL; //Waits for child processes and timers in an interactive shell, NULL if unsupported
 static char *executablePath; //Path to where the current alsh shell executable is
 static bool isBackgroundCmd = false; //Did the user run a command in the background?
+static struct rusage lastChildUsage; //Resources used by the last child that waitForChild reaped
+static int lastExitStatus = 0; //Exit status of the last command run from the prompt
 static int numBackgroundCmds = 0; //Number of background commands running
+static PathIndex *pathIndex; //Index of the commands in PATH for syntax highlighting
+static Prompt *prompt; //Compiled prompt template
 static struct passwd *pwd; //User info
 static bool testCmdNotExist = false; //Does the '[' command exist?
 static bool testCmdNotExistIsSet = false; //Is testCmdNotExist set yet?
@@ -56,23 +88,33 @@ static StringHashMap *variables; //Stores user-defined variables
 
 extern char **environ;
 
-char* getHomeDirectory(void) {
-    return pwd != NULL ? pwd->pw_dir : getenv("HOME");
+/**
+ * Points environ at the envp array of the environment mirror, which is
+ * only rebuilt if a variable was exported or removed since the last call
+ * Must be called before starting a new process
+*/
+void syncEnvironment(void) {
+    environ = Environment_envp(environment);
 }
-bool isInHomeDirectory(void) {
-    char *cwdPtr = cwd;
-    char *homeDirPtr = getHomeDirectory();
-    while (*homeDirPtr) {
-        if (*cwdPtr++ != *homeDirPtr++) {
-            return false;
-        }
-    }
-    return true;
+
+char* getHomeDirectory(void) {
+    return pwd != NULL ? pwd->pw_dir : Environment_get(environment, "HOME");
 }
 bool isRootUser(void) {
     return getuid() == 0;
 }
 
+/**
+ * Updates cwd to the current working directory
+ * Must be called whenever the working directory of the shell changes
+*/
+void updateCwd(void) {
+    if (getcwd(cwd, CWD_BUFFER_SIZE) == NULL) {
+        cwd[0] = '\0';
+    }
+    cwdVersion++;
+}
+
 typedef struct History {
     char **elements;
     int count;
@@ -87,26 +129,39 @@ void clearHistoryElements(void) {
     history.count = 0;
 }
 
+static bool jobPoolRunning = false;
 static bool sigintReceived = false;
 static bool sigchldReceived = false;
 static int numSigchldBackground = 0;
+
+/**
+ * Stores the complete message of the background command with the given pid
+ * in bgCmdDoneMessages and updates the number of background commands running
+*/
+void addBgCmdDoneMessage(pid_t cid) {
+    numSigchldBackground++;
+    size_t templateStrLen = strlen("[%d]+ Done with pid %d");
+    size_t numSigchldBackgroundLen = (size_t) numDigits(numSigchldBackground);
+    size_t cidLen = (size_t) numDigits(cid);
+    char *buffer = emalloc(sizeof(char) * (templateStrLen + numSigchldBackgroundLen + cidLen));
+    sprintf(buffer, "[%d]+ Done with pid %d", numSigchldBackground, cid);
+    StringLinkedList_append(bgCmdDoneMessages, buffer, true);
+    numBackgroundCmds--;
+    if (numBackgroundCmds == 0) {
+        isBackgroundCmd = false;
+        numSigchldBackground = 0;
+    }
+}
+
 void sigchldHandler(int sig) {
     (void) sig;
-    if (sigintReceived) return;
+    //A running job pool reaps its own children
+    if (sigintReceived || jobPoolRunning) return;
     sigchldReceived = true;
     if (isBackgroundCmd) {
         if (numBackgroundCmds > 0) {
-            numSigchldBackground++;
-            pid_t cid = wait(NULL);
-            size_t templateStrLen = strlen("[%d]+ Done with pid %d");
-            size_t numSigchldBackgroundLen = (size_t) numDigits(numSigchldBackground);
-            size_t cidLen = (size_t) numDigits(cid);
-            char *buffer = emalloc(sizeof(char) * (templateStrLen + numSigchldBackgroundLen + cidLen));
-            sprintf(buffer, "[%d]+ Done with pid %d", numSigchldBackground, cid);
-            StringLinkedList_append(bgCmdDoneMessages, buffer, true);
-            numBackgroundCmds--;
-        }
-        if (numBackgroundCmds == 0) {
+            addBgCmdDoneMessage(wait(NULL));
+        } else {
             isBackgroundCmd = false;
             numSigchldBackground = 0;
         }
@@ -116,6 +171,10 @@ void sigchldHandler(int sig) {
 void sigintHandler(int sig) {
     (void) sig;
     sigintReceived = true;
+    //Children are waited for by whoever started them
+    if (jobPoolRunning || eventLoop != NULL) {
+        return;
+    }
     if (numBackgroundCmds > 0) {
         while (wait(NULL) > 0) {
             numBackgroundCmds--;
@@ -139,12 +198,172 @@ void printBgCmdDoneMessageIfExists(void) {
     }
 }
 
+/**
+ * Handles an event of the event loop that nobody is waiting for,
+ * which is a background command that finished
+*/
+void handleEvent(Event *event) {
+    if (event->type == EVENT_CHILD && traceEnabled) {
+        Trace_childExited(event->pid, event->status);
+    }
+    if (event->type == EVENT_CHILD && numBackgroundCmds > 0) {
+        addBgCmdDoneMessage(event->pid);
+    }
+}
+
+/**
+ * Called by ic_readline when the event loop has events while the user
+ * is typing, so background commands are reported as soon as they finish
+*/
+void handleInputEvent(void *arg) {
+    (void) arg;
+    Event event;
+    while (EventLoop_wait(eventLoop, 0, &event)) {
+        handleEvent(&event);
+    }
+    printBgCmdDoneMessageIfExists();
+}
+
+/**
+ * Waits for the child process cid to exit, handling the events of other children in the meantime
+ *
+ * Returns the status of the child as returned by waitpid
+*/
+int waitForChild(pid_t cid) {
+    TRACE_BEGIN(waitStart);
+    int status = 0;
+    if (eventLoop != NULL && EventLoop_watchChild(eventLoop, cid)) {
+        Event event;
+        while (true) {
+            if (!EventLoop_wait(eventLoop, -1, &event)) {
+                continue; //Interrupted by a signal
+            }
+            if (event.type == EVENT_CHILD && event.pid == cid) {
+                lastChildUsage = event.usage;
+                status = event.status;
+                break;
+            }
+            handleEvent(&event);
+        }
+    } else {
+        //Other children, like the commands of a timed pipeline, can still be running
+        while (wait4(cid, &status, 0, &lastChildUsage) > 0);
+    }
+    if (waitStart != 0) {
+        Trace_span("wait", NULL, waitStart);
+        Trace_childExited(cid, status);
+    }
+    return status;
+}
+
+/**
+ * Waits for the child process cid like waitForChild, but sends it SIGTERM once timeoutMs
+ * milliseconds have passed, and SIGKILL if it is still running graceMs milliseconds after that
+ * Sets timedOut to whether the child had to be sent SIGTERM
+ *
+ * Returns the status of the child as returned by waitpid
+*/
+int waitForChildWithTimeout(pid_t cid, long timeoutMs, long graceMs, bool *timedOut) {
+    TRACE_BEGIN(waitStart);
+    *timedOut = false;
+    int status = 0;
+    EventLoop *loop = eventLoop != NULL ? eventLoop : EventLoop_create();
+    int timer = loop != NULL ? EventLoop_addTimer(loop, timeoutMs) : -1;
+    if (timer >= 0 && EventLoop_watchChild(loop, cid)) {
+        Event event;
+        while (true) {
+            if (!EventLoop_wait(loop, -1, &event)) {
+                continue; //Interrupted by a signal
+            }
+            if (event.type == EVENT_CHILD && event.pid == cid) {
+                status = event.status;
+                lastChildUsage = event.usage;
+                break;
+            }
+            if (event.type == EVENT_TIMER && event.id == timer) {
+                kill(cid, *timedOut ? SIGKILL : SIGTERM);
+                timer = *timedOut ? -1 : EventLoop_addTimer(loop, graceMs);
+                *timedOut = true;
+                continue;
+            }
+            handleEvent(&event);
+        }
+        EventLoop_removeTimer(loop, timer);
+    } else {
+        //Without an event loop, check on the child every few milliseconds
+        if (loop != NULL) {
+            EventLoop_removeTimer(loop, timer);
+        }
+        struct timespec startTime;
+        clock_gettime(CLOCK_MONOTONIC, &startTime);
+        struct timespec interval = {0, 5000000};
+        while (wait4(cid, &status, WNOHANG, &lastChildUsage) == 0) {
+            double elapsedMs = secondsSince(&startTime) * 1000;
+            if (!*timedOut && elapsedMs >= (double) timeoutMs) {
+                kill(cid, SIGTERM);
+                *timedOut = true;
+            } else if (*timedOut && graceMs >= 0 && elapsedMs >= (double) (timeoutMs + graceMs)) {
+                kill(cid, SIGKILL);
+                graceMs = -1;
+            }
+            nanosleep(&interval, NULL);
+        }
+    }
+    if (loop != NULL && loop != eventLoop) {
+        EventLoop_free(loop);
+    }
+    if (waitStart != 0) {
+        Trace_span("wait", NULL, waitStart);
+        Trace_childExited(cid, status);
+    }
+    return status;
+}
+
+/**
+ * Parses a duration like 10, 0.5s, 2m, 1h or 1d into milliseconds
+ *
+ * Returns false if str is not a valid duration
+*/
+bool parseDuration(char *str, long *ms) {
+    char *end;
+    double duration = strtod(str, &end);
+    if (end == str || !(duration >= 0)) {
+        return false;
+    }
+    switch (*end) {
+        case 'd':
+            duration *= 24;
+            //fall through
+        case 'h':
+            duration *= 60;
+            //fall through
+        case 'm':
+            duration *= 60;
+            //fall through
+        case 's':
+        case '\0':
+            break;
+        default:
+            return false;
+    }
+    if (*end && end[1]) {
+        return false;
+    }
+    duration *= 1000;
+    if (duration > (double) LONG_MAX) {
+        return false;
+    }
+    *ms = (long) duration;
+    return true;
+}
+
 /**
  * Splits a string from the first occurrence of delim and returns a StringLinkedList
  * pointer that refers to the first node of the StringLinkedList
+ * The quotes around quoted text are removed unless keepQuotes is true
  * Remember to free() the returned StringLinkedList
 */
-StringLinkedList* split(char *str, char *delim, int *status) {
+StringLinkedList* splitWithQuotes(char *str, char *delim, int *status, bool keepQuotes) {
     StringLinkedList *tokens = StringLinkedList_create();
     CharList *strList = CharList_create();
     size_t delimLen = strlen(delim);
@@ -196,12 +415,12 @@ StringLinkedList* split(char *str, char *delim, int *status) {
 
                 switch (*tempStr) {
                     case '"':
-                        if (inSingleQuote || parenthesesNestLevel > 0) {
+                        if (keepQuotes || inSingleQuote || parenthesesNestLevel > 0) {
                             CharList_add(strList, *tempStr);
                         }
                         break;
                     case '\'':
-                        if (inDoubleQuote || parenthesesNestLevel > 0) {
+                        if (keepQuotes || inDoubleQuote || parenthesesNestLevel > 0) {
                             CharList_add(strList, *tempStr);
                         }
                         break;
@@ -265,12 +484,12 @@ StringLinkedList* split(char *str, char *delim, int *status) {
 
         switch (*tempStr) {
             case '"':
-                if (inSingleQuote || parenthesesNestLevel > 0) {
+                if (keepQuotes || inSingleQuote || parenthesesNestLevel > 0) {
                     CharList_add(strList, *tempStr);
                 }
                 break;
             case '\'':
-                if (inDoubleQuote || parenthesesNestLevel > 0) {
+                if (keepQuotes || inDoubleQuote || parenthesesNestLevel > 0) {
                     CharList_add(strList, *tempStr);
                 }
                 break;
@@ -288,19 +507,50 @@ StringLinkedList* split(char *str, char *delim, int *status) {
     return tokens;
 }
 
+StringLinkedList* split(char *str, char *delim, int *status) {
+    return splitWithQuotes(str, delim, status, false);
+}
+
+/**
+ * Splits a command line on an operator like ;, && or |, keeping the quotes
+ * so that each command is quoted the same way when it is executed
+*/
+StringLinkedList* splitCommands(char *str, char *delim, int *status) {
+    return splitWithQuotes(str, delim, status, true);
+}
+
 /**
  * Executes a function specified by the processLine function pointer
  * on each line from the file referred to by fp
+ * fileName is used to name the lines of the file when profiling
  *
  * Returns the status of the last command executed from the file
 */
-int processFile(char *cmd, FILE *fp, int (*processLine)(char*), bool closefp) {
+int processFile(char *cmd, FILE *fp, const char *fileName, int (*processLine)(char*), bool closefp) {
     int status = 0;
+    int lineNum = 0;
     while (fgets(cmd, COMMAND_BUFFER_SIZE, fp) != NULL) {
+        lineNum++;
         removeNewlineIfExists(cmd);
         bool trimSuccess = trimWhitespaceFromEnds(cmd);
         if (*cmd && *cmd != COMMENT_CHAR && trimSuccess) {
+            //Moves the file offset back to the end of this line, since a forked child that exits does the same
+            //to the offset it shares with the shell, which would make the lines read ahead get read again
+            fflush(fp);
+            TRACE_BEGIN(lineStart);
+            bool profiled = profileEnabled;
+            if (profiled) Profiler_begin();
+            char *line = lineStart != 0 || profiled ? strdup(cmd) : NULL;
             status = processLine(cmd);
+            if (profiled) {
+                char lineName[CWD_BUFFER_SIZE + 16];
+                snprintf(lineName, sizeof(lineName), "%s:%d", fileName, lineNum);
+                Profiler_end(PROFILE_LINE, lineName, line);
+            }
+            if (lineStart != 0) {
+                Trace_span("line", line, lineStart);
+            }
+            free(line);
         }
     }
     if (closefp) fclose(fp);
@@ -475,11 +725,607 @@ int* handleRedirectStdin(char *cmd) {
 int processCommand(char *cmd);
 char* processMathExpressions(char *cmd, bool *seenOtherChr);
 char* processVariables(char *cmd, bool *hasUndefinedVars);
+
+/**
+ * Removes the shell or environment variable name, which is about to be redefined as an array
+*/
+void removeScalarVariable(char *name) {
+    if (variables != NULL) {
+        StringHashMap_remove(variables, name);
+    }
+    Environment_unset(environment, name);
+}
+
+/**
+ * Defines the shell variable name like let does, replacing
+ * an environment variable or array with the same name
+*/
+void setVariable(char *name, char *value) {
+    if (variables == NULL) {
+        variables = StringHashMap_create();
+    }
+    bool replacing = StringHashMap_get(variables, name) != NULL;
+    StringHashMap_put(variables, replacing ? name : strdup(name), !replacing, strdup(value), true);
+    Environment_unset(environment, name);
+    if (arrays != NULL) {
+        ArrayMap_remove(arrays, name);
+    }
+}
+
+/**
+ * Returns the opening parenthesis of the list in a name=(...) argument of let,
+ * or NULL if arg is not an array assignment
+ *
+ * The list is a math expression instead if it only contains numbers and operators
+ * and no two operands are separated by nothing but spaces, so let a=(1 + 2) still sets a to 3
+*/
+char* getArrayLiteral(char *arg) {
+    char *equalsSign = strchr(arg, '=');
+    if (
+        equalsSign == NULL
+        || equalsSign == arg
+        || equalsSign[1] != '('
+        || memchr(arg, '[', (size_t) (equalsSign - arg)) != NULL
+    ) {
+        return NULL;
+    }
+    char *list = equalsSign + 1;
+    char *listEnd = list + strlen(list) - 1;
+    if (*listEnd != ')') {
+        return NULL;
+    }
+
+    char prevChr = '(';
+    bool afterSpace = false;
+    for (char *listPtr = list + 1; listPtr < listEnd; listPtr++) {
+        if (*listPtr == ' ') {
+            afterSpace = true;
+            continue;
+        }
+        bool isMathChr = isdigit(*listPtr) || *listPtr == '.' || *listPtr == '('
+            || *listPtr == ')' || MathParser_isAnyOperator(*listPtr);
+        bool prevIsOperand = prevChr != '(' && !MathParser_isAnyOperator(prevChr);
+        bool isOperand = *listPtr != ')' && !MathParser_isAnyOperator(*listPtr);
+        if (!isMathChr || (afterSpace && prevIsOperand && isOperand)) {
+            return list;
+        }
+        prevChr = *listPtr;
+        afterSpace = false;
+    }
+
+    //() is an empty array
+    return prevChr == '(' ? list : NULL;
+}
+
+/**
+ * Replaces the variable name with an array of the elements in list, which is
+ * either (element ...) or ([key]=value ...) for an associative array
+ *
+ * Returns 0 on success, 1 on error
+*/
+int assignArray(char *name, char *list) {
+    char *elements = strdup(list + 1);
+    elements[strlen(elements) - 1] = '\0';
+    int splitStatus = 1;
+    StringLinkedList *elementList = trimWhitespaceFromEnds(elements)
+        ? split(elements, " ", &splitStatus)
+        : StringLinkedList_create();
+    if (splitStatus == -1) {
+        StringLinkedList_free(elementList);
+        free(elements);
+        return 1;
+    }
+
+    bool associative = elementList->head != NULL && *elementList->head->str == '[';
+    Array *array = Array_create(associative);
+    for (StringNode *temp = elementList->head; temp != NULL; temp = temp->next) {
+        if (!associative) {
+            Array_append(array, temp->str);
+            continue;
+        }
+
+        char *keyEnd = strstr(temp->str, "]=");
+        if (*temp->str != '[' || keyEnd == NULL) {
+            fprintf(stderr, "%s: let: %s: expected [key]=value in associative array\n", SHELL_NAME, temp->str);
+            Array_free(array);
+            StringLinkedList_free(elementList);
+            free(elements);
+            return 1;
+        }
+        *keyEnd = '\0';
+        Array_setKey(array, temp->str + 1, keyEnd + 2);
+    }
+    StringLinkedList_free(elementList);
+    free(elements);
+
+    if (arrays == NULL) {
+        arrays = ArrayMap_create();
+    }
+    ArrayMap_put(arrays, name, array);
+    removeScalarVariable(name);
+    return 0;
+}
+
+/**
+ * Sets the element at subscript of the array name, creating the array if it doesn't exist
+ * A new array is indexed if subscript is an integer and associative otherwise,
+ * and a negative index counts from the end of an indexed array
+ *
+ * Returns 0 on success, 1 on error
+*/
+int assignArrayElement(char *name, char *subscript, char *value) {
+    Array *array = arrays != NULL ? ArrayMap_get(arrays, name) : NULL;
+    char *endPtr;
+    long index = strtol(subscript, &endPtr, 10);
+    bool isIndex = *subscript && !*endPtr;
+    if (array != NULL && Array_isAssociative(array)) {
+        Array_setKey(array, subscript, value);
+        return 0;
+    }
+
+    if (isIndex && index < 0 && array != NULL) {
+        index += Array_size(array);
+    }
+    if (!*subscript || (array != NULL && !isIndex) || index < 0 || index >= INT_MAX) {
+        fprintf(stderr, "%s: let: %s: bad array subscript\n", SHELL_NAME, subscript);
+        return 1;
+    }
+    if (array == NULL) {
+        array = Array_create(!isIndex);
+        if (arrays == NULL) {
+            arrays = ArrayMap_create();
+        }
+        ArrayMap_put(arrays, name, array);
+        removeScalarVariable(name);
+    }
+
+    if (isIndex) {
+        Array_set(array, (int) index, value);
+    } else {
+        Array_setKey(array, subscript, value);
+    }
+    return 0;
+}
+
+/**
+ * Returns the element of array at subscript, which may refer to
+ * other variables, or NULL if there is no such element
+*/
+char* getArrayElement(Array *array, char *subscript) {
+    char *expandedSubscript = processVariables(subscript, NULL);
+    if (expandedSubscript == NULL) {
+        return NULL;
+    }
+
+    char *value;
+    if (Array_isAssociative(array)) {
+        value = Array_getKey(array, expandedSubscript);
+    } else {
+        char *endPtr;
+        long index = strtol(expandedSubscript, &endPtr, 10);
+        if (index < 0) {
+            index += Array_size(array);
+        }
+        bool isIndex = *expandedSubscript && !*endPtr && index >= 0 && index < INT_MAX;
+        value = isIndex ? Array_get(array, (int) index) : NULL;
+    }
+
+    if (expandedSubscript != subscript) {
+        free(expandedSubscript);
+    }
+    return value;
+}
+
+/**
+ * Returns the value of name[subscript] if name is an array, or all of its
+ * elements separated by spaces if there is no subscript
+ * Returns NULL if there is no such array or element
+*/
+char* getArrayVariable(char *name) {
+    char *subscript = strchr(name, '[');
+    if (subscript == NULL) {
+        Array *array = ArrayMap_get(arrays, name);
+        return array != NULL ? Array_join(array) : NULL;
+    }
+
+    char *subscriptEnd = strrchr(subscript, ']');
+    if (subscriptEnd == NULL || subscriptEnd[1]) {
+        return NULL;
+    }
+    *subscript = '\0';
+    Array *array = ArrayMap_get(arrays, name);
+    *subscript = '[';
+    if (array == NULL) {
+        return NULL;
+    }
+
+    *subscriptEnd = '\0';
+    char *value = getArrayElement(array, subscript + 1);
+    *subscriptEnd = ']';
+    return value;
+}
+/**
+ * Replaces the wildcards in quoted text in str with stand-ins, like executeCommand
+ * does for a command, so that pathname expansion leaves them alone
+*/
+void markQuotedWildcards(char *str) {
+    bool inSingleQuote = false;
+    bool inDoubleQuote = false;
+    for (char *strPtr = str; *strPtr; strPtr++) {
+        char *wildcard;
+        if (*strPtr == '\'' && !inDoubleQuote) {
+            inSingleQuote = !inSingleQuote;
+        } else if (*strPtr == '"' && !inSingleQuote) {
+            inDoubleQuote = !inDoubleQuote;
+        } else if ((inSingleQuote || inDoubleQuote) && (wildcard = strchr(GLOB_WILDCARDS, *strPtr)) != NULL) {
+            *strPtr = QUOTED_WILDCARDS[wildcard - GLOB_WILDCARDS];
+        }
+    }
+}
+
+/**
+ * Turns the stand-ins for quoted wildcards in word back into the wildcards
+*/
+void restoreQuotedWildcards(char *word) {
+    for (char *wordPtr = word; (wordPtr = strpbrk(wordPtr, QUOTED_WILDCARDS)) != NULL; wordPtr++) {
+        *wordPtr = GLOB_WILDCARDS[strchr(QUOTED_WILDCARDS, *wordPtr) - QUOTED_WILDCARDS];
+    }
+}
+
+/**
+ * Replaces the word in node with the paths it matches if it has unquoted wildcards,
+ * keeping the word if nothing matches; quoted wildcards only match themselves
+ *
+ * Returns the node of the last path, or node itself if the word was kept
+*/
+StringNode* expandPathname(StringLinkedList *tokens, StringNode *node) {
+    char *word = node->str;
+    if (strpbrk(word, GLOB_WILDCARDS) == NULL || strchr(word, '(') != NULL) {
+        restoreQuotedWildcards(word);
+        return node;
+    }
+
+    CharList *pattern = CharList_create();
+    for (char *wordPtr = word; *wordPtr; wordPtr++) {
+        char *quotedWildcard = strchr(QUOTED_WILDCARDS, *wordPtr);
+        if (quotedWildcard != NULL || *wordPtr == '\\') {
+            CharList_add(pattern, '\\');
+        }
+        CharList_add(pattern, quotedWildcard != NULL ? GLOB_WILDCARDS[quotedWildcard - QUOTED_WILDCARDS] : *wordPtr);
+    }
+    restoreQuotedWildcards(word);
+    char *patternStr = CharList_toStr(pattern);
+    CharList_free(pattern);
+    int numMatches = 0;
+    char **matches = PathGlob_hasWildcards(patternStr) ? PathGlob_expand(patternStr, &numMatches) : NULL;
+    free(patternStr);
+    if (matches == NULL) {
+        return node;
+    }
+
+    if (node->strMustBeFreed) {
+        free(node->str);
+    }
+    node->str = matches[0];
+    node->strMustBeFreed = true;
+    for (int i = 1; i < numMatches; i++) {
+        node = StringLinkedList_insertAfter(tokens, node, matches[i], true);
+    }
+    free(matches);
+    return node;
+}
+
+typedef struct Job {
+    pid_t pid;
+    int status;
+    bool done;
+    FILE *out; //Captured stdout and stderr of the job if the output is kept in order
+    FILE *err;
+} Job;
+
+/**
+ * Copies the rest of the captured output in from to the stream to and closes from
+*/
+void copyJobOutput(FILE *from, FILE *to) {
+    if (from == NULL) {
+        return;
+    }
+    char buffer[COMMAND_BUFFER_SIZE];
+    size_t bytesRead;
+    rewind(from);
+    while ((bytesRead = fread(buffer, sizeof(char), sizeof(buffer), from)) > 0) {
+        fwrite(buffer, sizeof(char), bytesRead, to);
+    }
+    fflush(to);
+    fclose(from);
+}
+
+/**
+ * Runs each command in its own child process, with at most maxJobs of them running at once
+ * If keepOrder is true, the output of each command is captured and printed in the order
+ * of the commands once it finishes, otherwise the outputs are interleaved as they are written
+ * If stdinFromNull is true, the commands read from /dev/null instead of the shell's stdin
+ * No more commands are started after SIGINT is received
+ *
+ * Returns the number of commands that failed or weren't run, up to 255
+*/
+int runJobPool(char **commands, int numCommands, int maxJobs, bool keepOrder, bool stdinFromNull) {
+    Job *jobs = ecalloc((size_t) numCommands, sizeof(Job));
+    int *slots = emalloc(sizeof(int) * (size_t) maxJobs); //Index of the job running in each slot
+    for (int i = 0; i < maxJobs; i++) {
+        slots[i] = -1;
+    }
+
+    jobPoolRunning = true;
+    int nextJob = 0;
+    int nextOutput = 0;
+    int numRunning = 0;
+    int numFailed = 0;
+    while (true) {
+        while (nextJob < numCommands && numRunning < maxJobs && !sigintReceived) {
+            Job *job = &jobs[nextJob];
+            if (keepOrder && (
+                (job->out == NULL && (job->out = tmpfile()) == NULL)
+                || (job->err == NULL && (job->err = tmpfile()) == NULL)
+            )) {
+                fprintf(stderr, "%s: Failed to create output file for command \"%s\"\n", SHELL_NAME, commands[nextJob]);
+                break;
+            }
+            fflush(stdout);
+            fflush(stderr);
+            job->pid = fork();
+            if (job->pid < 0) {
+                //Should not happen
+                fprintf(stderr, "%s: Failed to spawn child process for command \"%s\"\n", SHELL_NAME, commands[nextJob]);
+                break;
+            }
+            if (job->pid == 0) {
+                signal(SIGINT, SIG_DFL);
+                signal(SIGCHLD, SIG_DFL);
+                jobPoolRunning = false;
+                eventLoop = NULL; //The epoll instance is shared with the shell
+                isBackgroundCmd = false;
+                numBackgroundCmds = 0;
+                if (stdinFromNull && freopen("/dev/null", "r", stdin) == NULL) {
+                    exit(1);
+                }
+                if (keepOrder) {
+                    dup2(fileno(job->out), STDOUT_FILENO);
+                    dup2(fileno(job->err), STDERR_FILENO);
+                }
+                char *command = strdup(commands[nextJob]);
+                int status = processCommand(command);
+                fflush(stdout);
+                fflush(stderr);
+                exit(status < 0 ? 1 : status);
+            }
+            if (traceEnabled) {
+                Trace_childStarted(job->pid, commands[nextJob]);
+            }
+            if (eventLoop != NULL && !EventLoop_watchChild(eventLoop, job->pid)) {
+                //Should not happen, but the event loop would never report this job, so wait for it right away
+                int status = waitForChild(job->pid);
+                job->status = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+                job->done = true;
+                nextJob++;
+                continue;
+            }
+            for (int i = 0; i < maxJobs; i++) {
+                if (slots[i] == -1) {
+                    slots[i] = nextJob;
+                    break;
+                }
+            }
+            nextJob++;
+            numRunning++;
+        }
+
+        for (; nextOutput < nextJob && jobs[nextOutput].done; nextOutput++) {
+            if (jobs[nextOutput].status != 0) {
+                numFailed++;
+            }
+            copyJobOutput(jobs[nextOutput].out, stdout);
+            copyJobOutput(jobs[nextOutput].err, stderr);
+        }
+        if (numRunning == 0) {
+            break;
+        }
+
+        int status;
+        pid_t cid;
+        if (eventLoop != NULL) {
+            Event event;
+            if (!EventLoop_wait(eventLoop, -1, &event)) {
+                continue; //Interrupted by a signal
+            }
+            if (event.type != EVENT_CHILD) {
+                handleEvent(&event);
+                continue;
+            }
+            cid = event.pid;
+            status = event.status;
+        } else {
+            cid = waitpid(-1, &status, 0);
+        }
+        if (cid < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            //Should not happen, but the running jobs can't be waited for anymore
+            for (int i = 0; i < maxJobs; i++) {
+                if (slots[i] != -1) {
+                    jobs[slots[i]].status = 1;
+                    jobs[slots[i]].done = true;
+                    slots[i] = -1;
+                }
+            }
+            numRunning = 0;
+        } else {
+            int slot = 0;
+            while (slot < maxJobs && (slots[slot] == -1 || jobs[slots[slot]].pid != cid)) {
+                slot++;
+            }
+            if (slot == maxJobs) {
+                //Background command that finished while the jobs were running
+                if (numBackgroundCmds > 0) {
+                    addBgCmdDoneMessage(cid);
+                }
+                continue;
+            }
+            if (traceEnabled) {
+                Trace_childExited(cid, status);
+            }
+            Job *job = &jobs[slots[slot]];
+            job->status = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+            job->done = true;
+            slots[slot] = -1;
+            numRunning--;
+        }
+    }
+    jobPoolRunning = false;
+
+    //Jobs that were never started count as failed
+    for (int i = nextJob; i < numCommands; i++) {
+        if (jobs[i].out != NULL) fclose(jobs[i].out);
+        if (jobs[i].err != NULL) fclose(jobs[i].err);
+    }
+    numFailed += numCommands - nextJob;
+    free(jobs);
+    free(slots);
+    return numFailed < 255 ? numFailed : 255;
+}
+
+/**
+ * Appends word to list, surrounded with quotes if it is empty or contains whitespace
+ * so that it is still a single word when the command is split again
+*/
+void addQuotedWord(CharList *list, char *word) {
+    if (*word && strpbrk(word, " \t") == NULL) {
+        CharList_addStr(list, word);
+        return;
+    }
+    char quote = strchr(word, '"') != NULL ? '\'' : '"';
+    CharList_add(list, quote);
+    CharList_addStr(list, word);
+    CharList_add(list, quote);
+}
+
+/**
+ * Runs the parallel builtin with the arguments starting at argNode
+ * Syntax: parallel [-j <jobs>] [-k] <command> [::: <item> ...]
+ * The command is run once for each item, with the item in place of {} in the command,
+ * or after the command if it doesn't contain {}
+ * If ::: is not given, each line of stdin is an item and the commands read from /dev/null
+ *
+ * Returns the number of commands that failed, up to 255
+*/
+int runParallel(StringNode *argNode) {
+    long numProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+    int maxJobs = numProcessors > 0 ? (int) numProcessors : 1;
+    bool keepOrder = false;
+    for (; argNode != NULL && *argNode->str == '-'; argNode = argNode->next) {
+        char *option = argNode->str;
+        if (strcmp(option, "--") == 0) {
+            argNode = argNode->next;
+            break;
+        } else if (strcmp(option, "-k") == 0) {
+            keepOrder = true;
+        } else if (strncmp(option, "-j", 2) == 0) {
+            char *jobs = option[2] ? option + 2 : NULL;
+            if (jobs == NULL && argNode->next != NULL) {
+                argNode = argNode->next;
+                jobs = argNode->str;
+            }
+            char *jobsEnd = NULL;
+            long numJobs = jobs != NULL ? strtol(jobs, &jobsEnd, 10) : 0;
+            if (jobs == NULL || *jobsEnd || numJobs <= 0 || numJobs > INT_MAX) {
+                fprintf(stderr, "%s: parallel: %s: invalid number of jobs\n", SHELL_NAME, jobs != NULL ? jobs : option);
+                return 1;
+            }
+            maxJobs = (int) numJobs;
+        } else {
+            fprintf(stderr, "%s: parallel: %s: invalid option\n", SHELL_NAME, option);
+            return 1;
+        }
+    }
+    if (argNode == NULL || strcmp(argNode->str, ":::") == 0) {
+        fprintf(stderr, "%s: parallel: command argument required\n", SHELL_NAME);
+        return 1;
+    }
+
+    //A command given as a single word, like 'echo {} | wc -c', is a whole command line
+    CharList *commandList = CharList_create();
+    bool isCommandLine = argNode->next == NULL || strcmp(argNode->next->str, ":::") == 0;
+    for (; argNode != NULL && strcmp(argNode->str, ":::") != 0; argNode = argNode->next) {
+        if (commandList->size > 0) {
+            CharList_add(commandList, ' ');
+        }
+        if (isCommandLine) {
+            CharList_addStr(commandList, argNode->str);
+        } else {
+            addQuotedWord(commandList, argNode->str);
+        }
+    }
+    char *command = CharList_toStr(commandList);
+    CharList_free(commandList);
+
+    StringLinkedList *items = StringLinkedList_create();
+    bool itemsFromStdin = argNode == NULL;
+    if (itemsFromStdin) {
+        //Read from a duplicate of the descriptor, since the stdin stream may have buffered input of its own
+        FILE *fp = fdopen(dup(STDIN_FILENO), "r");
+        if (fp != NULL) {
+            char line[COMMAND_BUFFER_SIZE];
+            while (fgets(line, COMMAND_BUFFER_SIZE, fp) != NULL) {
+                removeNewlineIfExists(line);
+                StringLinkedList_append(items, strdup(line), true);
+            }
+            fclose(fp);
+        }
+    } else {
+        for (argNode = argNode->next; argNode != NULL; argNode = argNode->next) {
+            StringLinkedList_append(items, argNode->str, false);
+        }
+    }
+
+    char *placeholder = strstr(command, "{}");
+    char **commands = emalloc(sizeof(char*) * (size_t) (items->size + 1));
+    int numCommands = 0;
+    for (StringNode *temp = items->head; temp != NULL; temp = temp->next) {
+        CharList *itemCommand = CharList_create();
+        char *commandPtr = command;
+        if (placeholder == NULL) {
+            CharList_addStr(itemCommand, command);
+            CharList_add(itemCommand, ' ');
+            addQuotedWord(itemCommand, temp->str);
+        } else {
+            for (char *nextPlaceholder; (nextPlaceholder = strstr(commandPtr, "{}")) != NULL; commandPtr = nextPlaceholder + 2) {
+                CharList_addStrN(itemCommand, commandPtr, (int) (nextPlaceholder - commandPtr));
+                addQuotedWord(itemCommand, temp->str);
+            }
+            CharList_addStr(itemCommand, commandPtr);
+        }
+        commands[numCommands++] = CharList_toStr(itemCommand);
+        CharList_free(itemCommand);
+    }
+
+    int status = numCommands > 0 ? runJobPool(commands, numCommands, maxJobs, keepOrder, itemsFromStdin) : 0;
+    for (int i = 0; i < numCommands; i++) {
+        free(commands[i]);
+    }
+    free(commands);
+    free(command);
+    StringLinkedList_free(items);
+    return status;
+}
+
 int executeCommand(char *cmd, bool waitForCommand) {
     char *processVarCmd = NULL;
+    TRACE_BEGIN(processVariablesStart);
     if (cmd == NULL || !*cmd || (processVarCmd = processVariables(cmd, NULL)) == NULL) {
         return 1;
     }
+    TRACE_END(processVariablesStart, "processVariables", cmd);
 
     char *originalCmd = cmd;
     bool processedVars = processVarCmd != originalCmd;
@@ -570,15 +1416,25 @@ int executeCommand(char *cmd, bool waitForCommand) {
                 }
                 break;
             }
-            default:
-                CharList_add(tempCmd, *cmdPtr++);
+            default: {
+                //Quoted wildcards are replaced so that pathname expansion leaves them alone
+                char *wildcard = strchr(GLOB_WILDCARDS, *cmdPtr);
+                if (wildcard != NULL && (inSingleQuote || inDoubleQuote) && !inParentheses) {
+                    CharList_add(tempCmd, QUOTED_WILDCARDS[wildcard - GLOB_WILDCARDS]);
+                    cmdPtr++;
+                } else {
+                    CharList_add(tempCmd, *cmdPtr++);
+                }
                 break;
+            }
         }
         cmdIndex++;
     }
 
     int tokensStatus = 1;
+    TRACE_BEGIN(splitStart);
     StringLinkedList *tokens = split(tempCmd->data, " ", &tokensStatus);
+    TRACE_END(splitStart, "split", cmd);
     if (tokens->size == 0) {
         if (*stdinStatus) {
             dup2(stdinStatus[1], STDIN_FILENO);
@@ -597,7 +1453,9 @@ int executeCommand(char *cmd, bool waitForCommand) {
     }
 
     bool isBuiltInCommand = false;
+    bool isLetCommand = strcmp(tokens->head->str, "let") == 0;
     int tempNodeIndex = 0;
+    TRACE_BEGIN(mathStart);
     for (StringNode *temp = tokens->head; temp != NULL;) {
         char *strToRemove = temp->str;
         size_t strToRemoveLen = strlen(strToRemove);
@@ -609,7 +1467,7 @@ int executeCommand(char *cmd, bool waitForCommand) {
                 StringLinkedList_removeIndexAndFreeNode(tokens, tempNodeIndex);
             }
             StringLinkedList_removeIndexAndFreeNode(tokens, tempNodeIndex);
-        } else if (temp->strMustBeFreed) {
+        } else if (temp->strMustBeFreed && !(isLetCommand && getArrayLiteral(strToRemove) != NULL)) {
             bool seenOtherChr = false;
             char *finalStr = processMathExpressions(strToRemove, &seenOtherChr);
             if (finalStr == NULL) {
@@ -645,6 +1503,7 @@ int executeCommand(char *cmd, bool waitForCommand) {
             tempNodeIndex++;
         }
     }
+    TRACE_END(mathStart, "processMathExpressions", NULL);
 
     StringNode *head = tokens->head;
     if (aliases != NULL && head != NULL) {
@@ -696,8 +1555,136 @@ int executeCommand(char *cmd, bool waitForCommand) {
         }
     }
 
+    //Arguments of let are not expanded so that a[1]=x can't match a file
+    for (StringNode *temp = head; temp != NULL; temp = temp->next) {
+        if (isLetCommand) {
+            restoreQuotedWildcards(temp->str);
+        } else {
+            temp = expandPathname(tokens, temp);
+        }
+    }
+
+    //Syntax: timeout [-k <grace>] [-v] <duration> <command>
+    //Syntax: run [--cpus <list>] [--nice <n>] [--mem <size>] [--nofile <n>] [--clear] [<command>]
+    //The prefix tokens are removed so that the command runs like any other, and prefixes can be combined
+    long timeoutMs = 0;
+    long graceMs = TIMEOUT_DEFAULT_GRACE_MS;
+    bool reportTime = false;
+    bool hasTimeout = false;
+    ResourceLimits *limits = NULL; //Limits of the command if run was used, otherwise defaultLimits apply
+    int numRunOptions = 0;
+    char *prefix = NULL; //Last prefix before the command
+    char *prefixErr = NULL;
+    char *prefixErrArg = NULL;
+    while (head != NULL && prefixErr == NULL && (strcmp(head->str, "timeout") == 0 || strcmp(head->str, "run") == 0)) {
+        prefix = strcmp(head->str, "timeout") == 0 ? "timeout" : "run";
+        StringLinkedList_removeIndexAndFreeNode(tokens, 0);
+        if (*prefix == 't') {
+            hasTimeout = true;
+            while (tokens->head != NULL && *tokens->head->str == '-') {
+                char *option = tokens->head->str;
+                if (strcmp(option, "-v") == 0) {
+                    reportTime = true;
+                } else if (strcmp(option, "-k") == 0) {
+                    StringNode *graceNode = tokens->head->next;
+                    if (graceNode == NULL || !parseDuration(graceNode->str, &graceMs)) {
+                        prefixErr = "invalid duration";
+                        prefixErrArg = graceNode != NULL ? strdup(graceNode->str) : strdup(option);
+                        break;
+                    }
+                    StringLinkedList_removeIndexAndFreeNode(tokens, 0);
+                } else {
+                    prefixErr = "invalid option";
+                    prefixErrArg = strdup(option);
+                    break;
+                }
+                StringLinkedList_removeIndexAndFreeNode(tokens, 0);
+            }
+            if (prefixErr == NULL) {
+                if (tokens->head == NULL) {
+                    prefixErr = "duration argument required";
+                } else if (!parseDuration(tokens->head->str, &timeoutMs)) {
+                    prefixErr = "invalid duration";
+                    prefixErrArg = strdup(tokens->head->str);
+                } else {
+                    StringLinkedList_removeIndexAndFreeNode(tokens, 0);
+                }
+            }
+        } else {
+            if (limits == NULL) {
+                limits = ResourceLimits_copy(defaultLimits);
+            }
+            while (tokens->head != NULL && strncmp(tokens->head->str, "--", 2) == 0) {
+                char *option = tokens->head->str;
+                if (strcmp(option, "--") == 0) {
+                    StringLinkedList_removeIndexAndFreeNode(tokens, 0);
+                    break;
+                } else if (strcmp(option, "--clear") == 0) {
+                    ResourceLimits_clear(limits);
+                } else if (!ResourceLimits_isOption(option)) {
+                    prefixErr = "invalid option";
+                    prefixErrArg = strdup(option);
+                    break;
+                } else {
+                    StringNode *valueNode = tokens->head->next;
+                    if (valueNode == NULL) {
+                        prefixErr = "value argument required";
+                        prefixErrArg = strdup(option);
+                        break;
+                    } else if (!ResourceLimits_set(limits, option, valueNode->str)) {
+                        prefixErr = "invalid value";
+                        prefixErrArg = strdup(valueNode->str);
+                        break;
+                    }
+                    StringLinkedList_removeIndexAndFreeNode(tokens, 0);
+                }
+                numRunOptions++;
+                StringLinkedList_removeIndexAndFreeNode(tokens, 0);
+            }
+        }
+        head = tokens->head;
+    }
+    if (prefix != NULL && prefixErr == NULL) {
+        if (head == NULL && hasTimeout) {
+            prefix = "timeout";
+            prefixErr = "command argument required";
+        } else if (head == NULL) {
+            //run without a command sets the limits of all commands after it, or prints them without any options
+            isBuiltInCommand = true;
+            if (numRunOptions > 0) {
+                ResourceLimits_free(defaultLimits);
+                defaultLimits = limits;
+                limits = NULL;
+            } else if (defaultLimits != NULL && !ResourceLimits_isEmpty(defaultLimits)) {
+                char *limitsStr = ResourceLimits_toStr(defaultLimits);
+                printf("run %s\n", limitsStr);
+                free(limitsStr);
+            }
+        } else if (strArrContains(builtinCommands, head->str, sizeof(builtinCommands) / sizeof(*builtinCommands))) {
+            prefixErr = *prefix == 't' ? "builtin commands can't be timed" : "builtin commands can't be run with limits";
+            prefixErrArg = strdup(head->str);
+        }
+    }
+    if (prefixErr != NULL) {
+        if (prefixErrArg != NULL) {
+            fprintf(stderr, "%s: %s: %s: %s\n", SHELL_NAME, prefix, prefixErrArg, prefixErr);
+            free(prefixErrArg);
+        } else {
+            fprintf(stderr, "%s: %s: %s\n", SHELL_NAME, prefix, prefixErr);
+        }
+        isBuiltInCommand = true;
+        exitStatus = 125;
+        head = NULL;
+    }
+
+    TRACE_BEGIN(builtinStart);
+    bool profileBuiltin = profileEnabled;
+    if (profileBuiltin) Profiler_begin();
+    char *builtinName = (builtinStart != 0 || profileBuiltin) && head != NULL ? strdup(head->str) : NULL;
     bool isExport = false;
-    if (head == NULL || strcmp(head->str, "false") == 0) {
+    if (isBuiltInCommand) {
+        //Already handled, like a math expression or invalid timeout or run arguments
+    } else if (head == NULL || strcmp(head->str, "false") == 0) {
         isBuiltInCommand = true;
         exitStatus = 1;
     } else if (strcmp(head->str, "true") == 0) {
@@ -744,6 +1731,7 @@ int executeCommand(char *cmd, bool waitForCommand) {
             fprintf(stderr, "%s: cd: %s: %s\n", SHELL_NAME, arg, err);
             exitStatus = 1;
         }
+        updateCwd();
     } else if (strcmp(head->str, "source") == 0) {
         isBuiltInCommand = true;
 
@@ -759,7 +1747,7 @@ int executeCommand(char *cmd, bool waitForCommand) {
                 exitStatus = 1;
             } else {
                 char *cmdBuf = emalloc(sizeof(char) * COMMAND_BUFFER_SIZE);
-                exitStatus = processFile(cmdBuf, fp, processCommand, true);
+                exitStatus = processFile(cmdBuf, fp, fileName, processCommand, true);
                 free(cmdBuf);
             }
         }
@@ -768,9 +1756,13 @@ int executeCommand(char *cmd, bool waitForCommand) {
 
         if (head->next == NULL) {
             if (isExport) {
-                char **environPtr = environ;
-                while (*environPtr) {
-                    char *envStr = *environPtr++;
+                int envSize = Environment_size(environment);
+                char **envStrs = emalloc(sizeof(char*) * (size_t) envSize);
+                syncEnvironment();
+                memcpy(envStrs, environ, sizeof(char*) * (size_t) envSize);
+                qsort(envStrs, (size_t) envSize, sizeof(char*), compareStrings);
+                for (int i = 0; i < envSize; i++) {
+                    char *envStr = envStrs[i];
                     printf("export ");
                     while (*envStr && *envStr != '=') {
                         putchar(*envStr++);
@@ -783,6 +1775,7 @@ int executeCommand(char *cmd, bool waitForCommand) {
                     putchar('\'');
                     putchar('\n');
                 }
+                free(envStrs);
             } else if (variables != NULL) {
                 char ***keysVals = StringHashMap_entries(variables);
                 int keysValsSize = StringHashMap_size(variables);
@@ -792,6 +1785,26 @@ int executeCommand(char *cmd, bool waitForCommand) {
                 }
                 free(keysVals);
             }
+            if (!isExport && arrays != NULL) {
+                char **arrayNames = ArrayMap_names(arrays);
+                for (int i = 0; i < ArrayMap_size(arrays); i++) {
+                    Array *array = ArrayMap_get(arrays, arrayNames[i]);
+                    printf("let %s=(", arrayNames[i]);
+                    if (Array_isAssociative(array)) {
+                        char **keys = Array_keys(array);
+                        for (int j = 0; j < Array_size(array); j++) {
+                            printf(j > 0 ? " [%s]=\"%s\"" : "[%s]=\"%s\"", keys[j], Array_getKey(array, keys[j]));
+                        }
+                        free(keys);
+                    } else {
+                        for (int j = 0; j < Array_size(array); j++) {
+                            printf(j > 0 ? " \"%s\"" : "\"%s\"", Array_get(array, j));
+                        }
+                    }
+                    printf(")\n");
+                }
+                free(arrayNames);
+            }
         } else if (!isExport && variables == NULL) {
             variables = StringHashMap_create();
         }
@@ -806,32 +1819,44 @@ int executeCommand(char *cmd, bool waitForCommand) {
                     continue;
                 }
 
+                char *arrayLiteral = isExport ? NULL : getArrayLiteral(argStr);
+                if (arrayLiteral != NULL) {
+                    *equalsSign = '\0';
+                    if (assignArray(argStr, arrayLiteral) != 0) {
+                        exitStatus = 1;
+                    }
+                    continue;
+                }
+
                 StringLinkedList *varList = split(argStr, "=", NULL);
                 char *varKey = varList->head->str;
                 char *varVal = varList->head->next->str;
-                bool replacingLetVal = variables != NULL && StringHashMap_get(variables, varKey) != NULL;
-                if (isExport) {
-                    setenv(varKey, varVal, true);
-                    if (replacingLetVal) {
+                char *subscript = strchr(varKey, '[');
+                if (isExport && arrays != NULL && ArrayMap_get(arrays, varKey) != NULL) {
+                    fprintf(stderr, "%s: export: %s: cannot export array\n", SHELL_NAME, varKey);
+                    exitStatus = 1;
+                } else if (isExport) {
+                    Environment_set(environment, varKey, varVal);
+                    if (variables != NULL) {
                         StringHashMap_remove(variables, varKey);
                     }
-                } else {
-                    char *varKeyDup = strdup(varKey);
-                    char *varValDup = strdup(varVal);
-                    bool replacingExportVal = getenv(varKey) != NULL;
-                    StringHashMap_put(variables, varKeyDup, true, varValDup, true);
-                    if (replacingLetVal) {
-                        free(varKeyDup);
-                    }
-                    if (replacingExportVal) {
-                        unsetenv(varKey);
+                } else if (subscript != NULL && varKey[strlen(varKey) - 1] == ']') {
+                    varKey[strlen(varKey) - 1] = '\0';
+                    *subscript = '\0';
+                    if (assignArrayElement(varKey, subscript + 1, varVal) != 0) {
+                        exitStatus = 1;
                     }
+                } else {
+                    setVariable(varKey, varVal);
                 }
                 StringLinkedList_free(varList);
+            } else if (isExport && arrays != NULL && ArrayMap_get(arrays, argStr) != NULL) {
+                fprintf(stderr, "%s: export: %s: cannot export array\n", SHELL_NAME, argStr);
+                exitStatus = 1;
             } else if (isExport && variables != NULL) {
                 char *letVal = StringHashMap_get(variables, argStr);
                 if (letVal != NULL) {
-                    setenv(argStr, letVal, true);
+                    Environment_set(environment, argStr, letVal);
                     StringHashMap_remove(variables, argStr);
                 }
             }
@@ -998,6 +2023,7 @@ int executeCommand(char *cmd, bool waitForCommand) {
         }
         StringLinkedList_append(tokens, NULL, false);
         char **tokensArr = StringLinkedList_toArray(tokens);
+        syncEnvironment();
         execvp(command, tokensArr);
         const char *isDirErr = "cannot execute: Is a directory";
         const char *err;
@@ -1030,6 +2056,26 @@ int executeCommand(char *cmd, bool waitForCommand) {
         free(tokensArr);
         isBuiltInCommand = true;
         exitStatus = 1;
+    } else if (strcmp(head->str, "parallel") == 0) {
+        isBuiltInCommand = true;
+        exitStatus = runParallel(head->next);
+    } else if (strcmp(head->str, "profile") == 0) {
+        isBuiltInCommand = true;
+        StringNode *argNode = head->next;
+        char *arg = argNode != NULL ? argNode->str : NULL;
+        if (arg == NULL) {
+            Profiler_print(stdout, 0);
+            fflush(stdout); //Otherwise forked children would print the report again when they exit
+        } else if (strcmp(arg, "on") == 0) {
+            Profiler_start();
+        } else if (strcmp(arg, "off") == 0) {
+            Profiler_stop();
+        } else if (strcmp(arg, "-c") == 0) {
+            Profiler_clear();
+        } else {
+            fprintf(stderr, "%s: profile: %s: invalid argument\n", SHELL_NAME, arg);
+            exitStatus = 1;
+        }
     } else if (strcmp(head->str, HISTORY_COMMAND) == 0) {
         isBuiltInCommand = true;
         StringNode *argNode = head->next;
@@ -1073,12 +2119,37 @@ int executeCommand(char *cmd, bool waitForCommand) {
         }
     }
 
+    if (builtinStart != 0 || profileBuiltin) {
+        if (isBuiltInCommand && builtinStart != 0) {
+            Trace_span("builtin", builtinName, builtinStart);
+        }
+        if (profileBuiltin) {
+            //Times of commands that aren't builtins are dropped here and profiled around the fork instead,
+            //and so are those of profile, which would otherwise only show up when turning the profiler off
+            bool record = isBuiltInCommand && builtinName != NULL && strcmp(builtinName, "profile") != 0;
+            Profiler_end(PROFILE_BUILTIN, record ? builtinName : NULL, NULL);
+        }
+        free(builtinName);
+    }
+
     if (!isBuiltInCommand) {
+        syncEnvironment();
+        bool profiled = profileEnabled && waitForCommand && !isBackgroundCmd;
+        if (profiled) Profiler_begin();
+        struct timespec startTime;
+        clock_gettime(CLOCK_MONOTONIC, &startTime);
+        TRACE_BEGIN(forkStart);
         pid_t cid = fork();
         if (cid >= 0) {
             if (cid == 0) {
                 StringLinkedList_append(tokens, NULL, false);
                 char **tokensArr = StringLinkedList_toArray(tokens);
+                ResourceLimits *childLimits = limits != NULL ? limits : defaultLimits;
+                const char *limitErr = childLimits != NULL ? ResourceLimits_apply(childLimits) : NULL;
+                if (limitErr != NULL) {
+                    fprintf(stderr, "%s: run: %s: %s\n", SHELL_NAME, limitErr, strerror(errno));
+                    exit(125);
+                }
                 execvp(head->str, tokensArr);
                 char *err;
                 switch (errno) {
@@ -1107,15 +2178,32 @@ int executeCommand(char *cmd, bool waitForCommand) {
                 fprintf(stderr, "%s: %s: %s\n", SHELL_NAME, head->str, err);
                 exit(1);
             }
-            if (waitForCommand && !isBackgroundCmd) {
-                int status;
-                if (numBackgroundCmds > 0) {
-                    while (waitpid(cid, &status, 0) > 0);
-                } else {
-                    while (wait(&status) > 0);
+            if (forkStart != 0) {
+                Trace_span("fork", head->str, forkStart);
+                Trace_childStarted(cid, head->str);
+            }
+            //A command with a timeout is always waited for, even in a pipeline stage that
+            //doesn't wait for its command otherwise, since its time limit can't be enforced after that
+            if (!isBackgroundCmd && (timeoutMs > 0 || reportTime)) {
+                bool timedOut = false;
+                int status = timeoutMs > 0
+                    ? waitForChildWithTimeout(cid, timeoutMs, graceMs, &timedOut)
+                    : waitForChild(cid);
+                double elapsed = secondsSince(&startTime);
+                exitStatus = timedOut ? 124 : (WIFEXITED(status)) ? (WEXITSTATUS(status)) : 1;
+                if (timedOut) {
+                    bool killed = WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL;
+                    fprintf(stderr, "%s: timeout: %s: %s after %.3fs\n", SHELL_NAME, head->str, killed ? "killed" : "timed out", elapsed);
+                } else if (reportTime) {
+                    fprintf(stderr, "%s: timeout: %s: finished in %.3fs\n", SHELL_NAME, head->str, elapsed);
                 }
+            } else if (waitForCommand && !isBackgroundCmd) {
+                int status = waitForChild(cid);
                 exitStatus = (WIFEXITED(status)) ? (WEXITSTATUS(status)) : 1;
             } else if (isBackgroundCmd) {
+                if (eventLoop != NULL) {
+                    (void) EventLoop_watchChild(eventLoop, cid);
+                }
                 numBackgroundCmds++;
                 fprintf(stderr, "[%d] %d\n", numBackgroundCmds, cid);
             }
@@ -1124,6 +2212,7 @@ int executeCommand(char *cmd, bool waitForCommand) {
             fprintf(stderr, "%s: Failed to spawn child process for command \"%s\"\n", SHELL_NAME, tempCmd->data);
             exitStatus = 1;
         }
+        if (profiled) Profiler_end(PROFILE_COMMAND, head->str, NULL);
     }
 
     if (*stdinStatus) {
@@ -1138,21 +2227,246 @@ int executeCommand(char *cmd, bool waitForCommand) {
     free(stdoutStatus);
     CharList_free(tempCmd);
     StringLinkedList_free(tokens);
+    ResourceLimits_free(limits);
     if (processedVars) free(processVarCmd);
     return exitStatus;
 }
 
-int processPipeCommands(char *cmd, char *orChr) {
+typedef struct StageUsage {
+    double real; //Seconds from when the command started to when it finished
+    int status; //Exit status of the command
+    struct rusage usage;
+} StageUsage;
+
+double timevalToSeconds(struct timeval *tv) {
+    return (double) tv->tv_sec + (double) tv->tv_usec / 1e6;
+}
+
+long maxRssKilobytes(struct rusage *usage) {
+#ifdef __APPLE__
+    return usage->ru_maxrss / 1024; //Bytes on macOS
+#else
+    return usage->ru_maxrss;
+#endif
+}
+
+/**
+ * Adds the times and counts of src to dest
+ * The max RSS of dest becomes the larger of the two
+*/
+void addUsage(struct rusage *dest, struct rusage *src) {
+    timeradd(&dest->ru_utime, &src->ru_utime, &dest->ru_utime);
+    timeradd(&dest->ru_stime, &src->ru_stime, &dest->ru_stime);
+    if (src->ru_maxrss > dest->ru_maxrss) {
+        dest->ru_maxrss = src->ru_maxrss;
+    }
+    dest->ru_minflt += src->ru_minflt;
+    dest->ru_majflt += src->ru_majflt;
+    dest->ru_nvcsw += src->ru_nvcsw;
+    dest->ru_nivcsw += src->ru_nivcsw;
+}
+
+/**
+ * Executes a command like executeCommand and stores the time and resources it used in stageUsage
+ * Those are the resources of the child process that ran it plus what the shell used itself,
+ * which is all of it for a builtin command
+*/
+int executeTimedCommand(char *cmd, StageUsage *stageUsage) {
+    struct timespec startTime;
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+    struct rusage selfBefore;
+    getrusage(RUSAGE_SELF, &selfBefore);
+    memset(&lastChildUsage, 0, sizeof(lastChildUsage));
+
+    int exitStatus = executeCommand(cmd, true);
+
+    struct rusage self;
+    getrusage(RUSAGE_SELF, &self);
+    stageUsage->real = secondsSince(&startTime);
+    stageUsage->status = exitStatus;
+    stageUsage->usage = lastChildUsage;
+    timersub(&self.ru_utime, &selfBefore.ru_utime, &self.ru_utime);
+    timersub(&self.ru_stime, &selfBefore.ru_stime, &self.ru_stime);
+    self.ru_minflt -= selfBefore.ru_minflt;
+    self.ru_majflt -= selfBefore.ru_majflt;
+    self.ru_nvcsw -= selfBefore.ru_nvcsw;
+    self.ru_nivcsw -= selfBefore.ru_nivcsw;
+    if (lastChildUsage.ru_maxrss != 0) {
+        self.ru_maxrss = 0; //A child ran the command, so the peak of the shell isn't the command's
+    }
+    addUsage(&stageUsage->usage, &self);
+    return exitStatus;
+}
+
+void printStageUsage(FILE *stream, char *stage, StageUsage *stageUsage, char *command) {
+    struct rusage *usage = &stageUsage->usage;
+    fprintf(stream, "%-6s %9.3f %9.3f %9.3f %10ld %7ld %7ld %8ld %7ld  %s\n",
+        stage, stageUsage->real, timevalToSeconds(&usage->ru_utime), timevalToSeconds(&usage->ru_stime),
+        maxRssKilobytes(usage), usage->ru_nvcsw, usage->ru_nivcsw, usage->ru_minflt, usage->ru_majflt, command);
+}
+
+//Prints the fields of a JSON object for stageUsage, leaving the object open
+void printStageUsageJson(FILE *stream, StageUsage *stageUsage, char *command) {
+    struct rusage *usage = &stageUsage->usage;
+    fputs("{\"command\": ", stream);
+    fprintJsonString(stream, command);
+    fprintf(stream, ", \"status\": %d, \"real\": %.6f, \"user\": %.6f, \"sys\": %.6f, \"maxrss_kb\": %ld, "
+        "\"voluntary_switches\": %ld, \"involuntary_switches\": %ld, \"minor_faults\": %ld, \"major_faults\": %ld",
+        stageUsage->status, stageUsage->real, timevalToSeconds(&usage->ru_utime), timevalToSeconds(&usage->ru_stime),
+        maxRssKilobytes(usage), usage->ru_nvcsw, usage->ru_nivcsw, usage->ru_minflt, usage->ru_majflt);
+}
+
+int runPipeline(char *cmd, char *orChr, StageUsage *stageUsages);
+
+/**
+ * Executes a pipeline and reports the time and resources used by each of its commands and in total
+ * The report is a table, or a line of JSON with -j, written to stderr or appended to the file given with -o
+*/
+int processTimeCommand(char *cmd) {
+    bool json = false;
+    char *outputPath = NULL;
+    char *counter = cmd;
+    while (true) {
+        while (*counter == ' ') {
+            counter++;
+        }
+        if (*counter != '-') {
+            break;
+        }
+        char *option = counter;
+        while (*counter && *counter != ' ') {
+            counter++;
+        }
+        int optionLen = (int) (counter - option);
+        if (optionLen == 2 && option[1] == 'j') {
+            json = true;
+        } else if (optionLen == 2 && option[1] == 'o') {
+            while (*counter == ' ') {
+                counter++;
+            }
+            char *path = counter;
+            while (*counter && *counter != ' ') {
+                counter++;
+            }
+            free(outputPath);
+            outputPath = NULL;
+            if (path == counter) {
+                fprintf(stderr, "%s: time: -o: file argument required\n", SHELL_NAME);
+                return 125;
+            }
+            outputPath = strndup(path, (size_t) (counter - path));
+        } else if (optionLen == 2 && option[1] == '-') {
+            break;
+        } else {
+            fprintf(stderr, "%s: time: %.*s: invalid option\n", SHELL_NAME, optionLen, option);
+            free(outputPath);
+            return 125;
+        }
+    }
+    while (*counter == ' ') {
+        counter++;
+    }
+    if (!*counter) {
+        fprintf(stderr, "%s: time: command argument required\n", SHELL_NAME);
+        free(outputPath);
+        return 125;
+    }
+
+    char *pipeline = strdup(counter);
+    char *stagesCmd = strdup(counter);
+    StringLinkedList *stages = splitCommands(stagesCmd, "|", NULL);
+    size_t usagesSize = sizeof(StageUsage) * (size_t) (stages->size > 0 ? stages->size : 1);
+    //The commands of a pipeline run in child processes, which store their usage here themselves
+    StageUsage *stageUsages = mmap(NULL, usagesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (stageUsages == MAP_FAILED) {
+        fprintf(stderr, "%s: time: %s\n", SHELL_NAME, strerror(errno));
+        free(pipeline);
+        free(stagesCmd);
+        free(outputPath);
+        StringLinkedList_free(stages);
+        return 1;
+    }
+
+    struct timespec startTime;
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+    int exitStatus = runPipeline(pipeline, strchr(pipeline, '|'), stageUsages);
+    StageUsage total = {0};
+    total.real = secondsSince(&startTime);
+    total.status = exitStatus;
+    for (int i = 0; i < stages->size; i++) {
+        addUsage(&total.usage, &stageUsages[i].usage);
+    }
+
+    FILE *stream = stderr;
+    if (outputPath != NULL && (stream = fopen(outputPath, "a")) == NULL) {
+        fprintf(stderr, "%s: time: %s: %s\n", SHELL_NAME, outputPath, strerror(errno));
+    } else if (json) {
+        printStageUsageJson(stream, &total, counter);
+        fputs(", \"stages\": [", stream);
+        int i = 0;
+        for (StringNode *temp = stages->head; temp != NULL; temp = temp->next, i++) {
+            trimWhitespaceFromEnds(temp->str);
+            fputs(i > 0 ? ", " : "", stream);
+            printStageUsageJson(stream, &stageUsages[i], temp->str);
+            fputc('}', stream);
+        }
+        fputs("]}\n", stream);
+    } else {
+        fprintf(stream, "%-6s %9s %9s %9s %10s %7s %7s %8s %7s  %s\n",
+            "stage", "real", "user", "sys", "maxrss(K)", "vcsw", "ivcsw", "minflt", "majflt", "command");
+        if (stages->size > 1) {
+            int i = 0;
+            for (StringNode *temp = stages->head; temp != NULL; temp = temp->next, i++) {
+                char stageNum[16];
+                snprintf(stageNum, sizeof(stageNum), "%d", i + 1);
+                trimWhitespaceFromEnds(temp->str);
+                printStageUsage(stream, stageNum, &stageUsages[i], temp->str);
+            }
+        }
+        printStageUsage(stream, "total", &total, counter);
+    }
+    if (stream != NULL && stream != stderr) {
+        fclose(stream);
+    }
+
+    munmap(stageUsages, usagesSize);
+    free(pipeline);
+    free(stagesCmd);
+    free(outputPath);
+    StringLinkedList_free(stages);
+    return exitStatus;
+}
+
+/**
+ * Executes the commands of a pipeline with the output of each command going to the input of the next
+ * If stageUsages isn't NULL, each command waits for what it runs, and the time and resources it used
+ * are stored in stageUsages, which must be shared with the child processes
+ * When profiling, the commands before the last one are timed the same way and added to the profile
+*/
+int runPipeline(char *cmd, char *orChr, StageUsage *stageUsages) {
     if (orChr != NULL) {
         char *tempCmd = strdup(cmd);
-        StringLinkedList *tokens = split(tempCmd, "|", NULL);
+        StringLinkedList *tokens = splitCommands(tempCmd, "|", NULL);
+        StageUsage *profileUsages = NULL;
+        size_t profileUsagesSize = sizeof(StageUsage) * (size_t) tokens->size;
+        if (profileEnabled && stageUsages == NULL) {
+            profileUsages = mmap(NULL, profileUsagesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+            if (profileUsages != MAP_FAILED) {
+                stageUsages = profileUsages;
+            } else {
+                profileUsages = NULL; //The pipeline still runs, just without times for its stages
+            }
+        }
         int terminal_stdin = dup(STDIN_FILENO);
         int terminal_stdout = dup(STDOUT_FILENO);
         int fd[2];
         StringNode *temp;
         bool isFirstIteration = true;
         bool pipeCommandFailed = false;
-        for (temp = tokens->head; temp != tokens->tail; temp = temp->next) {
+        pid_t *stagePids = emalloc(sizeof(pid_t) * (size_t) tokens->size);
+        int stage = 0;
+        for (temp = tokens->head; temp != tokens->tail; temp = temp->next, stage++) {
+            trimWhitespaceFromEnds(temp->str);
             if (pipe(fd) != 0) {
                 //Should not happen
                 fprintf(stderr, "%s: Failed to create pipe for command \"%s\" in \"%s\"\n", SHELL_NAME, temp->str, cmd);
@@ -1167,24 +2481,34 @@ int processPipeCommands(char *cmd, char *orChr) {
                 break;
             }
             if (cid == 0) {
+                eventLoop = NULL; //The epoll instance is shared with the shell
                 close(fd[0]);
                 dup2(fd[1], STDOUT_FILENO);
                 close(fd[1]);
-                trimWhitespaceFromEnds(temp->str);
+                if (stageUsages != NULL) {
+                    exit(executeTimedCommand(temp->str, &stageUsages[stage]));
+                }
                 (void) executeCommand(temp->str, false);
                 exit(0);
             }
+            if (traceEnabled) {
+                Trace_childStarted(cid, temp->str);
+            }
             close(fd[1]);
             dup2(fd[0], STDIN_FILENO);
             close(fd[0]);
             isFirstIteration = false;
-            while (wait(NULL) > 0);
+            //Timed commands and commands with a timeout only exit once they are done, so the stages
+            //are waited for after the last one starts
+            stagePids[stage] = cid;
         }
         int exitStatus = 1;
         if (temp != NULL) {
             if (!pipeCommandFailed) {
                 trimWhitespaceFromEnds(temp->str);
-                exitStatus = executeCommand(temp->str, true);
+                exitStatus = stageUsages != NULL
+                    ? executeTimedCommand(temp->str, &stageUsages[stage])
+                    : executeCommand(temp->str, true);
             }
             if (!isFirstIteration) {
                 dup2(terminal_stdout, STDOUT_FILENO);
@@ -1193,18 +2517,44 @@ int processPipeCommands(char *cmd, char *orChr) {
         }
         close(terminal_stdout);
         close(terminal_stdin);
+        for (int i = 0; i < stage; i++) {
+            (void) waitForChild(stagePids[i]);
+        }
+        if (profileEnabled && stageUsages != NULL) {
+            //The last command was profiled by executeCommand in the shell itself
+            temp = tokens->head;
+            for (int i = 0; i < stage; i++, temp = temp->next) {
+                char *name = strndup(temp->str, strcspn(temp->str, " "));
+                Profiler_add(PROFILE_COMMAND, name, NULL, stageUsages[i].real);
+                free(name);
+            }
+        }
+        if (profileUsages != NULL) {
+            munmap(profileUsages, profileUsagesSize);
+        }
+        free(stagePids);
         free(tempCmd);
         StringLinkedList_free(tokens);
         return exitStatus;
     }
-    return executeCommand(cmd, true);
+    return stageUsages != NULL ? executeTimedCommand(cmd, stageUsages) : executeCommand(cmd, true);
+}
+
+int processPipeCommands(char *cmd, char *orChr) {
+    //Syntax: time [-j] [-o <file>] <pipeline>
+    const char *const timeStatement = "time";
+    size_t timeStatementLen = strlen(timeStatement);
+    if (strncmp(cmd, timeStatement, timeStatementLen) == 0 && (!cmd[timeStatementLen] || cmd[timeStatementLen] == ' ')) {
+        return processTimeCommand(cmd + timeStatementLen);
+    }
+    return runPipeline(cmd, orChr, NULL);
 }
 
 int processOrCommands(char *cmd) {
     char *orChr = strchr(cmd, '|');
     if (orChr != NULL && *(orChr + 1) == '|') {
         char *tempCmd = strdup(cmd);
-        StringLinkedList *tokens = split(tempCmd, "||", NULL);
+        StringLinkedList *tokens = splitCommands(tempCmd, "||", NULL);
         for (StringNode *temp = tokens->head; temp != NULL; temp = temp->next) {
             trimWhitespaceFromEnds(temp->str);
             if (*temp->str) {
@@ -1216,40 +2566,224 @@ int processOrCommands(char *cmd) {
                 }
             }
         }
-        free(tempCmd);
-        StringLinkedList_free(tokens);
-        return 1;
+        free(tempCmd);
+        StringLinkedList_free(tokens);
+        return 1;
+    }
+    return processPipeCommands(cmd, orChr);
+}
+
+int processAndCommands(char *cmd) {
+    char *andChr = strchr(cmd, '&');
+    if (andChr != NULL && *(andChr + 1) == '&') {
+        char *tempCmd = strdup(cmd);
+        StringLinkedList *tokens = splitCommands(tempCmd, "&&", NULL);
+        for (StringNode *temp = tokens->head; temp != NULL; temp = temp->next) {
+            trimWhitespaceFromEnds(temp->str);
+            if (*temp->str) {
+                int exitStatus = processOrCommands(temp->str);
+                if (exitStatus != 0) {
+                    free(tempCmd);
+                    StringLinkedList_free(tokens);
+                    return exitStatus;
+                }
+            }
+        }
+        free(tempCmd);
+        StringLinkedList_free(tokens);
+        return 0;
+    }
+    return processOrCommands(cmd);
+}
+
+/**
+ * Returns true if cmd starts with the keyword of an if, while, repeat or for statement
+*/
+bool isKeywordStatement(char *cmd) {
+    char *keywords[] = {"if", "while", "repeat", "for"};
+    for (size_t i = 0; i < sizeof(keywords) / sizeof(*keywords); i++) {
+        size_t keywordLen = strlen(keywords[i]);
+        if (strncmp(cmd, keywords[i], keywordLen) == 0
+            && (!cmd[keywordLen] || cmd[keywordLen] == ' ' || cmd[keywordLen] == '(')
+        ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Sets the variable of a for loop and runs its command once
+ * statements holds the command already split at its semicolons, or is
+ * NULL if the command is a statement that processCommand has to parse
+ *
+ * Returns the status of the command, or -1 on a syntax error
+*/
+int runForLoopIteration(char *name, char *value, char *command, StringLinkedList *statements) {
+    setVariable(name, value);
+    if (statements == NULL) {
+        return processCommand(command);
+    }
+    int status = 0;
+    for (StringNode *temp = statements->head; temp != NULL; temp = temp->next) {
+        status = processAndCommands(temp->str);
+    }
+    return status;
+}
+
+/**
+ * Parses the range start..end or start..end..step of a for loop
+ *
+ * Returns false if range is not a range
+*/
+bool parseForLoopRange(char *range, long *start, long *end, long *step) {
+    char *endPtr;
+    *start = strtol(range, &endPtr, 10);
+    if (endPtr == range || strncmp(endPtr, "..", 2) != 0) {
+        return false;
+    }
+    range = endPtr + 2;
+    *end = strtol(range, &endPtr, 10);
+    if (endPtr == range) {
+        return false;
+    }
+    *step = 1;
+    if (strncmp(endPtr, "..", 2) == 0) {
+        range = endPtr + 2;
+        *step = strtol(range, &endPtr, 10);
+        if (endPtr == range || *step <= 0) {
+            return false;
+        }
+    }
+    while (*endPtr == ' ') {
+        endPtr++;
+    }
+    return !*endPtr;
+}
+
+/**
+ * Runs command once for each item with the shell variable name set to the item
+ * Items are the elements of an array for $array, which are read in place
+ * without splitting anything, the numbers from start to end for (start..end[..step]),
+ * which are generated one at a time, the words in a list for (word ...), and the
+ * words in the value of anything else; words with wildcards are replaced with
+ * the paths they match
+ *
+ * Returns the status of the last command run, or -1 on a syntax error
+*/
+int runForLoop(char *name, char *items, char *command) {
+    //Split the command once instead of in every iteration
+    StringLinkedList *statements = NULL;
+    if (!isKeywordStatement(command) && strchr(command, ';') != NULL) {
+        char *commandDup = strdup(command);
+        statements = splitCommands(commandDup, ";", NULL);
+        free(commandDup);
+        for (StringNode *temp = statements->head; temp != NULL; temp = temp->next) {
+            trimWhitespaceFromEnds(temp->str);
+        }
+    } else if (!isKeywordStatement(command)) {
+        statements = StringLinkedList_create();
+        StringLinkedList_append(statements, command, false);
+    }
+
+    Array *array = NULL;
+    if (*items == VARIABLE_PREFIX && arrays != NULL) {
+        array = ArrayMap_get(arrays, items + 1);
+    }
+
+    int status = 0;
+    if (array != NULL && !Array_isAssociative(array)) {
+        //The command may change the array, so it is looked up again every iteration
+        for (int i = 0; array != NULL && i < Array_size(array) && !sigintReceived; i++) {
+            status = runForLoopIteration(name, Array_get(array, i), command, statements);
+            if (status < 0) { //status < 0 means a syntax error occurred
+                break;
+            }
+            array = ArrayMap_get(arrays, items + 1);
+        }
+        if (statements != NULL) {
+            StringLinkedList_free(statements);
+        }
+        return status;
     }
-    return processPipeCommands(cmd, orChr);
-}
 
-int processAndCommands(char *cmd) {
-    char *andChr = strchr(cmd, '&');
-    if (andChr != NULL && *(andChr + 1) == '&') {
-        char *tempCmd = strdup(cmd);
-        StringLinkedList *tokens = split(tempCmd, "&&", NULL);
-        for (StringNode *temp = tokens->head; temp != NULL; temp = temp->next) {
-            trimWhitespaceFromEnds(temp->str);
-            if (*temp->str) {
-                int exitStatus = processOrCommands(temp->str);
-                if (exitStatus != 0) {
-                    free(tempCmd);
-                    StringLinkedList_free(tokens);
-                    return exitStatus;
+    StringLinkedList *words;
+    if (array != NULL) {
+        words = StringLinkedList_create();
+        char **keys = Array_keys(array);
+        for (int i = 0; i < Array_size(array); i++) {
+            StringLinkedList_append(words, strdup(Array_getKey(array, keys[i])), true);
+        }
+        free(keys);
+    } else {
+        char *expandedItems = processVariables(items, NULL);
+        if (expandedItems == NULL) {
+            if (statements != NULL) {
+                StringLinkedList_free(statements);
+            }
+            return 1;
+        }
+        char *wordsStr = expandedItems != items ? expandedItems : strdup(items);
+        char *wordsPtr = wordsStr;
+        if (*items == '(') {
+            wordsPtr++;
+            wordsPtr[strlen(wordsPtr) - 1] = '\0';
+        }
+
+        long start, end, step;
+        if (*items == '(' && trimWhitespaceFromEnds(wordsPtr) && parseForLoopRange(wordsPtr, &start, &end, &step)) {
+            free(wordsStr);
+            char value[32];
+            long direction = start <= end ? 1 : -1;
+            for (long i = start; (end - i) * direction >= 0 && !sigintReceived; i += step * direction) {
+                snprintf(value, sizeof(value), "%ld", i);
+                status = runForLoopIteration(name, value, command, statements);
+                if (status < 0 || (direction > 0 ? i > LONG_MAX - step : i < LONG_MIN + step)) {
+                    break;
                 }
             }
+            if (statements != NULL) {
+                StringLinkedList_free(statements);
+            }
+            return status;
+        }
+
+        int splitStatus = 1;
+        markQuotedWildcards(wordsPtr);
+        words = trimWhitespaceFromEnds(wordsPtr) ? split(wordsPtr, " ", &splitStatus) : StringLinkedList_create();
+        free(wordsStr);
+        if (splitStatus == -1) {
+            StringLinkedList_free(words);
+            if (statements != NULL) {
+                StringLinkedList_free(statements);
+            }
+            return 1;
         }
-        free(tempCmd);
-        StringLinkedList_free(tokens);
-        return 0;
     }
-    return processOrCommands(cmd);
+
+    for (StringNode *temp = words->head; temp != NULL; temp = temp->next) {
+        temp = expandPathname(words, temp);
+    }
+    for (StringNode *temp = words->head; temp != NULL && !sigintReceived; temp = temp->next) {
+        status = runForLoopIteration(name, temp->str, command, statements);
+        if (status < 0) {
+            break;
+        }
+    }
+    StringLinkedList_free(words);
+    if (statements != NULL) {
+        StringLinkedList_free(statements);
+    }
+    return status;
 }
 
 int processCommand(char *cmd) {
-    //Check for comments
+    //Check for comments; a comment starts at a # that follows a space, so ${#name} is kept
     char *commentChr = strchr(cmd, COMMENT_CHAR);
-    if (commentChr != NULL && *(commentChr - 1) == ' ') {
+    while (commentChr != NULL && (commentChr == cmd || *(commentChr - 1) != ' ')) {
+        commentChr = strchr(commentChr + 1, COMMENT_CHAR);
+    }
+    if (commentChr != NULL) {
         *commentChr = '\0';
     }
 
@@ -1386,7 +2920,7 @@ int processCommand(char *cmd) {
 
                 bool hasUndefinedVars = false;
                 char *testCmdCopyProcessedVars = processVariables(testCmdCopy, &hasUndefinedVars);
-                if (hasUndefinedVars) {
+                if (hasUndefinedVars || testCmdCopyProcessedVars == NULL) {
                     free(testCmdCopyProcessedVars);
                     CharList_free(testCmdList);
                     free(testCmdCopy);
@@ -1496,7 +3030,7 @@ int processCommand(char *cmd) {
         return status;
     }
 
-    //Syntax: repeat (<integer>) <command>
+    //Syntax: repeat [-j <jobs>] [-k] (<integer>) <command>
     const char *const loopCommand = "repeat";
     size_t loopCommandLen = strlen(loopCommand);
     if (strncmp(cmd, loopCommand, loopCommandLen) == 0
@@ -1510,6 +3044,37 @@ int processCommand(char *cmd) {
         while (*counter == ' ') {
             counter++;
         }
+
+        //With -j, up to the given number of iterations run at the same time,
+        //and -k prints the output of each iteration in order instead of as it is written
+        int maxJobs = 0;
+        bool keepOrder = false;
+        while (*counter == '-') {
+            char option = counter[1];
+            counter += option ? 2 : 1;
+            if (option == 'j') {
+                while (*counter == ' ') {
+                    counter++;
+                }
+                long numJobs = isdigit(*counter) ? strtol(counter, &counter, 10) : 0;
+                if (numJobs <= 0 || numJobs > INT_MAX || (*counter && *counter != ' ')) {
+                    fprintf(stderr, "%s: repeat: invalid number of jobs\n", SHELL_NAME);
+                    return -1;
+                }
+                maxJobs = (int) numJobs;
+            } else if (option == 'k' && (!*counter || *counter == ' ')) {
+                keepOrder = true;
+            } else if (!option || option == ' ') {
+                fprintf(stderr, "%s: repeat: -: invalid option\n", SHELL_NAME);
+                return -1;
+            } else {
+                fprintf(stderr, "%s: repeat: -%c: invalid option\n", SHELL_NAME, option);
+                return -1;
+            }
+            while (*counter == ' ') {
+                counter++;
+            }
+        }
         if (*counter != '(') {
             if (!*counter) {
                 fprintf(stderr, "%s: syntax error: unexpected end of input, expected '('\n", SHELL_NAME);
@@ -1563,6 +3128,10 @@ int processCommand(char *cmd) {
                 char *oldExpr = expr;
                 expr = processVariables(oldExpr, NULL);
                 free(oldExpr);
+                if (expr == NULL) {
+                    CharList_free(exprList);
+                    return -1;
+                }
             }
             CharList_free(exprList);
             int parseStatus;
@@ -1600,6 +3169,18 @@ int processCommand(char *cmd) {
             return -1;
         }
 
+        if (maxJobs > 0) {
+            if (loopAmount <= 0) {
+                return 0;
+            }
+            char **commands = emalloc(sizeof(char*) * (size_t) loopAmount);
+            for (int i = 0; i < loopAmount; i++) {
+                commands[i] = counter;
+            }
+            int status = runJobPool(commands, loopAmount, maxJobs, keepOrder, false);
+            free(commands);
+            return status;
+        }
         for (int i = 0; i < loopAmount; i++) {
             int status = processCommand(counter);
             if (status < 0) { //status < 0 means a syntax error occurred
@@ -1609,12 +3190,88 @@ int processCommand(char *cmd) {
         return 0;
     }
 
+    //Syntax: for <name> in <$array|(<start>..<end>[..<step>])|(<word> ...)|<word>> <command>
+    const char *const forStatement = "for";
+    size_t forStatementLen = strlen(forStatement);
+    if (strncmp(cmd, forStatement, forStatementLen) == 0 && (!cmd[forStatementLen] || cmd[forStatementLen] == ' ')) {
+        char *counter = cmd + forStatementLen;
+        while (*counter == ' ') {
+            counter++;
+        }
+        char *name = counter;
+        while (isalnum(*counter) || *counter == '_') {
+            counter++;
+        }
+        if (counter == name || (*counter && *counter != ' ')) {
+            if (!*counter) {
+                fprintf(stderr, "%s: syntax error: unexpected end of input, expected variable name\n", SHELL_NAME);
+            } else {
+                fprintf(stderr, "%s: syntax error: unexpected token '%c', expected variable name\n", SHELL_NAME, *counter);
+            }
+            return -1;
+        }
+        size_t nameLen = (size_t) (counter - name);
+
+        while (*counter == ' ') {
+            counter++;
+        }
+        if (strncmp(counter, "in ", 3) != 0) {
+            fprintf(stderr, "%s: syntax error: expected 'in' after '%.*s'\n", SHELL_NAME, (int) nameLen, name);
+            return -1;
+        }
+        counter += 3;
+        while (*counter == ' ') {
+            counter++;
+        }
+
+        char *items = counter;
+        if (*counter == '(') {
+            int nestLevel = 0;
+            do {
+                if (*counter == '(') {
+                    nestLevel++;
+                } else if (*counter == ')') {
+                    nestLevel--;
+                }
+                counter++;
+            } while (nestLevel > 0 && *counter);
+            if (nestLevel > 0) {
+                fprintf(stderr, "%s: syntax error: unexpected end of input, expected ')'\n", SHELL_NAME);
+                return -1;
+            }
+        } else {
+            while (*counter && *counter != ' ') {
+                counter++;
+            }
+        }
+        size_t itemsLen = (size_t) (counter - items);
+
+        while (*counter == ' ') {
+            counter++;
+        }
+        if (!*counter) {
+            fprintf(stderr, "%s: syntax error: unexpected end of input, expected command after '%s'\n", SHELL_NAME, cmd);
+            return -1;
+        }
+
+        char *nameStr = emalloc(sizeof(char) * (nameLen + 1));
+        memcpy(nameStr, name, nameLen);
+        nameStr[nameLen] = '\0';
+        char *itemsStr = emalloc(sizeof(char) * (itemsLen + 1));
+        memcpy(itemsStr, items, itemsLen);
+        itemsStr[itemsLen] = '\0';
+        int status = runForLoop(nameStr, itemsStr, counter);
+        free(nameStr);
+        free(itemsStr);
+        return status;
+    }
+
     //Check for semicolon operators
     char *semicolonChr = strchr(cmd, ';');
     if (semicolonChr != NULL) {
         int exitStatus = 0;
         char *tempCmd = strdup(cmd);
-        StringLinkedList *tokens = split(tempCmd, ";", NULL);
+        StringLinkedList *tokens = splitCommands(tempCmd, ";", NULL);
         for (StringNode *temp = tokens->head; temp != NULL; temp = temp->next) {
             trimWhitespaceFromEnds(temp->str);
             exitStatus = processAndCommands(temp->str);
@@ -1784,72 +3441,227 @@ char* processMathExpressions(char *cmd, bool *seenOtherChr) {
     return cmd;
 }
 
-char* processVariables(char *cmd, bool *hasUndefinedVars) {
-    if (strchr(cmd, VARIABLE_PREFIX) != NULL && cmd[1]) {
-        CharList *tempCmd = CharList_create();
-        bool inParentheses = false;
-        char *cmdCounter = cmd;
+/**
+ * Returns the value of the shell, environment or array variable name,
+ * or NULL if it is not defined
+*/
+char* getVariable(char *name) {
+    char *value = Environment_get(environment, name);
+    if (value == NULL && variables != NULL) {
+        value = StringHashMap_get(variables, name);
+    }
+    if (value == NULL && arrays != NULL) {
+        value = getArrayVariable(name);
+    }
+    return value;
+}
 
-        while (*cmdCounter) {
-            switch (*cmdCounter) {
-                case '(':
-                    inParentheses = true;
-                    break;
-                case ')':
-                    inParentheses = false;
-                    break;
-            }
-            if (*cmdCounter == VARIABLE_PREFIX) {
-                CharList *varNameList = NULL;
-                bool inVarLoop = false;
-                while (
-                    *++cmdCounter
-                    && *cmdCounter != ' '
-                    && *cmdCounter != ')'
-                    && *cmdCounter != '"'
-                    && *cmdCounter != ';'
-                    && *cmdCounter != '&'
-                    && *cmdCounter != '|'
-                    && !MathParser_isAnyOperator(*cmdCounter)
-                    && *cmdCounter != VARIABLE_PREFIX
-                ) {
-                    inVarLoop = true;
-                    if (varNameList == NULL) {
-                        varNameList = CharList_create();
-                    }
-                    CharList_add(varNameList, *cmdCounter);
-                }
-                if (!inVarLoop) continue;
+/**
+ * Reports a reference to the undefined variable name
+ *
+ * Returns false if expansion cannot continue, which is the case inside a math expression
+*/
+bool handleUndefinedVariable(char *name, bool inParentheses, bool *hasUndefinedVars) {
+    if (inParentheses) {
+        fprintf(stderr, "%s: name error: %s is not defined\n", SHELL_NAME, name);
+        return false;
+    }
+    if (hasUndefinedVars != NULL) {
+        SET_FUNCTION_STATUS(hasUndefinedVars, true);
+        fprintf(stderr, "%s: name error: %s is not defined\n", SHELL_NAME, name);
+    }
+    return true;
+}
 
-                char *varKey = varNameList->data;
-                char *varValue = getenv(varKey);
-                if (varValue == NULL && variables != NULL) {
-                    varValue = StringHashMap_get(variables, varKey);
-                }
+/**
+ * Appends the ${...} expression starting at the opening brace expr to output.
+ * Supports ${name}, ${name:-default}, ${#name}, ${name:offset} and ${name:offset:length};
+ * a negative offset or length counts from the end of the value
+ * name may be an array element like a[1], and ${#name} of an array is its number of elements
+ *
+ * Returns a pointer past the closing brace or NULL on error
+*/
+char* expandParameter(char *expr, CharList *output, bool inParentheses, bool *hasUndefinedVars) {
+    char *closeBrace = expr + 1;
+    int nestLevel = 1;
+    while (*closeBrace) {
+        if (*closeBrace == '{') {
+            nestLevel++;
+        } else if (*closeBrace == '}' && --nestLevel == 0) {
+            break;
+        }
+        closeBrace++;
+    }
 
-                if (varValue != NULL) {
-                    CharList_addStr(tempCmd, varValue);
-                } else if (inParentheses) {
-                    fprintf(stderr, "%s: name error: %s is not defined\n", SHELL_NAME, varKey);
-                    CharList_free(varNameList);
-                    CharList_free(tempCmd);
-                    return NULL;
-                } else if (hasUndefinedVars != NULL) {
-                    SET_FUNCTION_STATUS(hasUndefinedVars, true);
-                    fprintf(stderr, "%s: name error: %s is not defined\n", SHELL_NAME, varKey);
+    bool isLength = expr[1] == '#';
+    char *nameStart = expr + 1 + isLength;
+    char *nameEnd = nameStart;
+    while (nameEnd < closeBrace && *nameEnd != ':') {
+        nameEnd++;
+    }
+    if (!*closeBrace || nameEnd == nameStart || (isLength && nameEnd != closeBrace)) {
+        fprintf(stderr, "%s: syntax error: bad substitution\n", SHELL_NAME);
+        return NULL;
+    }
+
+    //Look the name up in place instead of copying it
+    char nameEndChr = *nameEnd;
+    *nameEnd = '\0';
+    char *value = getVariable(nameStart);
+    Array *lengthArray = isLength && arrays != NULL ? ArrayMap_get(arrays, nameStart) : NULL;
+    bool hasDefault = nameEnd[1] == '-' && nameEndChr == ':';
+    bool success = value != NULL || hasDefault
+        || handleUndefinedVariable(nameStart, inParentheses, hasUndefinedVars);
+    *nameEnd = nameEndChr;
+    if (!success) {
+        return NULL;
+    }
+    long valueLen = value != NULL ? (long) strlen(value) : 0;
+
+    if (isLength) {
+        char lengthStr[32];
+        snprintf(lengthStr, sizeof(lengthStr), "%ld", lengthArray != NULL ? (long) Array_size(lengthArray) : valueLen);
+        CharList_addStr(output, lengthStr);
+    } else if (nameEnd == closeBrace) {
+        CharList_addStrN(output, value, (int) valueLen);
+    } else if (hasDefault) {
+        if (valueLen > 0) {
+            CharList_addStrN(output, value, (int) valueLen);
+        } else {
+            //The default value may refer to other variables
+            char closeBraceChr = *closeBrace;
+            *closeBrace = '\0';
+            char *defaultValue = processVariables(nameEnd + 2, hasUndefinedVars);
+            if (defaultValue != NULL) {
+                CharList_addStr(output, defaultValue);
+                if (defaultValue != nameEnd + 2) {
+                    free(defaultValue);
                 }
-                CharList_free(varNameList);
-            } else {
-                CharList_add(tempCmd, *cmdCounter++);
+            }
+            *closeBrace = closeBraceChr;
+            if (defaultValue == NULL) {
+                return NULL;
             }
         }
+    } else {
+        char *indexPtr = nameEnd + 1;
+        long offset = 0;
+        long length = LONG_MAX;
+        char *endPtr;
+        offset = strtol(indexPtr, &endPtr, 10);
+        bool validIndex = endPtr != indexPtr;
+        if (validIndex && *endPtr == ':') {
+            indexPtr = endPtr + 1;
+            length = strtol(indexPtr, &endPtr, 10);
+            validIndex = endPtr != indexPtr;
+        }
+        if (!validIndex || endPtr != closeBrace) {
+            fprintf(stderr, "%s: syntax error: bad substitution\n", SHELL_NAME);
+            return NULL;
+        }
 
-        char *newCmd = CharList_toStr(tempCmd);
-        CharList_free(tempCmd);
-        return newCmd;
+        if (offset < 0) {
+            offset = offset + valueLen < 0 ? 0 : offset + valueLen;
+        } else if (offset > valueLen) {
+            offset = valueLen;
+        }
+        long end = length < 0 ? valueLen + length : (length > valueLen - offset ? valueLen : offset + length);
+        if (end > offset) {
+            CharList_addStrN(output, value + offset, (int) (end - offset));
+        }
     }
 
-    return cmd;
+    return closeBrace + 1;
+}
+
+/**
+ * Expands every $name and ${...} in cmd in a single pass
+ *
+ * Returns cmd itself if there is nothing to expand, a newly allocated string otherwise,
+ * or NULL on error
+*/
+char* processVariables(char *cmd, bool *hasUndefinedVars) {
+    if (strchr(cmd, VARIABLE_PREFIX) == NULL || !cmd[1]) {
+        return cmd;
+    }
+
+    //Values are usually short, so this is rarely resized
+    CharList *newCmdList = CharList_createCapacity((int) strlen(cmd) * 2 + 1);
+    bool inParentheses = false;
+    char *cmdCounter = cmd;
+
+    while (*cmdCounter) {
+        size_t literalLen = strcspn(cmdCounter, "()$");
+        CharList_addStrN(newCmdList, cmdCounter, (int) literalLen);
+        cmdCounter += literalLen;
+        if (*cmdCounter == '(' || *cmdCounter == ')') {
+            inParentheses = *cmdCounter == '(';
+            CharList_add(newCmdList, *cmdCounter++);
+            continue;
+        } else if (!*cmdCounter) {
+            break;
+        }
+
+        cmdCounter++;
+        if (*cmdCounter == '{') {
+            cmdCounter = expandParameter(cmdCounter, newCmdList, inParentheses, hasUndefinedVars);
+            if (cmdCounter == NULL) {
+                CharList_free(newCmdList);
+                return NULL;
+            }
+            continue;
+        }
+
+        char *varName = cmdCounter;
+        while (
+            *cmdCounter
+            && *cmdCounter != ' '
+            && *cmdCounter != ')'
+            && *cmdCounter != '"'
+            && *cmdCounter != ';'
+            && *cmdCounter != '&'
+            && *cmdCounter != '|'
+            && !MathParser_isAnyOperator(*cmdCounter)
+            && *cmdCounter != VARIABLE_PREFIX
+            && *cmdCounter != '['
+            && *cmdCounter != ']'
+            && *cmdCounter != '.'
+        ) {
+            cmdCounter++;
+        }
+        if (cmdCounter == varName) continue;
+
+        //$name[subscript] is an array element if name is an array
+        char *subscriptEnd;
+        if (*cmdCounter == '[' && arrays != NULL && (subscriptEnd = strchr(cmdCounter, ']')) != NULL) {
+            *cmdCounter = '\0';
+            bool isArray = ArrayMap_get(arrays, varName) != NULL;
+            *cmdCounter = '[';
+            if (isArray) {
+                cmdCounter = subscriptEnd + 1;
+            }
+        }
+
+        //Look the name up in place instead of copying it
+        char varNameEndChr = *cmdCounter;
+        *cmdCounter = '\0';
+        char *varValue = getVariable(varName);
+        bool success = true;
+        if (varValue != NULL) {
+            CharList_addStr(newCmdList, varValue);
+        } else {
+            success = handleUndefinedVariable(varName, inParentheses, hasUndefinedVars);
+        }
+        *cmdCounter = varNameEndChr;
+        if (!success) {
+            CharList_free(newCmdList);
+            return NULL;
+        }
+    }
+
+    char *newCmd = CharList_toStr(newCmdList);
+    CharList_free(newCmdList);
+    return newCmd;
 }
 
 void printIntro(void) {
@@ -1858,43 +3670,340 @@ void printIntro(void) {
 }
 
 char* getPrompt(void) {
-    if (getcwd(cwd, CWD_BUFFER_SIZE) == NULL) {
+    static PromptInfo info;
+    static char *defaultTemplate = NULL;
+    if (defaultTemplate == NULL) {
+        info.isRoot = isRootUser();
+        info.shellName = SHELL_NAME;
+        info.userName = pwd != NULL ? pwd->pw_name : Environment_get(environment, "USER");
+        if (info.userName == NULL) {
+            info.userName = "";
+        }
+        defaultTemplate = info.isRoot ? DEFAULT_ROOT_PROMPT : DEFAULT_PROMPT;
+    }
+
+    if (!*cwd) {
         fprintf(stderr, "%s: Error getting current working directory, exiting shell...\n", SHELL_NAME);
         exit(1);
     }
+    info.homeDir = getHomeDirectory();
+    info.cwd = cwd;
+    info.cwdVersion = cwdVersion;
+    info.exitStatus = lastExitStatus;
+    info.numJobs = numBackgroundCmds;
+
+    //The prompt template can be customized with the PS1 variable
+    char *template = variables != NULL ? StringHashMap_get(variables, "PS1") : NULL;
+    if (template == NULL) {
+        template = Environment_get(environment, "PS1");
+    }
+    if (template == NULL) {
+        template = defaultTemplate;
+    }
+    if (prompt == NULL || strcmp(Prompt_template(prompt), template) != 0) {
+        if (prompt != NULL) {
+            Prompt_free(prompt);
+        }
+        prompt = Prompt_create(template, &info);
+    }
+    return Prompt_render(prompt, &info);
+}
+
+typedef enum {
+    HIGHLIGHT_COMMAND, //Next word is a command name
+    HIGHLIGHT_ARGUMENT, //Next word is an argument
+    HIGHLIGHT_CONDITION, //Expecting the condition of an if or while statement
+    HIGHLIGHT_COUNT, //Expecting the count of a repeat statement
+    HIGHLIGHT_FOR_NAME, //Expecting the variable name of a for loop
+    HIGHLIGHT_FOR_IN, //Expecting the in keyword of a for loop
+    HIGHLIGHT_FOR_ITEMS //Expecting the items of a for loop
+} HighlightMode;
+
+typedef struct {
+    HighlightMode mode;
+    int conditionDepth; //Number of conditions that haven't been closed yet
+    bool seenIf; //Can an else keyword appear?
+} HighlightState;
+
+typedef struct {
+    size_t pos;
+    size_t len;
+    const char *style;
+} HighlightSpan;
+
+typedef struct {
+    size_t pos; //Position of the token in the input
+    HighlightState state; //Lexer state right before the token
+    size_t numSpans; //Number of spans before the token
+} HighlightCheckpoint;
+
+//Result of the previous highlighter call; when the input changes, lexing
+//resumes from the last token that starts before the first changed character
+static struct {
+    char *input;
+    HighlightSpan *spans;
+    size_t numSpans;
+    size_t spansCapacity;
+    HighlightCheckpoint *checkpoints;
+    size_t numCheckpoints;
+    size_t checkpointsCapacity;
+} highlightCache;
+
+void addHighlightSpan(size_t pos, size_t len, const char *style) {
+    if (highlightCache.numSpans == highlightCache.spansCapacity) {
+        highlightCache.spansCapacity = highlightCache.spansCapacity == 0 ? 16 : highlightCache.spansCapacity * 2;
+        highlightCache.spans = erealloc(highlightCache.spans, sizeof(HighlightSpan) * highlightCache.spansCapacity);
+    }
+    highlightCache.spans[highlightCache.numSpans++] = (HighlightSpan) {pos, len, style};
+}
+
+void addHighlightCheckpoint(size_t pos, HighlightState state) {
+    if (highlightCache.numCheckpoints == highlightCache.checkpointsCapacity) {
+        highlightCache.checkpointsCapacity = highlightCache.checkpointsCapacity == 0 ? 16 : highlightCache.checkpointsCapacity * 2;
+        highlightCache.checkpoints = erealloc(highlightCache.checkpoints, sizeof(HighlightCheckpoint) * highlightCache.checkpointsCapacity);
+    }
+    highlightCache.checkpoints[highlightCache.numCheckpoints++] = (HighlightCheckpoint) {pos, state, highlightCache.numSpans};
+}
+
+void freeHighlightCache(void) {
+    free(highlightCache.input);
+    free(highlightCache.spans);
+    free(highlightCache.checkpoints);
+    memset(&highlightCache, 0, sizeof(highlightCache));
+}
+
+bool isCommandName(char *word) {
+    if (strArrContains(builtinCommands, word, sizeof(builtinCommands) / sizeof(*builtinCommands))
+        || (aliases != NULL && StringHashMap_get(aliases, word) != NULL)
+    ) {
+        return true;
+    }
+    if (strchr(word, '/') != NULL) {
+        struct stat statbuf;
+        return stat(word, &statbuf) == 0 && !S_ISDIR(statbuf.st_mode) && access(word, X_OK) == 0;
+    }
+    if (pathIndex == NULL) {
+        pathIndex = PathIndex_create();
+    }
+    syncEnvironment(); //The index reads PATH from environ
+    return PathIndex_contains(pathIndex, word);
+}
+
+bool isHighlightWordChr(char c) {
+    return c && c != ' ' && !strchr(";&|()<>\"'", c) && c != VARIABLE_PREFIX;
+}
+
+/**
+ * Lexes input starting at pos with the given state and appends
+ * the resulting spans and checkpoints to highlightCache
+*/
+void highlightFrom(const char *input, size_t pos, HighlightState state) {
+    while (input[pos]) {
+        if (input[pos] == ' ') {
+            pos++;
+            continue;
+        }
 
-    //If in home directory, show ~ instead of /home/<username>
-    //Show red prompt if user is root, otherwise show regular prompt
-    char *promptTemplate;
-    if (isInHomeDirectory()) {
-        if (isRootUser()) {
-            promptTemplate = "\033[38;5;196;1m%s-root:\033[1;34m~%s\033[0m# ";
+        addHighlightCheckpoint(pos, state);
+        const char *chr = input + pos;
+        size_t len = 1;
+        if (*chr == COMMENT_CHAR && (pos == 0 || input[pos - 1] == ' ')) {
+            addHighlightSpan(pos, strlen(chr), "comment");
+            break;
+        } else if (*chr == ';' || *chr == '&' || *chr == '|') {
+            if ((*chr == '&' || *chr == '|') && chr[1] == *chr) {
+                len = 2;
+            }
+            if (*chr == ';') {
+                state.seenIf = false;
+            }
+            addHighlightSpan(pos, len, "control");
+            state.mode = HIGHLIGHT_COMMAND;
+        } else if (*chr == '>' || *chr == '<' || (isdigit(*chr) && (chr[1] == '>' || chr[1] == '<'))) {
+            //Redirections: >, >>, <, 2>, 2>>, 2>&1
+            if (isdigit(*chr)) len++;
+            if (chr[len - 1] == '>' && chr[len] == '>') {
+                len++;
+            } else if (chr[len - 1] == '>' && chr[len] == '&' && isdigit(chr[len + 1])) {
+                len += 2;
+            }
+            addHighlightSpan(pos, len, "control");
+        } else if (*chr == '"' || *chr == '\'') {
+            const char *closeQuote = strchr(chr + 1, *chr);
+            len = closeQuote != NULL ? (size_t) (closeQuote - chr) + 1 : strlen(chr);
+            addHighlightSpan(pos, len, closeQuote != NULL ? "string" : "ic-error");
+            state.mode = state.mode == HIGHLIGHT_FOR_ITEMS ? HIGHLIGHT_COMMAND : HIGHLIGHT_ARGUMENT;
+        } else if (*chr == VARIABLE_PREFIX && chr[1] == '{') {
+            const char *closeBrace = strchr(chr, '}');
+            len = closeBrace != NULL ? (size_t) (closeBrace - chr) + 1 : strlen(chr);
+            addHighlightSpan(pos, len, closeBrace != NULL ? "type" : "ic-error");
+            state.mode = state.mode == HIGHLIGHT_FOR_ITEMS ? HIGHLIGHT_COMMAND : HIGHLIGHT_ARGUMENT;
+        } else if (*chr == VARIABLE_PREFIX && isHighlightWordChr(chr[1])) {
+            while (isHighlightWordChr(chr[len])) {
+                len++;
+            }
+            addHighlightSpan(pos, len, "type");
+            state.mode = state.mode == HIGHLIGHT_FOR_ITEMS ? HIGHLIGHT_COMMAND : HIGHLIGHT_ARGUMENT;
+        } else if (*chr == '(' && state.mode == HIGHLIGHT_CONDITION) {
+            addHighlightSpan(pos, len, "control");
+            state.conditionDepth++;
+            state.mode = HIGHLIGHT_COMMAND;
+        } else if (*chr == '(') {
+            //Math expression, or the list of a for loop
+            int nestLevel = 0;
+            do {
+                if (chr[len - 1] == '(') {
+                    nestLevel++;
+                } else if (chr[len - 1] == ')') {
+                    nestLevel--;
+                }
+            } while (nestLevel > 0 && chr[len++]);
+            if (!chr[len - 1]) len--;
+            if (nestLevel != 0 || state.mode != HIGHLIGHT_FOR_ITEMS) {
+                addHighlightSpan(pos, len, nestLevel == 0 ? "number" : "ic-error");
+            }
+            bool endsHeader = state.mode == HIGHLIGHT_COUNT || state.mode == HIGHLIGHT_FOR_ITEMS;
+            state.mode = endsHeader ? HIGHLIGHT_COMMAND : HIGHLIGHT_ARGUMENT;
+        } else if (*chr == ')') {
+            if (state.conditionDepth > 0) {
+                addHighlightSpan(pos, len, "control");
+                state.conditionDepth--;
+                state.mode = HIGHLIGHT_COMMAND;
+            } else {
+                addHighlightSpan(pos, len, "ic-error");
+            }
         } else {
-            promptTemplate = "%s:\033[1;34m~%s\033[0m$ ";
+            len = *chr == VARIABLE_PREFIX;
+            while (isHighlightWordChr(chr[len])) {
+                len++;
+            }
+
+            char word[COMMAND_BUFFER_SIZE];
+            size_t wordLen = len < COMMAND_BUFFER_SIZE ? len : COMMAND_BUFFER_SIZE - 1;
+            memcpy(word, chr, wordLen);
+            word[wordLen] = '\0';
+
+            if (state.seenIf && state.mode != HIGHLIGHT_CONDITION && strcmp(word, "else") == 0) {
+                addHighlightSpan(pos, len, "keyword");
+                state.seenIf = false;
+                state.mode = HIGHLIGHT_COMMAND;
+            } else if (state.mode == HIGHLIGHT_FOR_NAME) {
+                addHighlightSpan(pos, len, "type");
+                state.mode = HIGHLIGHT_FOR_IN;
+            } else if (state.mode == HIGHLIGHT_FOR_IN) {
+                bool isIn = strcmp(word, "in") == 0;
+                addHighlightSpan(pos, len, isIn ? "keyword" : "ic-error");
+                state.mode = isIn ? HIGHLIGHT_FOR_ITEMS : HIGHLIGHT_ARGUMENT;
+            } else if (state.mode == HIGHLIGHT_FOR_ITEMS) {
+                state.mode = HIGHLIGHT_COMMAND;
+            } else if (state.mode == HIGHLIGHT_CONDITION || state.mode == HIGHLIGHT_COUNT) {
+                if (state.mode == HIGHLIGHT_COUNT && (*word == '-' || isdigit(*word))) {
+                    //Options of repeat and the number of jobs
+                } else if (state.mode == HIGHLIGHT_CONDITION && strcmp(word, "[") == 0) {
+                    state.mode = HIGHLIGHT_ARGUMENT;
+                } else {
+                    addHighlightSpan(pos, len, "ic-error");
+                    state.mode = HIGHLIGHT_ARGUMENT;
+                }
+            } else if (state.mode == HIGHLIGHT_COMMAND) {
+                if (strcmp(word, "if") == 0 || strcmp(word, "while") == 0) {
+                    addHighlightSpan(pos, len, "keyword");
+                    state.seenIf = state.seenIf || *word == 'i';
+                    state.mode = HIGHLIGHT_CONDITION;
+                } else if (strcmp(word, "repeat") == 0) {
+                    addHighlightSpan(pos, len, "keyword");
+                    state.mode = HIGHLIGHT_COUNT;
+                } else if (strcmp(word, "for") == 0) {
+                    addHighlightSpan(pos, len, "keyword");
+                    state.mode = HIGHLIGHT_FOR_NAME;
+                } else if (state.conditionDepth > 0 && strspn(word, "-") == wordLen) {
+                    //Negation of an if or while condition
+                    addHighlightSpan(pos, len, "control");
+                } else {
+                    if (!isCommandName(word)) {
+                        addHighlightSpan(pos, len, "ic-error");
+                    }
+                    state.mode = HIGHLIGHT_ARGUMENT;
+                }
+            }
         }
+        pos += len;
+    }
+}
 
-        size_t sizeNeeded = (size_t) snprintf(NULL, 0, promptTemplate, SHELL_NAME, (cwd + strlen(getHomeDirectory())));
-        char *prompt = emalloc(sizeNeeded + 1);
-        sprintf(prompt, promptTemplate, SHELL_NAME, (cwd + strlen(getHomeDirectory())));
-        return prompt;
-    } else {
-        if (isRootUser()) {
-            promptTemplate = "\033[38;5;196;1m%s-root:\033[1;34m%s\033[0m# ";
+/**
+ * Syntax highlighter for interactive input
+*/
+void highlightCommand(ic_highlight_env_t *henv, const char *input, void *arg) {
+    (void) arg;
+
+    //Find the first character that changed since the previous call
+    size_t prefixLen = 0;
+    if (highlightCache.input != NULL) {
+        while (input[prefixLen] && input[prefixLen] == highlightCache.input[prefixLen]) {
+            prefixLen++;
+        }
+    }
+    if (highlightCache.input == NULL || input[prefixLen] || highlightCache.input[prefixLen]) {
+        //Resume from the token before the last one that starts before the change,
+        //since a token can look ahead into the next one (e.g. 2>&1)
+        size_t resume = highlightCache.numCheckpoints;
+        while (resume > 0 && highlightCache.checkpoints[resume - 1].pos >= prefixLen) {
+            resume--;
+        }
+        if (resume > 0) {
+            resume--;
+        }
+        size_t pos = 0;
+        HighlightState state = {HIGHLIGHT_COMMAND, 0, false};
+        if (resume > 0) {
+            HighlightCheckpoint *checkpoint = &highlightCache.checkpoints[--resume];
+            pos = checkpoint->pos;
+            state = checkpoint->state;
+            highlightCache.numSpans = checkpoint->numSpans;
         } else {
-            promptTemplate = "%s:\033[1;34m%s\033[0m$ ";
+            highlightCache.numSpans = 0;
         }
+        highlightCache.numCheckpoints = resume;
+        highlightFrom(input, pos, state);
 
-        size_t sizeNeeded = (size_t) snprintf(NULL, 0, promptTemplate, SHELL_NAME, cwd);
-        char *prompt = emalloc(sizeNeeded + 1);
-        sprintf(prompt, promptTemplate, SHELL_NAME, cwd);
-        return prompt;
+        free(highlightCache.input);
+        highlightCache.input = strdup(input);
+    }
+
+    for (size_t i = 0; i < highlightCache.numSpans; i++) {
+        HighlightSpan *span = &highlightCache.spans[i];
+        ic_highlight(henv, (long) span->pos, (long) span->len, span->style);
     }
 }
 
 int main(int argc, char *argv[]) {
+    //Options come before the script file
+    //Syntax: alsh [--profile] [--trace <file>] [<script>]
+    char *tracePath = getenv("ALSH_TRACE");
+    int argIndex = 1;
+    for (; argIndex < argc && strncmp(argv[argIndex], "--", 2) == 0; argIndex++) {
+        if (strcmp(argv[argIndex], "--trace") == 0 && argIndex + 1 < argc) {
+            tracePath = argv[++argIndex];
+        } else if (strcmp(argv[argIndex], "--profile") == 0) {
+            Profiler_start();
+        } else {
+            fprintf(stderr, "%s: %s: invalid option\n", SHELL_NAME, argv[argIndex]);
+            exit(1);
+        }
+    }
+    if (tracePath != NULL && *tracePath && !Trace_start(tracePath)) {
+        fprintf(stderr, "%s: %s: %s\n", SHELL_NAME, tracePath, strerror(errno));
+    }
+    //Shells started from this one would write over the trace
+    unsetenv("ALSH_TRACE");
+
     char *cmd = emalloc(sizeof(char) * COMMAND_BUFFER_SIZE);
+    char **inheritedEnviron = environ;
+    environment = Environment_create(environ);
     executablePath = argv[0];
     pwd = getpwuid(getuid());
+    updateCwd();
     if (pwd == NULL && getHomeDirectory() == NULL) {
         fprintf(stderr, "%s: Could not determine home directory\n", SHELL_NAME);
         fprintf(stderr, "Please make sure the HOME environment variable is defined\n");
@@ -1903,14 +4012,14 @@ int main(int argc, char *argv[]) {
     }
 
     int exitStatus = 0;
-    if (argc > 1) {
-        FILE *fp = fopen(argv[1], "r");
+    if (argIndex < argc) {
+        FILE *fp = fopen(argv[argIndex], "r");
         if (fp == NULL) {
-            fprintf(stderr, "%s: %s: No such file or directory\n", SHELL_NAME, argv[1]);
+            fprintf(stderr, "%s: %s: No such file or directory\n", SHELL_NAME, argv[argIndex]);
             free(cmd);
             exit(1);
         }
-        exitStatus = processFile(cmd, fp, processCommand, true);
+        exitStatus = processFile(cmd, fp, argv[argIndex], processCommand, true);
     } else {
         bool stdinFromTerminal = isatty(STDIN_FILENO);
         if (stdinFromTerminal) {
@@ -1949,7 +4058,7 @@ int main(int argc, char *argv[]) {
             strcat(alshrc, "/.alshrc");
             FILE *alshrcfp = fopen(alshrc, "r");
             if (alshrcfp != NULL) {
-                (void) processFile(cmd, alshrcfp, processCommand, true);
+                (void) processFile(cmd, alshrcfp, alshrc, processCommand, true);
             }
 #endif
             struct sigaction sa1 = {
@@ -1961,10 +4070,18 @@ int main(int argc, char *argv[]) {
             sigemptyset(&sa1.sa_mask);
             sigemptyset(&sa2.sa_mask);
             sigaction(SIGINT, &sa1, NULL);
-            sigaction(SIGCHLD, &sa2, NULL);
+
+            //Without an event loop, background commands are reaped by the SIGCHLD handler
+            eventLoop = EventLoop_create();
+            if (eventLoop != NULL) {
+                ic_set_input_event(EventLoop_fd(eventLoop), handleInputEvent, NULL);
+            } else {
+                sigaction(SIGCHLD, &sa2, NULL);
+            }
 
             ic_set_prompt_marker("", "> ");
             ic_enable_multiline(false);
+            ic_set_default_highlighter(highlightCommand, NULL);
 
             setvbuf(stdout, NULL, _IONBF, 0);
             printIntro();
@@ -1978,10 +4095,9 @@ int main(int argc, char *argv[]) {
             sigchldReceived = false;
             ic_pressed_ctrlC = false;
             char *input = NULL;
-            char *prompt = NULL;
             while (
                 (stdinFromTerminal
-                ? (input = ic_readline(prompt = getPrompt(), &ic_pressed_ctrlC))
+                ? (input = ic_readline(getPrompt(), &ic_pressed_ctrlC))
                 : fgets(cmd, COMMAND_BUFFER_SIZE, stdin)) != NULL
             ) {
                 if (input != NULL) {
@@ -1989,10 +4105,6 @@ int main(int argc, char *argv[]) {
                     free(input);
                     input = NULL;
                 }
-                if (prompt != NULL) {
-                    free(prompt);
-                    prompt = NULL;
-                }
                 printBgCmdDoneMessageIfExists();
                 removeNewlineIfExists(cmd);
                 bool trimSuccess = trimWhitespaceFromEnds(cmd);
@@ -2033,6 +4145,10 @@ int main(int argc, char *argv[]) {
                             }
                         }
                     }
+                    if (!stdinFromTerminal) {
+                        //Same as in processFile, for a script read from stdin
+                        fflush(stdin);
+                    }
                     if (*cmd != COMMENT_CHAR) {
                         size_t exitCmdLen = strlen(EXIT_COMMAND);
                         if (strncmp(cmd, EXIT_COMMAND, exitCmdLen) == 0
@@ -2044,10 +4160,12 @@ int main(int argc, char *argv[]) {
                         if (fgAfterBgCmd && numBackgroundCmds > 0) {
                             //User runs foreground commands after background commands
                             isBackgroundCmd = false;
-                            processCommand(cmd);
-                            isBackgroundCmd = true;
+                            lastExitStatus = processCommand(cmd);
+                            //A job pool may have reaped the background commands in the meantime
+                            isBackgroundCmd = numBackgroundCmds > 0;
                         } else {
                             int cmdStatus = processCommand(cmd);
+                            lastExitStatus = cmdStatus;
                             if (!stdinFromTerminal) {
                                 exitStatus = cmdStatus;
                             }
@@ -2068,6 +4186,7 @@ int main(int argc, char *argv[]) {
                     if (sigchldReceived) {
                         sigchldReceived = false;
                     }
+                    printBgCmdDoneMessageIfExists();
                 }
             }
 
@@ -2081,10 +4200,6 @@ int main(int argc, char *argv[]) {
             } else if (stdinFromTerminal) {
                 printf("%s\n", EXIT_COMMAND);
             }
-
-            if (prompt != NULL) {
-                free(prompt);
-            }
         } while (sigintReceived || ic_pressed_ctrlC || sigchldReceived);
 
         //Kill any remaining background processes on shell exit
@@ -2100,6 +4215,16 @@ int main(int argc, char *argv[]) {
 
         clearHistoryElements();
         free(history.elements);
+        freeHighlightCache();
+        if (prompt != NULL) {
+            Prompt_free(prompt);
+        }
+        if (pathIndex != NULL) {
+            PathIndex_free(pathIndex);
+        }
+        if (eventLoop != NULL) {
+            EventLoop_free(eventLoop);
+        }
     }
 
     StringHashMap *hashMapsToFree[] = {aliases, variables};
@@ -2108,7 +4233,13 @@ int main(int argc, char *argv[]) {
             StringHashMap_free(hashMapsToFree[i]);
         }
     }
+    if (arrays != NULL) {
+        ArrayMap_free(arrays);
+    }
+    ResourceLimits_free(defaultLimits);
 
+    environ = inheritedEnviron;
+    Environment_free(environment);
     free(cmd);
     return exitStatus;
 }
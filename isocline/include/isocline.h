@@ -374,6 +374,21 @@ bool ic_enable_hint(bool enable);
 /// Set millisecond delay before a hint is displayed. Can be zero. (500ms by default).
 long ic_set_hint_delay(long delay_ms);
 
+/// Disable or enable autosuggestions (enabled by default).
+/// While the cursor is at the end of the input, the most recent history entry
+/// that starts with the input is shown inline; `right` or `end` accepts it.
+/// @returns the previous setting.
+bool ic_enable_autosuggest(bool enable);
+
+/// Disable or enable typeahead batching (enabled by default).
+/// When keys arrive faster than they can be displayed, all pending
+/// input is applied first and the input is refreshed only once.
+/// @returns the previous setting.
+bool ic_enable_typeahead(bool enable);
+
+/// Get the number of refreshes skipped so far because more input was pending.
+long ic_get_refresh_skipped(void);
+
 /// Disable or enable syntax highlighting (enabled by default).
 /// This applies regardless whether a syntax highlighter callback was set (`ic_set_highlighter`)
 /// Returns the previous setting.
@@ -579,6 +594,14 @@ void ic_term_reset( void );
 /// - 24: true-color terminal with full RGB colors. (`truecolor`/`24bit`/`direct`)
 int ic_term_get_color_bits( void );
 
+/// Get the total number of bytes written to the terminal so far.
+/// Useful to measure the cost of redrawing the input.
+long ic_term_get_bytes_written( void );
+
+/// Get the total number of write calls made to the terminal so far.
+/// A refresh of the input is written in one call.
+long ic_term_get_write_calls( void );
+
 /// \}
 
 //--------------------------------------------------------------
@@ -594,6 +617,17 @@ int ic_term_get_color_bits( void );
 /// functional on Linux, macOS and Windows).
 bool ic_async_stop(void);
 
+/// Callback that is called by readline when the input event file descriptor is readable.
+typedef void (ic_input_event_fun_t)(void* arg);
+
+/// Watch a file descriptor while readline waits for a key, like the file descriptor
+/// of an event loop or a pipe that a background thread writes to. Whenever `fd` is readable,
+/// the input is cleared, `fun` is called and the input is redrawn below anything `fun` printed.
+/// Output of `fun` (using `printf` etc.) should end with a newline.
+/// Pass a `NULL` function to stop watching.
+/// (Only supported on Unix systems).
+void ic_set_input_event(int fd, ic_input_event_fun_t* fun, void* arg);
+
 /// \}
 
 //--------------------------------------------------------------
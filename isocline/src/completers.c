@@ -60,7 +60,7 @@ ic_public void ic_complete_word(ic_completion_env_t* cenv, const char* prefix, i
   word_closure_t wenv;
   wenv.delete_before_adjust = (long)(len - pos);
   wenv.prev_complete = cenv->complete;
-  wenv.prev_env = cenv->env;
+  wenv.prev_env = cenv->closure;
   cenv->complete = &token_add_completion_ex;
   cenv->closure = &wenv;
 
@@ -236,7 +236,7 @@ ic_public void ic_complete_qword_ex( ic_completion_env_t* cenv, const char* pref
   wenv.escape_char    = escape_char;
   wenv.delete_before_adjust = (long)(len - pos);
   wenv.prev_complete  = cenv->complete;
-  wenv.prev_env       =  cenv->env;
+  wenv.prev_env       = cenv->closure;
   wenv.sbuf = sbuf_new(cenv->env->mem);
   if (wenv.sbuf == NULL) { mem_free(cenv->env->mem, word); return; }
   cenv->complete = &qword_add_completion_ex;
@@ -261,6 +261,7 @@ ic_public void ic_complete_qword_ex( ic_completion_env_t* cenv, const char* pref
 // Listing files
 //-------------------------------------------------------------
 #include <stdlib.h>
+#include <time.h>
 
 typedef enum file_type_e {
   // must follow BSD style LSCOLORS order
@@ -419,6 +420,34 @@ static const char* os_direntry_name(dir_entry* entry) {
   return entry->name;  
 }
 
+// what we know about an entry without a stat: 1 if a directory, 0 if not, -1 if unknown.
+static int os_direntry_isdir(dir_entry* entry, file_type_t* ft, bool* ft_known) {
+  ic_unused(ft);
+  *ft_known = false;
+  return ((entry->attrib & _A_SUBDIR) != 0 ? 1 : 0);
+}
+
+typedef struct dir_stamp_s {
+  __time64_t mtime;
+  __int64    size;
+} dir_stamp_t;
+
+static bool os_dir_stamp(const char* cpath, dir_stamp_t* stamp) {
+  struct _stat64 st = { 0 };
+  if (_stat64(cpath, &st) != 0 || (st.st_mode & _S_IFDIR) == 0) return false;
+  stamp->mtime = st.st_mtime;
+  stamp->size  = st.st_size;
+  return true;
+}
+
+static bool os_dir_stamp_eq(const dir_stamp_t* s1, const dir_stamp_t* s2) {
+  return (s1->mtime == s2->mtime && s1->size == s2->size);
+}
+
+static time_t os_dir_stamp_mtime(const dir_stamp_t* stamp) {
+  return (time_t)stamp->mtime;
+}
+
 static bool os_path_is_absolute( const char* path ) {
   if (path != NULL && path[0] != 0 && path[1] == ':' && (path[2] == '\\' || path[2] == '/' || path[2] == 0)) {
     char drive = path[0];
@@ -500,6 +529,50 @@ static const char* os_direntry_name(dir_entry* entry) {
   return (*entry)->d_name;  
 }
 
+// what we know about an entry without a stat: 1 if a directory, 0 if not, -1 if unknown.
+// the file type is set as well if `d_type` determines it completely.
+static int os_direntry_isdir(dir_entry* entry, file_type_t* ft, bool* ft_known) {
+  *ft_known = false;
+  #if defined(DT_UNKNOWN)
+  switch ((*entry)->d_type) {
+    case DT_DIR:  return 1;   // ft needs the mode bits (sticky, setuid, ...)
+    case DT_REG:  return 0;   // ft needs the mode bits (executable)
+    case DT_LNK:  *ft = FT_SYM;   *ft_known = true; return -1;  // follow the link to see if it is a directory
+    case DT_FIFO: *ft = FT_PIPE;  *ft_known = true; return 0;
+    case DT_SOCK: *ft = FT_SOCK;  *ft_known = true; return 0;
+    case DT_CHR:  *ft = FT_CHAR;  *ft_known = true; return 0;
+    case DT_BLK:  *ft = FT_BLOCK; *ft_known = true; return 0;
+    default:      return -1;
+  }
+  #else
+  ic_unused(entry); ic_unused(ft);
+  return -1;
+  #endif
+}
+
+typedef struct dir_stamp_s {
+  dev_t  dev;
+  ino_t  ino;
+  time_t mtime;
+} dir_stamp_t;
+
+static bool os_dir_stamp(const char* cpath, dir_stamp_t* stamp) {
+  struct stat st;
+  if (stat(cpath, &st) != 0 || !S_ISDIR(st.st_mode)) return false;
+  stamp->dev   = st.st_dev;
+  stamp->ino   = st.st_ino;
+  stamp->mtime = st.st_mtime;
+  return true;
+}
+
+static bool os_dir_stamp_eq(const dir_stamp_t* s1, const dir_stamp_t* s2) {
+  return (s1->dev == s2->dev && s1->ino == s2->ino && s1->mtime == s2->mtime);
+}
+
+static time_t os_dir_stamp_mtime(const dir_stamp_t* stamp) {
+  return stamp->mtime;
+}
+
 static bool os_path_is_absolute( const char* path ) {
   return (path != NULL && path[0] == '/');
 }
@@ -548,46 +621,229 @@ static bool match_extension(const char* name, const char* extensions) {
   return false;
 }
 
+//-------------------------------------------------------------
+// Directory listing cache
+// Completing in a large directory would otherwise read the whole
+// directory and stat every entry on each tab (and on each hint).
+// We keep the last few listings sorted by name, and reuse them as
+// long as the directory is not modified. Stats are only done for
+// entries that are actually shown, and the result is remembered.
+//-------------------------------------------------------------
+
+#define IC_DIRCACHE_SLOTS  (4)
+
+typedef struct dir_item_s {
+  const char* name;      // points into the `names` of the listing
+  ssize_t     name_ofs;  // offset of the name in `names` (while loading)
+  file_type_t ft;        // file type, only valid if `ft_known`
+  bool        ft_known;
+  int8_t      isdir;     // 1 if a directory, 0 if not, -1 if unknown (needs a stat)
+} dir_item_t;
+
+typedef struct dir_listing_s {
+  char*         path;      // directory path as given to `os_findfirst` (NULL if the slot is free)
+  dir_stamp_t   stamp;     // identity and modification time of the directory when it was read
+  time_t        loaded;    // time at which the directory was read
+  unsigned long used;      // last use (for LRU eviction)
+  char*         names;     // all names, 0 terminated
+  ssize_t       names_len;
+  ssize_t       names_cap;
+  dir_item_t*   items;     // sorted on name (ignoring case)
+  ssize_t       count;
+  ssize_t       cap;
+} dir_listing_t;
+
+struct dir_cache_s {
+  dir_listing_t listings[IC_DIRCACHE_SLOTS];
+  unsigned long tick;
+};
+
+static void dir_listing_clear(alloc_t* mem, dir_listing_t* dl) {
+  mem_free(mem, dl->path);
+  mem_free(mem, dl->names);
+  mem_free(mem, dl->items);
+  memset(dl, 0, sizeof(*dl));
+}
+
+ic_private void dircache_free(alloc_t* mem, dir_cache_t* dc) {
+  if (dc == NULL) return;
+  for (ssize_t i = 0; i < IC_DIRCACHE_SLOTS; i++) {
+    dir_listing_clear(mem, &dc->listings[i]);
+  }
+  mem_free(mem, dc);
+}
+
+static bool dir_listing_push(alloc_t* mem, dir_listing_t* dl, const char* name, file_type_t ft, bool ft_known, int isdir) {
+  ssize_t len = ic_strlen(name);
+  if (dl->names_len + len + 1 > dl->names_cap) {
+    ssize_t newcap = (dl->names_cap <= 0 ? 1024 : 2*dl->names_cap);
+    while (newcap < dl->names_len + len + 1) { newcap *= 2; }
+    char* newnames = mem_realloc_tp(mem, char, dl->names, newcap);
+    if (newnames == NULL) return false;
+    dl->names = newnames;
+    dl->names_cap = newcap;
+  }
+  if (dl->count >= dl->cap) {
+    ssize_t newcap = (dl->cap <= 0 ? 64 : 2*dl->cap);
+    dir_item_t* newitems = mem_realloc_tp(mem, dir_item_t, dl->items, newcap);
+    if (newitems == NULL) return false;
+    dl->items = newitems;
+    dl->cap = newcap;
+  }
+  ic_memcpy(dl->names + dl->names_len, name, len + 1);
+  dir_item_t* item = &dl->items[dl->count++];
+  item->name     = NULL;
+  item->name_ofs = dl->names_len;
+  item->ft       = (ft_known ? ft : FT_DEFAULT);
+  item->ft_known = ft_known;
+  item->isdir    = (int8_t)isdir;
+  dl->names_len += len + 1;
+  return true;
+}
+
+// compare names ignoring case; bytes are compared unsigned so UTF-8
+// names sort after ASCII ones, as `ic_istarts_with` expects when scanning.
+static int dir_name_compare(const char* s1, const char* s2) {
+  ssize_t i;
+  for (i = 0; s1[i] != 0; i++) {
+    const uint8_t c1 = (uint8_t)ic_tolower(s1[i]);
+    const uint8_t c2 = (uint8_t)ic_tolower(s2[i]);
+    if (c1 < c2) return -1;
+    if (c1 > c2) return 1;
+  }
+  return (s2[i] == 0 ? 0 : -1);
+}
+
+static int dir_item_compare(const void* p1, const void* p2) {
+  const dir_item_t* item1 = (const dir_item_t*)p1;
+  const dir_item_t* item2 = (const dir_item_t*)p2;
+  return dir_name_compare(item1->name, item2->name);
+}
+
+static bool dir_listing_load(alloc_t* mem, dir_listing_t* dl, const char* path, const dir_stamp_t* stamp) {
+  dir_cursor d = 0;
+  dir_entry entry;
+  dl->path = mem_strdup(mem, path);
+  if (dl->path == NULL) return false;
+  dl->stamp  = *stamp;
+  dl->loaded = time(NULL);
+  if (os_findfirst(mem, path, &d, &entry)) {
+    do {
+      const char* name = os_direntry_name(&entry);
+      if (name == NULL || strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
+      file_type_t ft = FT_DEFAULT;
+      bool ft_known = false;
+      int isdir = os_direntry_isdir(&entry, &ft, &ft_known);
+      if (!dir_listing_push(mem, dl, name, ft, ft_known, isdir)) {
+        os_findclose(d);
+        dir_listing_clear(mem, dl);
+        return false;
+      }
+    } while (os_findnext(d, &entry));
+    os_findclose(d);
+  }
+  // the names buffer is stable now
+  for (ssize_t i = 0; i < dl->count; i++) {
+    dl->items[i].name = dl->names + dl->items[i].name_ofs;
+  }
+  if (dl->count > 1) {
+    qsort(dl->items, to_size_t(dl->count), sizeof(dl->items[0]), &dir_item_compare);
+  }
+  return true;
+}
+
+// Return the (cached) listing of directory `path`, or NULL if it cannot be read.
+static dir_listing_t* dircache_lookup(ic_env_t* env, const char* path) {
+  dir_stamp_t stamp;
+  if (!os_dir_stamp(path, &stamp)) return NULL;
+  if (env->dircache == NULL) {
+    env->dircache = mem_zalloc_tp(env->mem, dir_cache_t);
+    if (env->dircache == NULL) return NULL;
+  }
+  dir_cache_t* dc = env->dircache;
+  dc->tick++;
+  dir_listing_t* slot = NULL;
+  for (ssize_t i = 0; i < IC_DIRCACHE_SLOTS; i++) {
+    dir_listing_t* dl = &dc->listings[i];
+    if (dl->path != NULL && strcmp(dl->path, path) == 0) {
+      // a directory modified in the same second it was read may have changed since
+      if (os_dir_stamp_eq(&dl->stamp, &stamp) && os_dir_stamp_mtime(&stamp) < dl->loaded) {
+        dl->used = dc->tick;
+        return dl;
+      }
+      slot = dl;
+      break;
+    }
+    if (slot == NULL || (slot->path != NULL && (dl->path == NULL || dl->used < slot->used))) {
+      slot = dl;
+    }
+  }
+  dir_listing_clear(env->mem, slot);
+  if (!dir_listing_load(env->mem, slot, path, &stamp)) return NULL;
+  slot->used = dc->tick;
+  return slot;
+}
+
+// index of the first item that is not smaller than `prefix`; all
+// items starting with `prefix` (ignoring case) follow from there.
+static ssize_t dir_listing_find(const dir_listing_t* dl, const char* prefix) {
+  ssize_t lo = 0;
+  ssize_t hi = dl->count;
+  while (lo < hi) {
+    ssize_t mid = lo + (hi - lo)/2;
+    if (dir_name_compare(dl->items[mid].name, prefix) < 0) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+// stat an item if we need information that readdir did not give us.
+static void dir_item_resolve(dir_item_t* item, stringbuf_t* dir, bool need_ft) {
+  if (item->isdir >= 0 && (item->ft_known || !need_ft)) return;
+  const ssize_t dlen = sbuf_len(dir);
+  sbuf_append_char(dir, ic_dirsep());
+  sbuf_append(dir, item->name);
+  if (need_ft && !item->ft_known) {
+    item->ft = os_get_filetype(sbuf_string(dir));
+    item->ft_known = true;
+  }
+  if (item->isdir < 0) {
+    item->isdir = (os_is_dir(sbuf_string(dir)) ? 1 : 0);
+  }
+  sbuf_delete_from(dir, dlen);  // restore dir
+}
+
 static bool filename_complete_indir( ic_completion_env_t* cenv, stringbuf_t* dir, 
                                       stringbuf_t* dir_prefix, stringbuf_t* display,
                                        const char* base_prefix, 
                                         char dir_sep, const char* extensions ) 
 {
-  dir_cursor d = 0;
-  dir_entry entry;
+  dir_listing_t* dl = dircache_lookup(cenv->env, sbuf_string(dir));
+  if (dl == NULL) return true;
+  // the file type is only needed for coloring
+  const bool need_ft = (!cenv->env->no_lscolors && ls_colors_init());
   bool cont = true;
-  if (os_findfirst(cenv->env->mem, sbuf_string(dir), &d, &entry)) {
-    do {
-      const char* name = os_direntry_name(&entry);
-      if (name != NULL && strcmp(name, ".") != 0 && strcmp(name, "..") != 0 && 
-          ic_istarts_with(name, base_prefix))
-      {
-        // possible match, first check if it is a directory
-        file_type_t ft;
-        bool isdir;
-        const ssize_t plen = sbuf_len(dir_prefix);
-        sbuf_append(dir_prefix, name);
-        { // check directory and potentially add a dirsep to the dir_prefix
-          const ssize_t dlen = sbuf_len(dir);
-          sbuf_append_char(dir,ic_dirsep());
-          sbuf_append(dir,name);
-          ft = os_get_filetype(sbuf_string(dir));
-          isdir = os_is_dir(sbuf_string(dir));
-          if (isdir && dir_sep != 0) {
-            sbuf_append_char(dir_prefix,dir_sep); 
-          }
-          sbuf_delete_from(dir,dlen);  // restore dir
-        }
-        if (isdir || match_extension(name, extensions)) {
-          // add completion
-          sbuf_clear(display);
-          ls_colorize(cenv->env->no_lscolors, display, ft, name, NULL, (isdir ? dir_sep : 0));
-          cont = ic_add_completion_ex(cenv, sbuf_string(dir_prefix), sbuf_string(display), NULL);
-        }
-        sbuf_delete_from( dir_prefix, plen ); // restore dir_prefix
+  for (ssize_t i = dir_listing_find(dl, base_prefix); cont && i < dl->count; i++) {
+    dir_item_t* item = &dl->items[i];
+    if (!ic_istarts_with(item->name, base_prefix)) break;  // past all matches
+    dir_item_resolve(item, dir, need_ft);
+    const bool isdir = (item->isdir > 0);
+    if (isdir || match_extension(item->name, extensions)) {
+      // add completion
+      const ssize_t plen = sbuf_len(dir_prefix);
+      sbuf_append(dir_prefix, item->name);
+      if (isdir && dir_sep != 0) {
+        sbuf_append_char(dir_prefix, dir_sep);
       }
-    } while (cont && os_findnext(d, &entry));
-    os_findclose(d);
+      sbuf_clear(display);
+      ls_colorize(cenv->env->no_lscolors, display, (item->ft_known ? item->ft : FT_DEFAULT), item->name, NULL, (isdir ? dir_sep : 0));
+      cont = ic_add_completion_ex(cenv, sbuf_string(dir_prefix), sbuf_string(display), NULL);
+      sbuf_delete_from( dir_prefix, plen ); // restore dir_prefix
+    }
   }
   return cont;
 }
@@ -14,6 +14,13 @@
 #include "stringbuf.h"
 #include "completions.h"
 
+#if defined(IC_ASYNC_COMPLETIONS)
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#endif
+
 
 //-------------------------------------------------------------
 // Completions
@@ -25,8 +32,19 @@ typedef struct completion_s {
   const char* help;
   ssize_t     delete_before;
   ssize_t     delete_after;
+  size_t      hash;          // hash of the replacement
 } completion_t;
 
+// The strings of all completions are bump allocated from a list of blocks
+// that is reset as a whole on `completions_clear` (only the first block is kept).
+typedef struct string_block_s {
+  struct string_block_s* next;
+  ssize_t size;
+  ssize_t used;
+} string_block_t;
+
+#define IC_STRING_BLOCK_SIZE  (16*1024)
+
 struct completions_s {
   ic_completer_fun_t* completer;
   void* completer_arg;
@@ -34,10 +52,15 @@ struct completions_s {
   ssize_t count;
   ssize_t len;
   completion_t* elems;
+  string_block_t* strings;     // arena for the completion strings
+  ssize_t* index;              // open addressing hash set of `elems` indices (+1) keyed by replacement
+  ssize_t index_len;           // always 0 or a power of 2
   alloc_t* mem;
+  completions_async_t* async;  // background worker (created on demand)
 };
 
 static void default_filename_completer( ic_completion_env_t* cenv, const char* prefix );
+static void completions_async_free(completions_async_t* ca);
 
 ic_private completions_t* completions_new(alloc_t* mem) {
   completions_t* cms = mem_zalloc_tp(mem, completions_t);
@@ -47,8 +70,18 @@ ic_private completions_t* completions_new(alloc_t* mem) {
   return cms;
 }
 
+static void completions_free_strings(completions_t* cms, string_block_t* block) {
+  while (block != NULL) {
+    string_block_t* next = block->next;
+    mem_free(cms->mem, block);
+    block = next;
+  }
+}
+
 ic_private void completions_free(completions_t* cms) {
   if (cms == NULL) return;
+  completions_async_free(cms->async);
+  cms->async = NULL;
   completions_clear(cms);  
   if (cms->elems != NULL) {
     mem_free(cms->mem, cms->elems);
@@ -56,22 +89,91 @@ ic_private void completions_free(completions_t* cms) {
     cms->count = 0;
     cms->len = 0;
   }
+  completions_free_strings(cms, cms->strings);
+  cms->strings = NULL;
+  mem_free(cms->mem, cms->index);
+  cms->index = NULL;
+  cms->index_len = 0;
   mem_free(cms->mem, cms); // free ourselves
 }
 
 
 ic_private void completions_clear(completions_t* cms) {  
-  while (cms->count > 0) {
-    completion_t* cm = cms->elems + cms->count - 1;
-    mem_free( cms->mem, cm->display);
-    mem_free( cms->mem, cm->replacement);
-    mem_free( cms->mem, cm->help);
-    memset(cm,0,sizeof(*cm));
-    cms->count--;    
+  cms->count = 0;
+  if (cms->strings != NULL) {
+    completions_free_strings(cms, cms->strings->next);
+    cms->strings->next = NULL;
+    cms->strings->used = 0;
+  }
+  if (cms->index != NULL) {
+    memset(cms->index, 0, to_size_t(cms->index_len) * sizeof(cms->index[0]));
   }
 }
 
-static void completions_push(completions_t* cms, const char* replacement, const char* display, const char* help, ssize_t delete_before, ssize_t delete_after) 
+static const char* completions_strdup(completions_t* cms, const char* s) {
+  if (s == NULL) return NULL;
+  ssize_t n = ic_strlen(s) + 1;
+  string_block_t* block = cms->strings;
+  if (block == NULL || block->size - block->used < n) {
+    ssize_t size = (n > IC_STRING_BLOCK_SIZE ? n : IC_STRING_BLOCK_SIZE);
+    block = (string_block_t*)mem_malloc(cms->mem, ssizeof(string_block_t) + size);
+    if (block == NULL) return NULL;
+    block->size = size;
+    block->used = 0;
+    if (cms->strings != NULL && n > IC_STRING_BLOCK_SIZE) {
+      // keep filling the current block; a large string gets its own block behind it
+      block->next = cms->strings->next;
+      cms->strings->next = block;
+    }
+    else {
+      block->next = cms->strings;
+      cms->strings = block;
+    }
+  }
+  char* p = (char*)(block + 1) + block->used;
+  memcpy(p, s, to_size_t(n));
+  block->used += n;
+  return p;
+}
+
+static size_t completions_hash(const char* s) {
+  size_t h = 2166136261U;  // FNV-1a
+  for (; *s != 0; s++) {
+    h = (h ^ (uint8_t)(*s)) * 16777619U;
+  }
+  return h;
+}
+
+static void completions_index_insert(completions_t* cms, ssize_t i) {
+  size_t mask = to_size_t(cms->index_len) - 1;
+  size_t slot = cms->elems[i].hash & mask;
+  while (cms->index[slot] != 0) { slot = (slot + 1) & mask; }
+  cms->index[slot] = i + 1;
+}
+
+static void completions_index_rebuild(completions_t* cms) {
+  if (cms->index == NULL) return;
+  memset(cms->index, 0, to_size_t(cms->index_len) * sizeof(cms->index[0]));
+  for (ssize_t i = 0; i < cms->count; i++) {
+    completions_index_insert(cms, i);
+  }
+}
+
+// keep the load of the hash set at most 1/2
+static bool completions_index_reserve(completions_t* cms, ssize_t count) {
+  if (2*count <= cms->index_len) return true;
+  ssize_t newlen = (cms->index_len <= 0 ? 64 : cms->index_len*2);
+  while (2*count > newlen) { newlen *= 2; }
+  ssize_t* newindex = mem_malloc_tp_n(cms->mem, ssize_t, newlen);
+  if (newindex == NULL) return false;
+  mem_free(cms->mem, cms->index);
+  cms->index = newindex;
+  cms->index_len = newlen;
+  completions_index_rebuild(cms);
+  return true;
+}
+
+static void completions_push(completions_t* cms, const char* replacement, const char* display, const char* help, ssize_t delete_before, ssize_t delete_after, size_t hash) 
 {
   if (cms->count >= cms->len) {
     ssize_t newlen = (cms->len <= 0 ? 32 : cms->len*2);
@@ -80,13 +182,17 @@ static void completions_push(completions_t* cms, const char* replacement, const
     cms->elems = newelems;
     cms->len   = newlen;
   }
+  if (!completions_index_reserve(cms, cms->count + 1)) return;
   assert(cms->count < cms->len);
   completion_t* cm  = cms->elems + cms->count;
-  cm->replacement   = mem_strdup(cms->mem,replacement);
-  cm->display       = mem_strdup(cms->mem,display);
-  cm->help          = mem_strdup(cms->mem,help);
+  cm->replacement   = completions_strdup(cms,replacement);
+  if (cm->replacement == NULL) return;
+  cm->display       = completions_strdup(cms,display);
+  cm->help          = completions_strdup(cms,help);
   cm->delete_before = delete_before;
   cm->delete_after  = delete_after;
+  cm->hash          = hash;
+  completions_index_insert(cms, cms->count);
   cms->count++;
 }
 
@@ -94,10 +200,12 @@ ic_private ssize_t completions_count(completions_t* cms) {
   return cms->count;
 }
 
-static bool completions_contains(completions_t* cms, const char* replacement) {
-  for( ssize_t i = 0; i < cms->count; i++ ) {
-    const completion_t* c = cms->elems + i;
-    if (strcmp(replacement,c->replacement) == 0) { return true; }
+static bool completions_contains(completions_t* cms, const char* replacement, size_t hash) {
+  if (cms->index == NULL) return false;
+  size_t mask = to_size_t(cms->index_len) - 1;
+  for (size_t slot = hash & mask; cms->index[slot] != 0; slot = (slot + 1) & mask) {
+    const completion_t* c = cms->elems + cms->index[slot] - 1;
+    if (c->hash == hash && strcmp(replacement,c->replacement) == 0) { return true; }
   }
   return false;
 } 
@@ -106,12 +214,35 @@ ic_private bool completions_add(completions_t* cms, const char* replacement, con
   if (cms->completer_max <= 0) return false;
   cms->completer_max--;
   //debug_msg("completion: add: %d,%d, %s\n", delete_before, delete_after, replacement);
-  if (!completions_contains(cms,replacement)) {
-    completions_push(cms, replacement, display, help, delete_before, delete_after);
+  if (replacement == NULL) return true;
+  size_t hash = completions_hash(replacement);
+  if (!completions_contains(cms,replacement,hash)) {
+    completions_push(cms, replacement, display, help, delete_before, delete_after, hash);
   }
   return true;
 }
 
+// move all completions (and their storage) from `src` to `dest`; `dest` should be cleared
+static void completions_move(completions_t* dest, completions_t* src) {
+  completion_t* elems = dest->elems;
+  ssize_t len = dest->len;
+  string_block_t* strings = dest->strings;
+  ssize_t* index = dest->index;
+  ssize_t index_len = dest->index_len;
+  dest->elems     = src->elems;
+  dest->len       = src->len;
+  dest->count     = src->count;
+  dest->strings   = src->strings;
+  dest->index     = src->index;
+  dest->index_len = src->index_len;
+  src->elems      = elems;
+  src->len        = len;
+  src->count      = 0;
+  src->strings    = strings;
+  src->index      = index;
+  src->index_len  = index_len;
+}
+
 static completion_t* completions_get(completions_t* cms, ssize_t index) {
   if (index < 0 || cms->count <= 0 || index >= cms->count) return NULL;
   return &cms->elems[index];
@@ -155,15 +286,15 @@ ic_private void completions_get_completer(completions_t* cms, ic_completer_fun_t
 
 
 ic_public void* ic_completion_arg( const ic_completion_env_t* cenv ) {
-  return (cenv == NULL ? NULL : cenv->env->completions->completer_arg);
+  return (cenv == NULL ? NULL : cenv->cms->completer_arg);
 }
 
 ic_public bool ic_has_completions( const ic_completion_env_t* cenv ) {
-  return (cenv == NULL ? false : cenv->env->completions->count > 0);
+  return (cenv == NULL ? false : cenv->cms->count > 0);
 }
 
 ic_public bool ic_stop_completing( const ic_completion_env_t* cenv) {
-  return (cenv == NULL ? true : cenv->env->completions->completer_max <= 0);
+  return (cenv == NULL ? true : cenv->cms->completer_max <= 0);
 }
 
 
@@ -189,16 +320,39 @@ ic_private ssize_t completions_apply( completions_t* cms, ssize_t index, stringb
 }
 
 
+// sort on compact (key,index) pairs and permute the completions once afterwards
+typedef struct completion_order_s {
+  const char* replacement;
+  ssize_t     index;
+} completion_order_t;
+
 static int completion_compare(const void* p1, const void* p2) {
   if (p1 == NULL || p2 == NULL) return 0;
-  const completion_t* cm1 = (const completion_t*)p1;
-  const completion_t* cm2 = (const completion_t*)p2;  
-  return ic_stricmp(cm1->replacement, cm2->replacement);
+  const completion_order_t* cm1 = (const completion_order_t*)p1;
+  const completion_order_t* cm2 = (const completion_order_t*)p2;  
+  int cmp = ic_stricmp(cm1->replacement, cm2->replacement);
+  if (cmp != 0) return cmp;
+  return (cm1->index < cm2->index ? -1 : (cm1->index > cm2->index ? 1 : 0));
 }
 
 ic_private void completions_sort(completions_t* cms) {
-  if (cms->count <= 0) return;
-  qsort(cms->elems, to_size_t(cms->count), sizeof(cms->elems[0]), &completion_compare);
+  if (cms->count <= 1) return;
+  completion_order_t* order = mem_malloc_tp_n(cms->mem, completion_order_t, cms->count);
+  if (order == NULL) return;
+  completion_t* sorted = mem_malloc_tp_n(cms->mem, completion_t, cms->len);
+  if (sorted == NULL) { mem_free(cms->mem, order); return; }
+  for (ssize_t i = 0; i < cms->count; i++) {
+    order[i].replacement = cms->elems[i].replacement;
+    order[i].index = i;
+  }
+  qsort(order, to_size_t(cms->count), sizeof(order[0]), &completion_compare);
+  for (ssize_t i = 0; i < cms->count; i++) {
+    sorted[i] = cms->elems[order[i].index];
+  }
+  mem_free(cms->mem, order);
+  mem_free(cms->mem, cms->elems);
+  cms->elems = sorted;
+  completions_index_rebuild(cms);
 }
 
 #define IC_MAX_PREFIX  (256)
@@ -283,8 +437,9 @@ ic_public bool ic_add_completion_prim(ic_completion_env_t* cenv, const char* rep
 }
 
 static bool prim_add_completion(ic_env_t* env, void* funenv, const char* replacement, const char* display, const char* help, long delete_before, long delete_after) {
-  ic_unused(funenv);
-  return completions_add(env->completions, replacement, display, help, delete_before, delete_after);
+  ic_unused(env);
+  completions_t* cms = (completions_t*)funenv;
+  return completions_add(cms, replacement, display, help, delete_before, delete_after);
 }
 
 ic_public void ic_set_default_completer(ic_completer_fun_t* completer, void* arg) {
@@ -292,26 +447,36 @@ ic_public void ic_set_default_completer(ic_completer_fun_t* completer, void* arg
   completions_set_completer(env->completions, completer, arg);
 }
 
-ic_private ssize_t completions_generate(struct ic_env_s* env, completions_t* cms, const char* input, ssize_t pos, ssize_t max) {
-  completions_clear(cms);
-  if (cms->completer == NULL || input == NULL || ic_strlen(input) < pos) return 0;
-
+static void completions_run(struct ic_env_s* env, completions_t* cms, ic_completer_fun_t* completer, void* arg,
+                             ic_completion_fun_t* complete, void* closure, const char* input, ssize_t pos) 
+{
   // set up env
   ic_completion_env_t cenv;
   cenv.env = env;
   cenv.input = input,
   cenv.cursor = (long)pos;
-  cenv.arg = cms->completer_arg;
-  cenv.complete = &prim_add_completion;
-  cenv.closure  = NULL;
+  cenv.arg = arg;
+  cenv.complete = complete;
+  cenv.closure  = closure;
+  cenv.cms = cms;
   const char* prefix = mem_strndup(cms->mem, input, pos);
-  cms->completer_max = max;
   
   // and complete
-  cms->completer(&cenv,prefix);
+  completer(&cenv,prefix);
 
   // restore
   mem_free(cms->mem,prefix);
+}
+
+static void completions_async_idle(completions_async_t* ca);
+
+ic_private ssize_t completions_generate(struct ic_env_s* env, completions_t* cms, const char* input, ssize_t pos, ssize_t max) {
+  // completers are never run concurrently: cancel and wait for the worker first
+  completions_async_idle(cms->async);
+  completions_clear(cms);
+  if (cms->completer == NULL || input == NULL || ic_strlen(input) < pos) return 0;
+  cms->completer_max = max;
+  completions_run(env, cms, cms->completer, cms->completer_arg, &prim_add_completion, cms, input, pos);
   return completions_count(cms);
 }
 
@@ -324,3 +489,278 @@ static void default_filename_completer( ic_completion_env_t* cenv, const char* p
   #endif
   ic_complete_filename( cenv, prefix, sep, ".", NULL);
 }
+
+
+//-------------------------------------------------------------
+// Asynchronous completion
+//
+// Completers can be slow (think of a directory on a network
+// drive), so the editor generates completions on a worker
+// thread while it keeps reading keys. Every request bumps a
+// generation counter; a worker that sees the generation change
+// stops adding completions and its results are discarded.
+// Only one completer ever runs at a time: synchronous
+// generation first waits until the worker is idle.
+//-------------------------------------------------------------
+
+#if defined(IC_ASYNC_COMPLETIONS)
+
+struct completions_async_s {
+  alloc_t*        mem;
+  completions_t*  cms;          // completions found by the worker
+  pthread_t       thread;
+  pid_t           owner;        // process that started the worker
+  pthread_mutex_t lock;
+  pthread_cond_t  cond;
+  bool            quit;         // worker should exit
+  bool            exited;       // worker has exited (and can be joined)
+  bool            busy;         // worker is running a completer
+  bool            pending;      // a request is waiting for the worker
+  long            generation;   // latest request (bumped on cancel too)
+  long            running;      // generation the worker is working on
+  long            done;         // last generation that finished
+  // the request
+  struct ic_env_s* env;
+  char*           input;
+  ssize_t         pos;
+  ssize_t         max;
+  ic_completer_fun_t* completer;
+  void*           completer_arg;
+};
+
+static bool async_add_completion(ic_env_t* env, void* funenv, const char* replacement, const char* display, const char* help, long delete_before, long delete_after) {
+  ic_unused(env);
+  completions_async_t* ca = (completions_async_t*)funenv;
+  pthread_mutex_lock(&ca->lock);
+  bool cont = (ca->running == ca->generation && !ca->quit);  // cancelled?
+  if (cont) {
+    cont = completions_add(ca->cms, replacement, display, help, delete_before, delete_after);
+  }
+  pthread_mutex_unlock(&ca->lock);
+  return cont;
+}
+
+static void* async_worker(void* arg) {
+  completions_async_t* ca = (completions_async_t*)arg;
+  pthread_mutex_lock(&ca->lock);
+  while (!ca->quit) {
+    if (!ca->pending) {
+      pthread_cond_wait(&ca->cond, &ca->lock);
+      continue;
+    }
+    // take the request
+    char* input = ca->input;
+    ca->input   = NULL;
+    ca->pending = false;
+    ca->busy    = true;
+    ca->running = ca->generation;
+    completions_clear(ca->cms);
+    ca->cms->completer_max = ca->max;
+    pthread_mutex_unlock(&ca->lock);
+
+    completions_run(ca->env, ca->cms, ca->completer, ca->completer_arg, &async_add_completion, ca, input, ca->pos);
+    mem_free(ca->mem, input);
+
+    pthread_mutex_lock(&ca->lock);
+    ca->busy = false;
+    if (ca->running == ca->generation) { ca->done = ca->running; }
+    pthread_cond_broadcast(&ca->cond);
+  }
+  ca->exited = true;
+  pthread_cond_broadcast(&ca->cond);
+  pthread_mutex_unlock(&ca->lock);
+  return NULL;
+}
+
+static completions_async_t* completions_async_new(alloc_t* mem) {
+  completions_async_t* ca = mem_zalloc_tp(mem, completions_async_t);
+  if (ca == NULL) return NULL;
+  ca->mem = mem;
+  ca->cms = completions_new(mem);
+  if (ca->cms == NULL) { mem_free(mem, ca); return NULL; }
+  ca->owner = getpid();
+  pthread_mutex_init(&ca->lock, NULL);
+  pthread_cond_init(&ca->cond, NULL);
+  // the worker inherits the signal mask; block everything so signals like
+  // SIGINT and SIGCHLD are always delivered to the shell's own thread.
+  sigset_t all, old;
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  const int err = pthread_create(&ca->thread, NULL, &async_worker, ca);
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+  if (err != 0) {
+    pthread_cond_destroy(&ca->cond);
+    pthread_mutex_destroy(&ca->lock);
+    completions_free(ca->cms);
+    mem_free(mem, ca);
+    return NULL;
+  }
+  return ca;
+}
+
+// set `until` to `timeout_ms` from now (on the clock used by `pthread_cond_timedwait`)
+static void async_deadline(struct timespec* until, long timeout_ms) {
+  clock_gettime(CLOCK_REALTIME, until);
+  until->tv_sec  += timeout_ms / 1000;
+  until->tv_nsec += (timeout_ms % 1000) * 1000000L;
+  if (until->tv_nsec >= 1000000000L) { until->tv_sec++; until->tv_nsec -= 1000000000L; }
+}
+
+static void completions_async_free(completions_async_t* ca) {
+  if (ca == NULL) return;
+  // a forked child (exiting through atexit) has no worker, and the lock
+  // may have been held by the worker at the fork; leave it all alone.
+  if (getpid() != ca->owner) return;
+  pthread_mutex_lock(&ca->lock);
+  ca->quit = true;
+  ca->generation++;
+  pthread_cond_broadcast(&ca->cond);
+  // a running completer stops at its next added completion; give it a
+  // moment to get there so it no longer uses the completion env.
+  struct timespec until;
+  async_deadline(&until, IC_ASYNC_QUIT_MS);
+  while (!ca->exited) {
+    if (pthread_cond_timedwait(&ca->cond, &ca->lock, &until) != 0) break;
+  }
+  bool exited = ca->exited;
+  pthread_mutex_unlock(&ca->lock);
+  if (!exited) {
+    // a completer stuck on a slow file system should not block our exit;
+    // the worker (and its state) is abandoned.
+    pthread_detach(ca->thread);
+    return;
+  }
+  pthread_join(ca->thread, NULL);
+  pthread_cond_destroy(&ca->cond);
+  pthread_mutex_destroy(&ca->lock);
+  mem_free(ca->mem, ca->input);
+  completions_free(ca->cms);
+  mem_free(ca->mem, ca);
+}
+
+static void completions_async_idle(completions_async_t* ca) {
+  if (ca == NULL) return;
+  pthread_mutex_lock(&ca->lock);
+  ca->generation++;
+  ca->pending = false;
+  while (ca->busy) {
+    pthread_cond_wait(&ca->cond, &ca->lock);
+  }
+  pthread_mutex_unlock(&ca->lock);
+}
+
+ic_private long completions_async_start(struct ic_env_s* env, completions_t* cms, const char* input, ssize_t pos, ssize_t max) {
+  if (cms->completer == NULL || input == NULL || ic_strlen(input) < pos) return 0;
+  if (cms->async == NULL) {
+    cms->async = completions_async_new(cms->mem);
+    if (cms->async == NULL) return 0;
+  }
+  completions_async_t* ca = cms->async;
+  char* copy = mem_strdup(ca->mem, input);
+  if (copy == NULL) return 0;
+  pthread_mutex_lock(&ca->lock);
+  ca->generation++;
+  mem_free(ca->mem, ca->input);  // replace a request that was not yet taken
+  ca->env           = env;
+  ca->input         = copy;
+  ca->pos           = pos;
+  ca->max           = max;
+  ca->completer     = cms->completer;
+  ca->completer_arg = cms->completer_arg;
+  ca->pending       = true;
+  long gen = ca->generation;
+  pthread_cond_signal(&ca->cond);
+  pthread_mutex_unlock(&ca->lock);
+  return gen;
+}
+
+ic_private void completions_async_cancel(completions_t* cms) {
+  completions_async_t* ca = cms->async;
+  if (ca == NULL) return;
+  pthread_mutex_lock(&ca->lock);
+  ca->generation++;
+  ca->pending = false;
+  pthread_mutex_unlock(&ca->lock);
+}
+
+ic_private int completions_async_poll(completions_t* cms, long generation, ssize_t* found, long timeout_ms) {
+  if (found != NULL) { *found = 0; }
+  completions_async_t* ca = cms->async;
+  if (ca == NULL || generation <= 0) return -1;
+  int result;
+  pthread_mutex_lock(&ca->lock);
+  if (timeout_ms > 0 && generation == ca->generation && ca->done != generation) {
+    // wait for the worker to finish (or the timeout)
+    struct timespec until;
+    async_deadline(&until, timeout_ms);
+    while (generation == ca->generation && ca->done != generation) {
+      if (pthread_cond_timedwait(&ca->cond, &ca->lock, &until) != 0) break;
+    }
+  }
+  if (generation != ca->generation) {
+    result = -1;  // stale
+  }
+  else if (ca->done == generation) {
+    // done: move the results over to `cms`
+    completions_clear(cms);
+    completions_move(cms, ca->cms);
+    ca->done = 0;
+    if (found != NULL) { *found = cms->count; }
+    result = 1;
+  }
+  else {
+    if (found != NULL && ca->running == generation) { *found = ca->cms->count; }
+    result = 0;
+  }
+  pthread_mutex_unlock(&ca->lock);
+  return result;
+}
+
+ic_private ssize_t completions_async_peek(completions_t* cms, long generation, ssize_t max) {
+  completions_async_t* ca = cms->async;
+  if (ca == NULL || generation <= 0) return -1;
+  ssize_t count = -1;
+  pthread_mutex_lock(&ca->lock);
+  if (generation == ca->generation && ca->running == generation && ca->done != generation) {
+    completions_clear(cms);
+    for (ssize_t i = 0; i < ca->cms->count && i < max; i++) {
+      const completion_t* cm = ca->cms->elems + i;
+      completions_push(cms, cm->replacement, cm->display, cm->help, cm->delete_before, cm->delete_after, cm->hash);
+    }
+    count = cms->count;
+  }
+  pthread_mutex_unlock(&ca->lock);
+  return count;
+}
+
+#else
+
+static void completions_async_free(completions_async_t* ca) {
+  ic_unused(ca);
+}
+
+static void completions_async_idle(completions_async_t* ca) {
+  ic_unused(ca);
+}
+
+ic_private long completions_async_start(struct ic_env_s* env, completions_t* cms, const char* input, ssize_t pos, ssize_t max) {
+  ic_unused(env); ic_unused(cms); ic_unused(input); ic_unused(pos); ic_unused(max);
+  return 0;
+}
+
+ic_private void completions_async_cancel(completions_t* cms) {
+  ic_unused(cms);
+}
+
+ic_private int completions_async_poll(completions_t* cms, long generation, ssize_t* found, long timeout_ms) {
+  ic_unused(cms); ic_unused(generation); ic_unused(timeout_ms);
+  if (found != NULL) { *found = 0; }
+  return -1;
+}
+
+ic_private ssize_t completions_async_peek(completions_t* cms, long generation, ssize_t max) {
+  ic_unused(cms); ic_unused(generation); ic_unused(max);
+  return -1;
+}
+
+#endif
@@ -35,6 +35,36 @@ ic_private void        completions_get_completer(completions_t* cms, ic_complete
 ic_private ssize_t     completions_apply(completions_t* cms, ssize_t index, stringbuf_t* sbuf, ssize_t pos);
 ic_private ssize_t     completions_apply_longest_prefix(completions_t* cms, stringbuf_t* sbuf, ssize_t pos);
 
+//-------------------------------------------------------------
+// Asynchronous completion on a worker thread
+//-------------------------------------------------------------
+#if !defined(_WIN32) && !defined(IC_NO_THREADS)
+#define IC_ASYNC_COMPLETIONS  1
+#endif
+
+#define IC_ASYNC_POLL_MS      (10)    // how often the editor checks the worker while reading keys
+#define IC_ASYNC_QUIT_MS      (500)   // how long to wait for a running completer to stop when freeing the worker
+
+typedef struct completions_async_s completions_async_t;
+
+// Start generating completions in the background; returns the request generation (or 0 if not supported).
+ic_private long        completions_async_start(struct ic_env_s* env, completions_t* cms, const char* input, ssize_t pos, ssize_t max);
+// Cancel any outstanding request.
+ic_private void        completions_async_cancel(completions_t* cms);
+// Returns 1 if the request is done (and the results are moved into `cms`), 0 if still running, and -1 if stale.
+// Waits at most `timeout_ms` for the worker; `found` is set to the number of completions found so far.
+ic_private int         completions_async_poll(completions_t* cms, long generation, ssize_t* found, long timeout_ms);
+// Copy the first `max` completions found so far by a running request into `cms` (to show them while it runs).
+// Returns the number copied, or -1 if the request is stale or already done.
+ic_private ssize_t     completions_async_peek(completions_t* cms, long generation, ssize_t max);
+
+//-------------------------------------------------------------
+// Cached directory listings for filename completion
+//-------------------------------------------------------------
+typedef struct dir_cache_s dir_cache_t;
+
+ic_private void        dircache_free(alloc_t* mem, dir_cache_t* dc);
+
 //-------------------------------------------------------------
 // Completion environment
 //-------------------------------------------------------------
@@ -47,6 +77,7 @@ struct ic_completion_env_s {
   void*       arg;       // argument given to `ic_set_completer`
   void*       closure;   // free variables for function composition
   ic_completion_fun_t* complete;  // function that adds a completion
+  completions_t* cms;    // the completions being generated
 };
 
 #endif // IC_COMPLETIONS_H
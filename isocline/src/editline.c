@@ -23,6 +23,37 @@
 
 
 
+// a row on the screen
+typedef enum row_prompt_e {
+  ROW_NO_PROMPT,    // row in the extra area (like a completion menu)
+  ROW_PROMPT,       // first row: starts with the prompt
+  ROW_CPROMPT       // continuation row: starts with the continuation prompt
+} row_prompt_t;
+
+typedef struct screen_row_s {
+  ssize_t       ofs;          // start of the row in the screen text
+  ssize_t       len;          // byte length of the row (excluding the prompt)
+  ssize_t       width;        // column width of the row (excluding the prompt)
+  row_prompt_t  prompt;       
+} screen_row_t;
+
+// the rows as rendered; the last drawn screen is kept to only redraw what changed.
+typedef struct screen_s {
+  stringbuf_t*  text;         // text of all rows
+  attrbuf_t*    attrs;        // attributes for the text
+  screen_row_t* rows;
+  ssize_t       count;        // number of rows
+  ssize_t       capacity;
+  bool          valid;        // is this an accurate copy of the screen?
+  ssize_t       first_row;    // first visible row (if the input is higher than the terminal)
+  ssize_t       lines;        // lines known to exist on the screen (relative to the first visible row)
+  ssize_t       cursor_row;   // cursor position after drawing (relative to the first visible row)
+  ssize_t       cursor_col;
+  ssize_t       termw;        // terminal width when drawn
+  const char*   prompt_text;  // prompt text when drawn
+  ssize_t       written;      // terminal output count after drawing (to detect other output)
+} screen_t;
+
 // editor state
 typedef struct editor_s {
   stringbuf_t*  input;        // current user input
@@ -39,10 +70,17 @@ typedef struct editor_s {
   editstate_t*  undo;         // undo buffer  
   editstate_t*  redo;         // redo buffer
   const char*   prompt_text;  // text of the prompt before the prompt marker    
+  long          hint_gen;     // generation of a pending background hint (0 if none)
+  bool          hint_is_suggestion; // is the hint a suggestion from the history?
+  bool          defer_refresh;   // more input is pending: postpone refreshing
+  bool          refresh_pending; // a refresh was postponed
+  bool          refresh_hint;    // .. and it should generate a hint
   alloc_t*      mem;          // allocator
   // caches
   attrbuf_t*    attrs;        // reuse attribute buffers 
   attrbuf_t*    attrs_extra; 
+  screen_t      frame;        // rows being rendered
+  screen_t      shadow;       // rows as last drawn
 } editor_t;
 
 
@@ -54,15 +92,21 @@ typedef struct editor_s {
 //-------------------------------------------------------------
 static char* edit_line( ic_env_t* env, const char* prompt_text, bool *ctrlC);  // defined at bottom
 static void edit_refresh(ic_env_t* env, editor_t* eb);
+static void edit_refresh_hint(ic_env_t* env, editor_t* eb);
 
 ic_private char* ic_editline(ic_env_t* env, const char* prompt_text, bool *ctrlC) {
   tty_start_raw(env->tty);
   term_start_raw(env->term);
+  // buffer all output; each frame is flushed just before we wait for input
+  buffer_mode_t bmode = term_set_buffer_mode(env->term, BUFFERED);
+  term_enable_bracketed_paste(env->term, true);
   char* line = edit_line(env,prompt_text, ctrlC);
-  term_end_raw(env->term,false);
-  tty_end_raw(env->tty);
+  term_enable_bracketed_paste(env->term, false);
   term_writeln(env->term,"");
   term_flush(env->term);
+  term_set_buffer_mode(env->term, bmode);
+  term_end_raw(env->term,false);
+  tty_end_raw(env->tty);
   return line;
 }
 
@@ -74,30 +118,32 @@ ic_private char* ic_editline(ic_env_t* env, const char* prompt_text, bool *ctrlC
 // capture the current edit state
 static void editor_capture(editor_t* eb, editstate_t** es ) {
   if (!eb->disable_undo) {
-    editstate_capture( eb->mem, es, sbuf_string(eb->input), eb->pos );
+    editstate_capture( eb->mem, es, eb->pos );
   }
 }
 
+// record every edit of the input in the current undo group
+static void editor_record_edit(void* arg, ssize_t pos, const char* removed, ssize_t removed_len, const char* inserted, ssize_t inserted_len) {
+  editor_t* eb = (editor_t*)arg;
+  editstate_record( eb->mem, &eb->undo, pos, removed, removed_len, inserted, inserted_len );
+}
+
 static void editor_undo_capture(editor_t* eb ) {
   editor_capture(eb, &eb->undo );
 }
 
 static void editor_undo_forget(editor_t* eb) {
   if (eb->disable_undo) return;
-  const char* input = NULL;
-  ssize_t pos = 0;
-  editstate_restore(eb->mem, &eb->undo, &input, &pos);
-  mem_free(eb->mem, input);
+  editstate_forget(&eb->undo);
 }
 
 static void editor_restore(editor_t* eb, editstate_t** from, editstate_t** to ) {
   if (eb->disable_undo) return;
   if (*from == NULL) return;
-  const char* input;
-  if (to != NULL) { editor_capture( eb, to ); }
-  if (!editstate_restore( eb->mem, from, &input, &eb->pos )) return;
-  sbuf_replace( eb->input, input );
-  mem_free(eb->mem, input);
+  sbuf_set_observer(eb->input, NULL, NULL);  // the restore records its edits in `to` itself
+  bool restored = editstate_restore( eb->mem, from, to, eb->input, &eb->pos );
+  sbuf_set_observer(eb->input, &editor_record_edit, eb);
+  if (!restored) return;
   eb->modified = false;
 }
 
@@ -189,9 +235,66 @@ static void edit_write_prompt( ic_env_t* env, editor_t* eb, ssize_t row, bool in
 // Refresh
 //-------------------------------------------------------------
 
+static bool screen_init(alloc_t* mem, screen_t* sc) {
+  memset(sc, 0, sizeof(*sc));
+  sc->text  = sbuf_new(mem);
+  sc->attrs = attrbuf_new(mem);
+  return (sc->text != NULL && sc->attrs != NULL);
+}
+
+static void screen_done(alloc_t* mem, screen_t* sc) {
+  sbuf_free(sc->text);
+  attrbuf_free(sc->attrs);
+  mem_free(mem, sc->rows);
+  memset(sc, 0, sizeof(*sc));
+}
+
+static void screen_clear(screen_t* sc) {
+  sbuf_clear(sc->text);
+  attrbuf_clear(sc->attrs);
+  sc->count = 0;
+  sc->valid = false;
+}
+
+static bool screen_push_row(alloc_t* mem, screen_t* sc, row_prompt_t prompt) {
+  if (sc->count >= sc->capacity) {
+    ssize_t newcap = (sc->capacity <= 0 ? 8 : 2*sc->capacity);
+    screen_row_t* newrows = mem_realloc_tp(mem, screen_row_t, sc->rows, newcap);
+    if (newrows == NULL) return false;
+    sc->rows = newrows;
+    sc->capacity = newcap;
+  }
+  screen_row_t* row = &sc->rows[sc->count++];
+  row->ofs    = sbuf_len(sc->text);
+  row->len    = 0;
+  row->width  = 0;
+  row->prompt = prompt;
+  return true;
+}
+
+// append to the last row; `attrs` can be NULL to use `attr` for all text
+static void screen_append(screen_t* sc, const char* s, const attr_t* attrs, ssize_t len, attr_t attr) {
+  if (sc->count <= 0 || len <= 0) return;
+  ssize_t i = 0;
+  while (i < len) {
+    ssize_t n = 1;
+    if (attrs == NULL) { n = len; }
+                  else { attr = attrs[i]; while (i+n < len && attr_is_eq(attr, attrs[i+n])) { n++; } }
+    attrbuf_append_n(sc->text, sc->attrs, s + i, n, attr);
+    i += n;
+  }
+  screen_row_t* row = &sc->rows[sc->count-1];
+  row->len   = sbuf_len(sc->text) - row->ofs;
+  row->width = str_column_width_n(sbuf_string(sc->text) + row->ofs, row->len);
+}
+
+static const attr_t* screen_attrs(screen_t* sc) {
+  return attrbuf_attrs(sc->attrs, sbuf_len(sc->text));
+}
+
 typedef struct refresh_info_s {
   ic_env_t*   env;
-  editor_t*   eb;
+  screen_t*   screen;
   attrbuf_t*  attrs;
   bool        in_extra;
   ssize_t     first_row;
@@ -205,37 +308,30 @@ static bool edit_refresh_rows_iter(
 {
   ic_unused(res); ic_unused(startw);
   const refresh_info_t* info = (const refresh_info_t*)(arg);
-  term_t* term = info->env->term;
+  ic_env_t* env = info->env;
 
   // debug_msg("edit: line refresh: row %zd, len: %zd\n", row, row_len);
   if (row < info->first_row) return false;
   if (row > info->last_row)  return true; // should not occur
   
-  // term_clear_line(term);
-  edit_write_prompt(info->env, info->eb, row, info->in_extra);
+  row_prompt_t prompt = (info->in_extra ? ROW_NO_PROMPT : (row == 0 ? ROW_PROMPT : ROW_CPROMPT));
+  if (!screen_push_row(env->mem, info->screen, prompt)) return true;
 
-  //' write output
-  if (info->attrs == NULL || (info->env->no_highlight && info->env->no_bracematch)) {
-    term_write_n( term, s + row_start, row_len );
-  }
-  else {
-    term_write_formatted_n( term, s + row_start, attrbuf_attrs(info->attrs, row_start + row_len) + row_start, row_len );
+  // the row contents
+  const attr_t* attrs = NULL;
+  if (info->attrs != NULL && !(env->no_highlight && env->no_bracematch)) {
+    attrs = attrbuf_attrs(info->attrs, row_start + row_len) + row_start;
   }
-
-  // write line ending
-  if (row < info->last_row) {
-    if (is_wrap && tty_is_utf8(info->env->tty)) {       
-      #ifndef __APPLE__
-      bbcode_print( info->env->bbcode, "[ic-dim]\xE2\x86\x90");  // left arrow 
-      #else
-      bbcode_print( info->env->bbcode, "[ic-dim]\xE2\x86\xB5" ); // return symbol
-      #endif
-    }
-    term_clear_to_end_of_line(term);
-    term_writeln(term, "");
-  }
-  else {
-    term_clear_to_end_of_line(term);
+  screen_append(info->screen, s + row_start, attrs, row_len, attr_none());
+
+  // and the wrap indicator
+  if (row < info->last_row && is_wrap && tty_is_utf8(env->tty)) {
+    #ifndef __APPLE__
+    const char* wrap = "\xE2\x86\x90";  // left arrow 
+    #else
+    const char* wrap = "\xE2\x86\xB5";  // return symbol
+    #endif
+    screen_append(info->screen, wrap, NULL, ic_strlen(wrap), bbcode_style(env->bbcode, "ic-dim"));
   }
   return (row >= info->last_row);  
 }
@@ -247,7 +343,7 @@ static void edit_refresh_rows(ic_env_t* env, editor_t* eb, stringbuf_t* input, a
   if (input == NULL) return;
   refresh_info_t info;
   info.env        = env;
-  info.eb         = eb;
+  info.screen     = &eb->frame;
   info.attrs      = attrs;
   info.in_extra   = in_extra;
   info.first_row  = first_row;
@@ -255,9 +351,148 @@ static void edit_refresh_rows(ic_env_t* env, editor_t* eb, stringbuf_t* input, a
   sbuf_for_each_row( input, eb->termw, promptw, cpromptw, &edit_refresh_rows_iter, &info, NULL);
 }
 
+static void edit_write_row(ic_env_t* env, editor_t* eb, screen_t* sc, ssize_t row, ssize_t start, ssize_t end, bool with_prompt) {
+  const screen_row_t* r = &sc->rows[row];
+  if (with_prompt) {
+    edit_write_prompt(env, eb, (r->prompt == ROW_PROMPT ? 0 : 1), r->prompt == ROW_NO_PROMPT);
+  }
+  if (end > start) {
+    term_write_formatted_n(env->term, sbuf_string(sc->text) + r->ofs + start, screen_attrs(sc) + r->ofs + start, end - start);
+  }
+}
+
+// draw all rows from the top
+static void edit_refresh_full(ic_env_t* env, editor_t* eb, ssize_t rows, ssize_t termh) {
+  screen_t* frame = &eb->frame;
+
+  // back up to the first line
+  term_start_of_line(env->term);
+  term_up(env->term, (eb->cur_row >= termh ? termh-1 : eb->cur_row) );
+  // term_clear_lines_to_end(env->term);  // gives flicker in old Windows cmd prompt 
+
+  // render rows
+  for (ssize_t row = 0; row < frame->count; row++) {
+    edit_write_row(env, eb, frame, row, 0, frame->rows[row].len, true);
+    term_clear_to_end_of_line(env->term);
+    if (row < frame->count - 1) term_writeln(env->term, "");
+  }
+    
+  // overwrite trailing rows we do not use anymore  
+  ssize_t rrows = frame->count;  // rendered rows
+  if (rrows < termh && rows < eb->cur_rows) {
+    ssize_t clear = eb->cur_rows - rows;
+    while (rrows < termh && clear > 0) {
+      clear--;
+      rrows++;
+      term_writeln(env->term,"");
+      term_clear_line(env->term);
+    }
+  }
+
+  // move cursor back to edit position
+  term_start_of_line(env->term);
+  term_up(env->term, rrows - 1 - frame->cursor_row );
+  term_right(env->term, frame->cursor_col);
+  frame->lines = rrows;
+}
+
+// move the cursor to a row, creating new lines at the bottom as needed
+static void edit_goto_row(term_t* term, screen_t* frame, ssize_t* cur, ssize_t row) {
+  if (row < *cur) {
+    term_up(term, *cur - row);
+  }
+  else if (row > *cur) {
+    ssize_t last = (row < frame->lines ? row : frame->lines - 1);
+    term_down(term, last - *cur);
+    for (ssize_t i = last; i < row; i++) {
+      term_writeln(term, "");
+    }
+    if (row >= frame->lines) frame->lines = row + 1;
+  }
+  term_start_of_line(term);
+  *cur = row;
+}
+
+// only draw the changes with respect to the previously drawn screen
+static void edit_refresh_diff(ic_env_t* env, editor_t* eb, ssize_t promptw, ssize_t cpromptw) {
+  term_t* term = env->term;
+  screen_t* frame  = &eb->frame;
+  screen_t* shadow = &eb->shadow;
+  const char*   ntext  = sbuf_string(frame->text);
+  const attr_t* nattrs = screen_attrs(frame);
+  const char*   otext  = sbuf_string(shadow->text);
+  const attr_t* oattrs = screen_attrs(shadow);
+  frame->lines = shadow->lines;
+  ssize_t cur = shadow->cursor_row;
+  
+  const ssize_t count = (frame->count > shadow->count ? frame->count : shadow->count);
+  for (ssize_t row = 0; row < count; row++) {
+    if (row >= frame->count) {
+      // clear rows we do not use anymore
+      edit_goto_row(term, frame, &cur, row);
+      term_clear_to_end_of_line(term);
+      continue;
+    }
+    const screen_row_t* nrow = &frame->rows[row];
+    const screen_row_t* orow = (row < shadow->count ? &shadow->rows[row] : NULL);
+    if (orow == NULL || orow->prompt != nrow->prompt) {
+      // redraw the row completely
+      edit_goto_row(term, frame, &cur, row);
+      edit_write_row(env, eb, frame, row, 0, nrow->len, true);
+      term_clear_to_end_of_line(term);
+      continue;
+    }
+
+    // find the changed span between the common prefix and suffix
+    const char*   n  = ntext  + nrow->ofs;
+    const attr_t* na = nattrs + nrow->ofs;
+    const char*   o  = otext  + orow->ofs;
+    const attr_t* oa = oattrs + orow->ofs;
+    const ssize_t minlen = (nrow->len < orow->len ? nrow->len : orow->len);
+    ssize_t pre = 0;
+    while (pre < minlen && n[pre] == o[pre] && attr_is_eq(na[pre], oa[pre])) { pre++; }
+    if (pre == nrow->len && pre == orow->len) continue;  // unchanged
+    while (pre > 0 && ((pre < nrow->len && utf8_is_cont((uint8_t)n[pre])) || (pre < orow->len && utf8_is_cont((uint8_t)o[pre])))) { pre--; }
+    ssize_t post = 0;
+    while (post < minlen - pre && n[nrow->len - post - 1] == o[orow->len - post - 1] && 
+           attr_is_eq(na[nrow->len - post - 1], oa[orow->len - post - 1])) { post++; }
+    while (post > 0 && utf8_is_cont((uint8_t)n[nrow->len - post])) { post--; }
+
+    // if the changed span keeps its width, the suffix stays in place
+    ssize_t end = nrow->len;
+    bool clear  = (orow->width > nrow->width);
+    if (str_column_width_n(n + pre, nrow->len - post - pre) == str_column_width_n(o + pre, orow->len - post - pre)) {
+      end   = nrow->len - post;
+      clear = false;
+    }
+    edit_goto_row(term, frame, &cur, row);
+    const ssize_t pw = (nrow->prompt == ROW_PROMPT ? promptw : (nrow->prompt == ROW_CPROMPT ? cpromptw : 0));
+    term_right(term, pw + str_column_width_n(n, pre));
+    edit_write_row(env, eb, frame, row, pre, end, false);
+    if (clear) term_clear_to_end_of_line(term);
+  }
+
+  // move cursor back to edit position
+  edit_goto_row(term, frame, &cur, frame->cursor_row);
+  term_right(term, frame->cursor_col);
+}
+
+// postpone a refresh while typeahead is applied; only the last one is done
+static bool edit_refresh_postpone(ic_env_t* env, editor_t* eb, bool hint) {
+  if (!eb->defer_refresh) {
+    eb->refresh_pending = false;
+    return false;
+  }
+  if (eb->refresh_pending) env->refresh_skipped++;
+  eb->refresh_pending = true;
+  eb->refresh_hint = hint;
+  return true;
+}
 
 static void edit_refresh(ic_env_t* env, editor_t* eb) 
 {
+  if (edit_refresh_postpone(env, eb, false)) return;
+
   // calculate the new cursor row and total rows needed
   ssize_t promptw, cpromptw;
   edit_get_prompt_width( env, eb, false, &promptw, &cpromptw );
@@ -314,16 +549,10 @@ static void edit_refresh(ic_env_t* env, editor_t* eb)
     last_row = first_row + termh - 1;
   }
   assert(last_row - first_row < termh);
-  
-  // reduce flicker
-  buffer_mode_t bmode = term_set_buffer_mode(env->term, BUFFERED);        
-
-  // back up to the first line
-  term_start_of_line(env->term);
-  term_up(env->term, (eb->cur_row >= termh ? termh-1 : eb->cur_row) );
-  // term_clear_lines_to_end(env->term);  // gives flicker in old Windows cmd prompt 
 
-  // render rows
+  // render the rows into the new frame
+  screen_t* frame = &eb->frame;
+  screen_clear(frame);
   edit_refresh_rows( env, eb, eb->input, eb->attrs, promptw, cpromptw, false, first_row, last_row );  
   if (rows_extra > 0) {
     assert(extra != NULL);
@@ -331,28 +560,38 @@ static void edit_refresh(ic_env_t* env, editor_t* eb)
     const ssize_t last_rowx = last_row - rows_input; assert(last_rowx >= 0);
     edit_refresh_rows(env, eb, extra, eb->attrs_extra, 0, 0, true, first_rowx, last_rowx);
   }
-    
-  // overwrite trailing rows we do not use anymore  
-  ssize_t rrows = last_row - first_row + 1;  // rendered rows
-  if (rrows < termh && rows < eb->cur_rows) {
-    ssize_t clear = eb->cur_rows - rows;
-    while (rrows < termh && clear > 0) {
-      clear--;
-      rrows++;
-      term_writeln(env->term,"");
-      term_clear_line(env->term);
-    }
-  }
+  frame->first_row  = first_row;
+  frame->termw      = eb->termw;
+  frame->prompt_text = eb->prompt_text;
+  frame->cursor_row = rc.row - first_row;
+  frame->cursor_col = rc.col + (rc.row == 0 ? promptw : cpromptw);
   
-  // move cursor back to edit position
-  term_start_of_line(env->term);
-  term_up(env->term, first_row + rrows - 1 - rc.row );
-  term_right(env->term, rc.col + (rc.row == 0 ? promptw : cpromptw));
+  // reduce flicker
+  buffer_mode_t bmode = term_set_buffer_mode(env->term, BUFFERED);        
 
-  // and refresh
-  term_flush(env->term);
+  // draw only the changes if the screen still shows the previous frame
+  const ssize_t written = term_get_written(env->term);
+  const screen_t* shadow = &eb->shadow;
+  const bool incremental = (shadow->valid && shadow->written == written && 
+                            shadow->termw == frame->termw && shadow->first_row == frame->first_row &&
+                            shadow->prompt_text == frame->prompt_text &&
+                            frame->count == (last_row - first_row + 1));
+  if (incremental) {
+    edit_refresh_diff(env, eb, promptw, cpromptw);
+  }
+  else {
+    edit_refresh_full(env, eb, rows, termh);
+  }
+  frame->written = term_get_written(env->term);
+  frame->valid   = true;
+  debug_msg("edit: refresh: %zd bytes (%s)\n", frame->written - written, (incremental ? "incremental" : "full"));
 
-  // stop buffering
+  // the new frame is now on the screen
+  screen_t tmp = eb->shadow;
+  eb->shadow = eb->frame;
+  eb->frame  = tmp;
+
+  // stop buffering (the frame is flushed by the caller before waiting for input)
   term_set_buffer_mode(env->term, bmode);
 
   // restore input by removing the hint
@@ -383,6 +622,20 @@ static void edit_clear(ic_env_t* env, editor_t* eb ) {
 }
 
 
+// call the input event handler with the input cleared, and redraw the input below its output
+static void edit_input_event(ic_env_t* env, editor_t* eb) {
+  if (env->input_event_fun == NULL) return;
+  edit_clear(env, eb);
+  term_start_of_line(env->term);
+  term_up(env->term, eb->cur_row);
+  term_flush(env->term);
+  env->input_event_fun(env->input_event_arg);
+  eb->cur_rows = 1;
+  eb->cur_row = 0;
+  eb->shadow.valid = false;
+  edit_refresh_hint(env, eb);
+}
+
 // clear screen and refresh
 static void edit_clear_screen(ic_env_t* env, editor_t* eb ) {
   ssize_t cur_rows = eb->cur_rows;
@@ -449,16 +702,8 @@ static void editor_append_hint_help(editor_t* eb, const char* help) {
   }
 }
 
-// refresh with possible hint
-static void edit_refresh_hint(ic_env_t* env, editor_t* eb) {
-  if (env->no_hint || env->hint_delay > 0) {
-    // refresh without hint first
-    edit_refresh(env, eb);
-    if (env->no_hint) return;
-  }
-    
-  // and see if we can construct a hint (displayed after a delay)
-  ssize_t count = completions_generate(env, env->completions, sbuf_string(eb->input), eb->pos, 2);
+// construct a hint from the generated completions
+static void edit_hint_from_completions(ic_env_t* env, editor_t* eb, ssize_t count) {
   if (count == 1) {
     const char* help = NULL;
     const char* hint = completions_get_hint(env->completions, 0, &help);
@@ -492,6 +737,44 @@ static void edit_refresh_hint(ic_env_t* env, editor_t* eb) {
       }      
     }
   }
+}
+
+// construct a hint from the most recent history entry that extends the input
+static bool edit_hint_from_history(ic_env_t* env, editor_t* eb) {
+  if (env->no_autosuggest || eb->pos <= 0 || eb->pos != sbuf_len(eb->input)) return false;
+  const char* entry = history_suggest(env->history, sbuf_string(eb->input), true);
+  if (entry == NULL) return false;
+  sbuf_replace(eb->hint, entry + eb->pos);
+  sbuf_clear(eb->hint_help);
+  eb->hint_is_suggestion = true;
+  return true;
+}
+
+// refresh with possible hint
+static void edit_refresh_hint(ic_env_t* env, editor_t* eb) {
+  if (edit_refresh_postpone(env, eb, true)) return;
+  eb->hint_gen = 0;
+  eb->hint_is_suggestion = false;
+  if (edit_hint_from_history(env, eb)) {
+    // suggestions are cheap and shown right away
+    edit_refresh(env, eb);
+    return;
+  }
+  if (env->no_hint || env->hint_delay > 0) {
+    // refresh without hint first
+    edit_refresh(env, eb);
+    if (env->no_hint) return;
+  }
+
+  // and see if we can construct a hint (displayed after a delay);
+  // preferably in the background so slow completers never delay input.
+  eb->hint_gen = completions_async_start(env, env->completions, sbuf_string(eb->input), eb->pos, 2);
+  if (eb->hint_gen > 0) {
+    if (env->hint_delay <= 0) edit_refresh(env, eb);
+    return;  // picked up by `edit_await_hint`
+  }
+  ssize_t count = completions_generate(env, env->completions, sbuf_string(eb->input), eb->pos, 2);
+  edit_hint_from_completions(env, eb, count);
 
   if (env->hint_delay <= 0) {
     // refresh with hint directly
@@ -499,6 +782,35 @@ static void edit_refresh_hint(ic_env_t* env, editor_t* eb) {
   }
 }
 
+// Wait for a pending background hint while reading keys.
+// Returns `true` if a key was read first (and the hint is abandoned).
+// `waited` is set to the time spent waiting (in ms).
+static bool edit_await_hint(ic_env_t* env, editor_t* eb, code_t* c, long* waited) {
+  *waited = 0;
+  while (eb->hint_gen > 0) {
+    ssize_t count = 0;
+    int res = completions_async_poll(env->completions, eb->hint_gen, &count, 0);
+    if (res != 0) {
+      eb->hint_gen = 0;
+      if (res > 0) {
+        edit_hint_from_completions(env, eb, count);
+        if (env->hint_delay <= 0 && sbuf_len(eb->hint) > 0) {
+          edit_refresh(env, eb);
+          term_flush(env->term);
+        }
+      }
+      break;
+    }
+    if (tty_read_timeout(env->tty, IC_ASYNC_POLL_MS, c)) {
+      completions_async_cancel(env->completions);
+      eb->hint_gen = 0;
+      return true;
+    }
+    *waited += IC_ASYNC_POLL_MS;
+  }
+  return false;
+}
+
 //-------------------------------------------------------------
 // Edit operations
 //-------------------------------------------------------------
@@ -763,6 +1075,13 @@ static void edit_multiline_eol(ic_env_t* env, editor_t* eb) {
   edit_refresh(env,eb);
 }
 
+static void edit_insert_suggestion(ic_env_t* env, editor_t* eb, const char* suggestion) {
+  editor_start_modify(eb);
+  ssize_t nextpos = sbuf_insert_at(eb->input, suggestion, eb->pos);
+  if (nextpos >= 0) eb->pos = nextpos;
+  edit_refresh_hint(env, eb);
+}
+
 static void edit_insert_unicode(ic_env_t* env, editor_t* eb, unicode_t u) {
   editor_start_modify(eb);
   ssize_t nextpos = sbuf_insert_unicode_at(eb->input, u, eb->pos);
@@ -820,6 +1139,50 @@ static void edit_insert_char(ic_env_t* env, editor_t* eb, char c) {
   edit_refresh_hint(env,eb);  
 }
 
+// insert pasted text at once: a single undo group, no hint or completion work, and one refresh
+static void edit_insert_paste(ic_env_t* env, editor_t* eb) {
+  stringbuf_t* paste = tty_paste_buf(env->tty);
+  stringbuf_t* text = sbuf_new(eb->mem);
+  if (paste == NULL || text == NULL) { sbuf_free(text); return; }
+  const uint8_t* s = (const uint8_t*)sbuf_string(paste);
+  const ssize_t len = sbuf_len(paste);
+  const bool is_utf8 = tty_is_utf8(env->tty);
+  for (ssize_t i = 0; i < len; ) {
+    uint8_t c = s[i];
+    if (c == '\r' || c == '\n') {
+      if (c == '\r' && i + 1 < len && s[i+1] == '\n') i++;   // CRLF
+      sbuf_append_char(text, (env->singleline_only ? ' ' : '\n'));
+      i++;
+    }
+    else if (c == '\t') {
+      sbuf_append_char(text, ' ');
+      i++;
+    }
+    else if (c < ' ' || c == 0x7F) {
+      i++;  // ignore other control characters
+    }
+    else if (c < 0x80) {
+      sbuf_append_char(text, (char)c);
+      i++;
+    }
+    else {
+      // normalize to our internal encoding (as `tty_read` does for each key)
+      ssize_t nread = 1;
+      unicode_t u = (is_utf8 ? unicode_from_qutf8(s + i, len - i, &nread) : unicode_from_raw(c));
+      uint8_t buf[5];
+      unicode_to_qutf8(u, buf);
+      sbuf_append(text, (const char*)buf);
+      i += (nread > 0 ? nread : 1);
+    }
+  }
+  if (sbuf_len(text) > 0) {
+    editor_start_modify(eb);
+    eb->pos = sbuf_insert_at_n(eb->input, sbuf_string(text), sbuf_len(text), eb->pos);
+    edit_refresh(env, eb);
+  }
+  sbuf_free(text);
+}
+
 //-------------------------------------------------------------
 // Help
 //-------------------------------------------------------------
@@ -843,6 +1206,33 @@ static void edit_insert_char(ic_env_t* env, editor_t* eb, char c) {
 // Edit line: main edit loop
 //-------------------------------------------------------------
 
+// can the refresh after this key be postponed while more input is pending?
+// (keys that may show a menu or read input themselves always refresh)
+static bool edit_key_can_defer(code_t c) {
+  if (c >= ' ' && code_is_unicode(c, NULL)) return true;  // inserts a character
+  switch(c) {
+    case KEY_EVENT_PASTE:
+    case KEY_LINEFEED:
+    case KEY_SHIFT_TAB:
+    case KEY_LEFT: case KEY_CTRL_B:
+    case KEY_UP: case KEY_DOWN:
+    case KEY_HOME: case KEY_CTRL_A:
+    case KEY_END: case KEY_CTRL_E:
+    case KEY_CTRL_LEFT: case WITH_SHIFT(KEY_LEFT): case WITH_ALT('b'):
+    case KEY_CTRL_HOME: case WITH_SHIFT(KEY_HOME): case KEY_PAGEUP: case WITH_ALT('<'):
+    case KEY_CTRL_END: case WITH_SHIFT(KEY_END): case KEY_PAGEDOWN: case WITH_ALT('>'):
+    case WITH_ALT('m'):
+    case KEY_BACKSP: case KEY_DEL:
+    case WITH_ALT('d'): case KEY_CTRL_W:
+    case WITH_ALT(KEY_DEL): case WITH_ALT(KEY_BACKSP):
+    case KEY_CTRL_U: case KEY_CTRL_K: case KEY_CTRL_T:
+    case KEY_CTRL_Z: case WITH_CTRL('_'): case KEY_CTRL_Y:
+      return true;
+    default:
+      return false;
+  }
+}
+
 static char* edit_line( ic_env_t* env, const char* prompt_text, bool *ctrlC)
 {
   // set up an edit buffer
@@ -862,7 +1252,10 @@ static char* edit_line( ic_env_t* env, const char* prompt_text, bool *ctrlC)
   eb.history_idx   = 0;  
   editstate_init(&eb.undo);
   editstate_init(&eb.redo);
-  if (eb.input==NULL || eb.extra==NULL || eb.hint==NULL || eb.hint_help==NULL) {
+  if (eb.input != NULL) { sbuf_set_observer(eb.input, &editor_record_edit, &eb); }
+  bool screens_ok = screen_init(env->mem, &eb.frame);
+  screens_ok = screen_init(env->mem, &eb.shadow) && screens_ok;
+  if (eb.input==NULL || eb.extra==NULL || eb.hint==NULL || eb.hint_help==NULL || !screens_ok) {
     return NULL;
   }
 
@@ -881,19 +1274,30 @@ static char* edit_line( ic_env_t* env, const char* prompt_text, bool *ctrlC)
   // process keys
   code_t c;          // current key code
   while(true) {    
+    // do a postponed refresh once all typeahead is applied
+    if (eb.refresh_pending && !tty_has_input(env->tty)) {
+      if (eb.refresh_hint) edit_refresh_hint(env, &eb);
+                      else edit_refresh(env, &eb);
+    }
+
     // read a character
     term_flush(env->term);
-    if (env->hint_delay <= 0 || sbuf_len(eb.hint) == 0) {
+    long waited = 0;
+    if (edit_await_hint(env, &eb, &c, &waited)) {
+      // got input before the hint was generated
+    }
+    else if (env->hint_delay <= 0 || sbuf_len(eb.hint) == 0 || eb.hint_is_suggestion) {
       // blocking read
       c = tty_read(env->tty);
     }
     else {
       // timeout to display hint
-      if (!tty_read_timeout(env->tty, env->hint_delay, &c)) {
+      if (waited >= env->hint_delay || !tty_read_timeout(env->tty, env->hint_delay - waited, &c)) {
         // timed-out
         if (sbuf_len(eb.hint) > 0) {
           // display hint
           edit_refresh(env, &eb);
+          term_flush(env->term);
         }
         c = tty_read(env->tty);
       }
@@ -911,15 +1315,29 @@ static char* edit_line( ic_env_t* env, const char* prompt_text, bool *ctrlC)
 
     // clear hint only after a potential resize (so resize row calculations are correct)
     const bool had_hint = (sbuf_len(eb.hint) > 0);
+    char* suggestion = NULL;
+    if (had_hint && eb.hint_is_suggestion && (c == KEY_RIGHT || c == KEY_CTRL_F || c == KEY_END)) {
+      suggestion = sbuf_strdup(eb.hint);
+    }
     sbuf_clear(eb.hint);
     sbuf_clear(eb.hint_help);
+    eb.hint_is_suggestion = false;
 
     // if the user tries to move into a hint with left-cursor or end, we complete it first
-    if ((c == KEY_RIGHT || c == KEY_END) && had_hint) {
+    // (or accept the suggestion from the history)
+    if (suggestion != NULL) {
+      edit_insert_suggestion(env, &eb, suggestion);
+      mem_free(env->mem, suggestion);
+      c = KEY_NONE;
+    }
+    else if ((c == KEY_RIGHT || c == KEY_END) && had_hint) {
       edit_generate_completions(env, &eb, true);
       c = KEY_NONE;      
     }
 
+    // with typeahead, apply the key without refreshing (done once the input is drained)
+    eb.defer_refresh = (!env->no_typeahead && edit_key_can_defer(c) && tty_has_input(env->tty));
+
     // Operations that may return
     if (c == KEY_ENTER) {
       if (!env->singleline_only && eb.pos > 0 && 
@@ -963,6 +1381,12 @@ static char* edit_line( ic_env_t* env, const char* prompt_text, bool *ctrlC)
       case KEY_EVENT_AUTOTAB:
         edit_generate_completions(env, &eb, true);
         break;
+      case KEY_EVENT_PASTE:
+        edit_insert_paste(env, &eb);
+        break;
+      case KEY_EVENT_FD:
+        edit_input_event(env, &eb);
+        break;
 
       // completion, history, help, undo
       case KEY_TAB:
@@ -1101,7 +1525,7 @@ static char* edit_line( ic_env_t* env, const char* prompt_text, bool *ctrlC)
         break;
       }
     }
-
+    eb.defer_refresh = false;
   }
 
   // goto end
@@ -1142,6 +1566,8 @@ static char* edit_line( ic_env_t* env, const char* prompt_text, bool *ctrlC)
   sbuf_free(eb.extra);
   sbuf_free(eb.hint);
   sbuf_free(eb.hint_help);
+  screen_done(eb.mem, &eb.frame);
+  screen_done(eb.mem, &eb.shadow);
 
   return res;
 }
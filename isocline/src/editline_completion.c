@@ -105,6 +105,66 @@ static ssize_t edit_completions_max_width( ic_env_t* env, ssize_t count ) {
   return max_width;
 }
 
+#define IC_ASYNC_PROGRESS_DELAY  (100)  // ms before showing progress (and reading keys) on a slow completion
+#define IC_ASYNC_PREVIEW_MAX     (9)    // completions shown while a slow completer is still running
+
+// Generate completions in the background; a slow completer shows the first
+// completions found so far with their number, and is cancelled by a key press (so typeahead
+// right after a tab still completes first). Returns the completion count,
+// or -1 if a key was pressed first (the key is pushed back for the main loop).
+static ssize_t edit_completions_generate(ic_env_t* env, editor_t* eb, ssize_t max) {
+  long gen = completions_async_start(env, env->completions, sbuf_string(eb->input), eb->pos, max);
+  if (gen <= 0) {
+    return completions_generate(env, env->completions, sbuf_string(eb->input), eb->pos, max);
+  }
+  ssize_t count  = -1;
+  ssize_t found  = 0;
+  ssize_t shown  = -1;
+  long    waited = 0;
+  int     res;
+  while (true) {
+    // wait quietly at first; only slow completions show progress and can be interrupted
+    bool quiet = (waited < IC_ASYNC_PROGRESS_DELAY);
+    res = completions_async_poll(env->completions, gen, &found, (quiet ? IC_ASYNC_POLL_MS : 0));
+    if (res != 0) break;
+    if (quiet) {
+      waited += IC_ASYNC_POLL_MS;
+      continue;
+    }
+    if (found != shown) {
+      shown = found;
+      sbuf_clear(eb->extra);
+      ssize_t preview = completions_async_peek(env->completions, gen, IC_ASYNC_PREVIEW_MAX);
+      for (ssize_t i = 0; i < preview; i++) {
+        editor_append_completion(env, eb, i, -1, false, false);
+        sbuf_append(eb->extra, "\n");
+      }
+      sbuf_appendf(eb->extra, "[ic-info](completing... %zd found)[/]", found);
+      edit_refresh(env, eb);
+      term_flush(env->term);
+    }
+    code_t c;
+    if (tty_read_timeout(env->tty, IC_ASYNC_POLL_MS, &c)) {
+      completions_async_cancel(env->completions);
+      completions_clear(env->completions);
+      tty_code_pushback(env->tty, c);
+      break;
+    }
+    waited += IC_ASYNC_POLL_MS;
+  }
+  if (res > 0) {
+    count = found;
+  }
+  else if (res < 0) {
+    completions_clear(env->completions);  // drop the preview of a stale request
+  }
+  if (shown >= 0) {
+    sbuf_clear(eb->extra);
+    edit_refresh(env, eb);
+  }
+  return count;
+}
+
 static void edit_completion_menu(ic_env_t* env, editor_t* eb, bool more_available) {
   ssize_t count = completions_count(env->completions);
   ssize_t count_displayed = count;
@@ -161,6 +221,7 @@ again:
   }
 
   // read here; if not a valid key, push it back and return to main event loop
+  term_flush(env->term);
   code_t c = tty_read(env->tty);
   if (tty_term_resize_event(env->tty)) {
     edit_resize(env, eb);
@@ -221,7 +282,11 @@ again:
     c = 0;
     if (more_available) {
       // generate all entries (up to the max (= 1000))
-      count = completions_generate(env, env->completions, sbuf_string(eb->input), eb->pos, IC_MAX_COMPLETIONS_TO_SHOW);
+      count = edit_completions_generate(env, eb, IC_MAX_COMPLETIONS_TO_SHOW);
+      if (count < 0) {  // interrupted by a key press
+        edit_refresh(env, eb);
+        return;
+      }
     }
     rowcol_t rc;
     edit_get_rowcol(env,eb,&rc);
@@ -257,7 +322,8 @@ again:
 static void edit_generate_completions(ic_env_t* env, editor_t* eb, bool autotab) {
   debug_msg( "edit: complete: %zd: %s\n", eb->pos, sbuf_string(eb->input) );
   if (eb->pos < 0) return;
-  ssize_t count = completions_generate(env, env->completions, sbuf_string(eb->input), eb->pos, IC_MAX_COMPLETIONS_TO_TRY);
+  ssize_t count = edit_completions_generate(env, eb, IC_MAX_COMPLETIONS_TO_TRY);
+  if (count < 0) return;  // interrupted by a key press
   bool more_available = (count >= IC_MAX_COMPLETIONS_TO_TRY);
   if (count <= 0) {
     // no completions
@@ -156,6 +156,7 @@ again:
   edit_refresh(env, eb);
 
   // Wait for input
+  term_flush(env->term);
   code_t c = (hentry == NULL ? KEY_ESC : tty_read(env->tty));
   if (tty_term_resize_event(env->tty)) {
     edit_resize(env, eb);
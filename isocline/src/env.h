@@ -27,12 +27,15 @@ struct ic_env_s {
   term_t*         term;             // terminal
   tty_t*          tty;              // keyboard (NULL if stdin is a pipe, file, etc)
   completions_t*  completions;      // current completions
+  dir_cache_t*    dircache;         // cached directory listings for filename completion (can be NULL)
   history_t*      history;          // edit history
   bbcode_t*       bbcode;           // print with bbcodes
   const char*     prompt_marker;    // the prompt marker (defaults to "> ")
   const char*     cprompt_marker;   // prompt marker for continuation lines (defaults to `prompt_marker`)
   ic_highlight_fun_t* highlighter;  // highlight callback
   void*           highlighter_arg;  // user state for the highlighter.
+  ic_input_event_fun_t* input_event_fun; // called when the input event file descriptor is readable
+  void*           input_event_arg;  // user state for the input event callback
   const char*     match_braces;     // matching braces, e.g "()[]{}"
   const char*     auto_braces;      // auto insertion braces, e.g "()[]{}\"\"''"
   char            multiline_eol;    // character used for multiline input ("\") (set to 0 to disable)
@@ -44,11 +47,14 @@ struct ic_env_s {
   bool            no_multiline_indent; // indent continuation lines to line up under the initial prompt 
   bool            no_help;          // show short help line for history search etc.
   bool            no_hint;          // allow hinting?
+  bool            no_autosuggest;   // suggest the most recent history entry that extends the input?
   bool            no_highlight;     // enable highlighting?
   bool            no_bracematch;    // enable brace matching?
   bool            no_autobrace;     // enable automatic brace insertion?
   bool            no_lscolors;      // use LSCOLORS/LS_COLORS to colorize file name completions?
+  bool            no_typeahead;     // refresh after every key even if more input is pending?
   long            hint_delay;       // delay before displaying a hint in milliseconds
+  long            refresh_skipped;  // refreshes skipped because more input was pending
 };
 
 ic_private char*        ic_editline(ic_env_t* env, const char* prompt_text, bool *ctrlC);
@@ -15,10 +15,29 @@
 
 #define IC_MAX_HISTORY (200)
 
+// an item together with its push stamp (higher is more recent)
+typedef struct history_stamped_s {
+  const char* item;
+  size_t      stamp;
+} history_stamped_t;
+
+// prefix index: a trie over the bytes of the items
+typedef struct history_node_s {
+  struct history_node_s* child;   // first child
+  struct history_node_s* next;    // next sibling
+  history_stamped_t  best[2];     // the two most recent items that are longer than the prefix of this node (item NULL if none)
+  history_stamped_t* ends;        // the items that are equal to the prefix of this node (more than one with duplicates)
+  ssize_t  ends_count;
+  ssize_t  ends_len;
+  char     c;                     // last byte of the prefix of this node
+} history_node_t;
+
 struct history_s {
   ssize_t  count;              // current number of entries in use
   ssize_t  len;                // size of elems 
   const char** elems;         // history items (up to count)
+  history_node_t* root;        // prefix index (created on demand)
+  size_t   stamp;              // last push stamp
   const char*  fname;         // history file
   alloc_t* mem;
   bool     allow_duplicates;   // allow duplicate entries?
@@ -38,6 +57,11 @@ ic_private void history_free(history_t* h) {
     h->elems = NULL;
     h->len = 0;
   }
+  if (h->root != NULL) {  // an empty index is just the root
+    mem_free(h->mem, h->root->ends);
+    mem_free(h->mem, h->root);
+    h->root = NULL;
+  }
   mem_free(h->mem, h->fname);
   h->fname = NULL;
   mem_free(h->mem, h); // free ourselves
@@ -53,6 +77,125 @@ ic_private ssize_t  history_count(const history_t* h) {
   return h->count;
 }
 
+//-------------------------------------------------------------
+// prefix index
+//-------------------------------------------------------------
+
+// Each node keeps the two most recent items that extend its prefix, so a
+// lookup walks the prefix once and needs no string comparisons: O(|prefix|).
+// A push only updates the nodes on the path of the new item: O(|item|).
+// A removal updates the nodes on its path from the bottom up, rescanning the
+// children of a node only if the removed item was one of its two best.
+
+static history_node_t* history_node_child( const history_node_t* node, char c ) {
+  history_node_t* child = node->child;
+  while (child != NULL && child->c != c) { child = child->next; }
+  return child;
+}
+
+// add `x` to the two best of `node` if it is more recent
+static void history_node_consider( history_node_t* node, history_stamped_t x ) {
+  if (x.item == NULL) return;
+  if (node->best[0].item == NULL || x.stamp > node->best[0].stamp) {
+    node->best[1] = node->best[0];
+    node->best[0] = x;
+  }
+  else if (node->best[1].item == NULL || x.stamp > node->best[1].stamp) {
+    node->best[1] = x;
+  }
+}
+
+// recompute the two best of `node` from its children
+static void history_node_update( history_node_t* node ) {
+  memset(node->best, 0, sizeof(node->best));
+  for (const history_node_t* child = node->child; child != NULL; child = child->next) {
+    history_node_consider(node, child->best[0]);
+    history_node_consider(node, child->best[1]);
+    for (ssize_t i = 0; i < child->ends_count; i++) {
+      history_node_consider(node, child->ends[i]);
+    }
+  }
+}
+
+static void history_index_insert( history_t* h, const char* entry ) {
+  if (h->root == NULL) {
+    h->root = mem_zalloc_tp(h->mem, history_node_t);
+    if (h->root == NULL) return;
+  }
+  history_stamped_t x = { entry, ++h->stamp };
+  history_node_t* node = h->root;
+  for (const char* p = entry; *p != 0; p++) {
+    // the new item is the most recent of every prefix it extends
+    node->best[1] = node->best[0];
+    node->best[0] = x;
+    history_node_t* child = history_node_child(node, *p);
+    if (child == NULL) {
+      child = mem_zalloc_tp(h->mem, history_node_t);
+      if (child == NULL) return;
+      child->c     = *p;
+      child->next  = node->child;
+      node->child  = child;
+    }
+    node = child;
+  }
+  if (node->ends_count >= node->ends_len) {
+    ssize_t newlen = (node->ends_len <= 0 ? 1 : 2*node->ends_len);
+    history_stamped_t* newends = mem_realloc_tp(h->mem, history_stamped_t, node->ends, newlen);
+    if (newends == NULL) return;
+    node->ends = newends;
+    node->ends_len = newlen;
+  }
+  node->ends[node->ends_count++] = x;
+}
+
+static void history_index_remove( history_t* h, const char* entry ) {
+  if (h->root == NULL) return;
+  ssize_t n = ic_strlen(entry);
+  history_node_t** path = mem_malloc_tp_n(h->mem, history_node_t*, n + 1);
+  if (path == NULL) return;
+  path[0] = h->root;
+  for (ssize_t i = 0; i < n; i++) {
+    path[i+1] = history_node_child(path[i], entry[i]);
+    if (path[i+1] == NULL) { mem_free(h->mem, path); return; }  // not indexed
+  }
+  history_node_t* last = path[n];
+  for (ssize_t i = 0; i < last->ends_count; i++) {
+    if (last->ends[i].item == entry) {
+      last->ends[i] = last->ends[--last->ends_count];
+      break;
+    }
+  }
+  for (ssize_t i = n - 1; i >= 0; i--) {
+    history_node_t* node  = path[i];
+    history_node_t* child = path[i+1];
+    if (child->ends_count == 0 && child->child == NULL) {
+      // unlink the empty child
+      history_node_t** link = &node->child;
+      while (*link != child) { link = &(*link)->next; }
+      *link = child->next;
+      mem_free(h->mem, child->ends);
+      mem_free(h->mem, child);
+    }
+    if (node->best[0].item == entry || node->best[1].item == entry) {
+      history_node_update(node);
+    }
+  }
+  mem_free(h->mem, path);
+}
+
+// Return the most recent entry that extends `prefix`, or NULL if there is none.
+// With `skip_current` the newest entry (the input being edited) is ignored.
+ic_private const char* history_suggest( history_t* h, const char* prefix, bool skip_current ) {
+  if (h->count <= 0 || h->root == NULL || prefix == NULL || prefix[0] == 0) return NULL;
+  const history_node_t* node = h->root;
+  for (const char* p = prefix; *p != 0 && node != NULL; p++) {
+    node = history_node_child(node, *p);
+  }
+  if (node == NULL) return NULL;
+  const char* current = (skip_current ? h->elems[h->count - 1] : NULL);
+  return (node->best[0].item != current ? node->best[0].item : node->best[1].item);
+}
+
 //-------------------------------------------------------------
 // push/clear
 //-------------------------------------------------------------
@@ -67,6 +210,7 @@ ic_private bool history_update( history_t* h, const char* entry ) {
 
 static void history_delete_at( history_t* h, ssize_t idx ) {
   if (idx < 0 || idx >= h->count) return;
+  history_index_remove(h, h->elems[idx]);
   mem_free(h->mem, h->elems[idx]);
   for(ssize_t i = idx+1; i < h->count; i++) {
     h->elems[i-1] = h->elems[i];
@@ -90,7 +234,10 @@ ic_private bool history_push( history_t* h, const char* entry ) {
     history_delete_at(h,0);    
   }
   assert(h->count < h->len);
-  h->elems[h->count] = mem_strdup(h->mem,entry);
+  const char* item = mem_strdup(h->mem,entry);
+  if (item == NULL) return false;
+  history_index_insert(h, item);
+  h->elems[h->count] = item;
   h->count++;
   return true;
 }
@@ -99,10 +246,13 @@ ic_private bool history_push( history_t* h, const char* entry ) {
 static void history_remove_last_n( history_t* h, ssize_t n ) {
   if (n <= 0) return;
   if (n > h->count) n = h->count;
-  for( ssize_t i = h->count - n; i < h->count; i++) {
-    mem_free( h->mem, h->elems[i] );
+  while (n > 0) {
+    const char* item = h->elems[h->count - 1];
+    history_index_remove(h, item);
+    mem_free( h->mem, item );
+    h->count--;
+    n--;
   }
-  h->count -= n;
   assert(h->count >= 0);    
 }
 
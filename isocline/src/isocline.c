@@ -160,6 +160,15 @@ ic_public bool ic_async_stop(void) {
   return tty_async_stop(env->tty);
 }
 
+ic_public void ic_set_input_event(int fd, ic_input_event_fun_t* fun, void* arg) {
+  ic_env_t* env = ic_get_env(); if (env==NULL) return;
+  env->input_event_fun = fun;
+  env->input_event_arg = arg;
+  if (env->tty != NULL) {
+    tty_set_event_fd(env->tty, (fun == NULL ? -1 : fd));
+  }
+}
+
 static void set_prompt_marker(ic_env_t* env, const char* prompt_marker, const char* cprompt_marker) {
   if (prompt_marker == NULL) prompt_marker = "> ";
   if (cprompt_marker == NULL) cprompt_marker = prompt_marker;
@@ -254,6 +263,25 @@ ic_public bool ic_enable_hint(bool enable) {
   return !prev;
 }
 
+ic_public bool ic_enable_autosuggest(bool enable) {
+  ic_env_t* env = ic_get_env(); if (env==NULL) return false;
+  bool prev = env->no_autosuggest;
+  env->no_autosuggest = !enable;
+  return !prev;
+}
+
+ic_public bool ic_enable_typeahead(bool enable) {
+  ic_env_t* env = ic_get_env(); if (env==NULL) return false;
+  bool prev = env->no_typeahead;
+  env->no_typeahead = !enable;
+  return !prev;
+}
+
+ic_public long ic_get_refresh_skipped(void) {
+  ic_env_t* env = ic_get_env(); if (env==NULL) return 0;
+  return env->refresh_skipped;
+}
+
 ic_public long ic_set_hint_delay(long delay_ms) {
   ic_env_t* env = ic_get_env(); if (env==NULL) return false;
   long prev = env->hint_delay;
@@ -415,6 +443,18 @@ ic_public void ic_term_style( const char* style ) {
   term_set_attr( env->term, bbcode_style(env->bbcode, style));
 }
 
+ic_public long ic_term_get_bytes_written(void) {
+  ic_env_t* env = ic_get_env(); 
+  if (env==NULL || env->term==NULL) return 0;
+  return (long)term_get_written(env->term);
+}
+
+ic_public long ic_term_get_write_calls(void) {
+  ic_env_t* env = ic_get_env(); 
+  if (env==NULL || env->term==NULL) return 0;
+  return (long)term_get_write_calls(env->term);
+}
+
 ic_public int ic_term_get_color_bits(void) {
   ic_env_t* env = ic_get_env(); 
   if (env==NULL || env->term==NULL) return 4;  
@@ -493,6 +533,7 @@ static void ic_env_free(ic_env_t* env) {
   history_save(env->history);
   history_free(env->history);
   completions_free(env->completions);
+  dircache_free(env->mem, env->dircache);
   bbcode_free(env->bbcode);
   term_free(env->term);
   tty_free(env->tty);
@@ -18,7 +18,7 @@
 #else
 */
 // use our own (also on APPLE as that fails within vscode)
-#define  wcwidth(c)  mk_wcwidth(c)
+#define  wcwidth(c)  mk_wcwidth_cached(c)
 #include "wcwidth.c"
 // #endif
 
@@ -31,13 +31,36 @@
 
 //-------------------------------------------------------------
 // In place growable utf-8 strings
+//
+// The unused space of `buf` is kept as a gap at the last edit position
+// so consecutive edits at the cursor do not move the rest of the text.
+// The text after the gap is stored at the end of `buf` and the gap is
+// only closed when a contiguous string is needed.
 //-------------------------------------------------------------
 
+// a cached terminal row
+typedef struct sbuf_row_s {
+  ssize_t   start;
+  ssize_t   len;
+  ssize_t   startw;
+  bool      is_wrap;
+} sbuf_row_t;
+
 struct stringbuf_s {
   char*     buf;
   ssize_t   buflen;
   ssize_t   count;  
+  ssize_t   gap;              // start of the gap of `buflen - count` bytes (equal to `count` if the text is contiguous)
   alloc_t*  mem;
+  sbuf_observer_fun_t* observer;
+  void*     observer_arg;
+  sbuf_row_t* rows;           // row index for the widths below (only the first `rows_valid` rows are up to date)
+  ssize_t   rows_valid;
+  ssize_t   rows_capacity;
+  bool      rows_complete;    // are all rows valid?
+  ssize_t   rows_termw;
+  ssize_t   rows_promptw;
+  ssize_t   rows_cpromptw;
 };
 
 
@@ -95,13 +118,39 @@ static ssize_t char_column_width( const char* s, ssize_t n ) {
   }
 }
 
-static ssize_t str_column_width_n( const char* s, ssize_t len ) {
+// Length of the run of printable ascii characters (0x20 to 0x7E) at the start of `s`;
+// each of those is exactly one column wide. Checks a word at a time.
+static ssize_t str_ascii_run( const char* s, ssize_t len ) {
+  const uint64_t ones  = UINT64_C(0x0101010101010101);
+  const uint64_t highs = UINT64_C(0x8080808080808080);
+  ssize_t n = 0;
+  while (n + 8 <= len) {
+    uint64_t x;
+    memcpy(&x, s + n, 8);
+    // any byte < 0x20 or >= 0x7F? (adding one sets the high bit of 0x7F)
+    if ((((x - 0x20*ones) & ~x) | x | (x + ones)) & highs) break;
+    n += 8;
+  }
+  while (n < len && (uint8_t)s[n] >= ' ' && (uint8_t)s[n] < 0x7F) {
+    n++;
+  }
+  return n;
+}
+
+ic_private ssize_t str_column_width_n( const char* s, ssize_t len ) {
   if (s == NULL || len <= 0) return 0;
   ssize_t pos = 0;
   ssize_t cwidth = 0;
   ssize_t cw;
   ssize_t ofs;
-  while (s[pos] != 0 && (ofs = str_next_ofs(s, len, pos, &cw)) > 0) {
+  while (pos < len && s[pos] != 0) {
+    ssize_t run = str_ascii_run(s + pos, len - pos);
+    if (run > 0) {
+      cwidth += run;
+      pos += run;
+      continue;
+    }
+    if ((ofs = str_next_ofs(s, len, pos, &cw)) <= 0) break;
     cwidth += cw;
     pos += ofs;
   }  
@@ -203,6 +252,12 @@ ic_private bool skip_esc( const char* s, ssize_t len, ssize_t* esclen ) {
 ic_private ssize_t str_next_ofs( const char* s, ssize_t len, ssize_t pos, ssize_t* cwidth ) {
   ssize_t ofs = 0;
   if (s != NULL && len > pos) {
+    uint8_t b = (uint8_t)s[pos];
+    if (b >= ' ' && b < 0x7F) {
+      // printable ascii
+      if (cwidth != NULL) *cwidth = 1;
+      return 1;
+    }
     if (skip_esc(s+pos,len-pos,&ofs)) {
       // skip escape sequence      
     }
@@ -327,17 +382,30 @@ static ssize_t str_find_ws_word_end( const char* s, ssize_t len, ssize_t pos) {
 // String row/column iteration
 //-------------------------------------------------------------
 
-// invoke a function for each terminal row; returns total row count.
-static ssize_t str_for_each_row( const char* s, ssize_t len, ssize_t termw, ssize_t promptw, ssize_t cpromptw,
-                                 row_fun_t* fun, const void* arg, void* res ) 
+// invoke a function for each terminal row starting at row `row` at position `start`
+// (which must be the start of that row); returns total row count.
+static ssize_t str_for_each_row_from( const char* s, ssize_t len, ssize_t termw, ssize_t promptw, ssize_t cpromptw,
+                                      ssize_t start, ssize_t row, row_fun_t* fun, const void* arg, void* res ) 
 {
   if (s == NULL) s = "";
   ssize_t i;
-  ssize_t rcount = 0;
+  ssize_t rcount = row;
   ssize_t rcol = 0;
-  ssize_t rstart = 0;  
-  ssize_t startw  = promptw; 
-  for(i = 0; i < len; ) {
+  ssize_t rstart = start;  
+  ssize_t startw  = (rcount == 0 ? promptw : cpromptw); 
+  for(i = start; i < len; ) {
+    startw = (rcount == 0 ? promptw : cpromptw);
+    // take a run of plain ascii in one step as long as it fits on the current row
+    ssize_t run = str_ascii_run(s + i, len - i);
+    if (run > 0) {
+      ssize_t fit = termw - startw - 2 - rcol;
+      if (termw != 0 && fit < run) run = fit;
+      if (run > 0) {
+        i += run;
+        rcol += run;
+        continue;
+      }
+    }
     ssize_t w;
     ssize_t next = str_next_ofs(s, len, i, &w);    
     if (next <= 0) {
@@ -345,7 +413,6 @@ static ssize_t str_for_each_row( const char* s, ssize_t len, ssize_t termw, ssiz
       assert(false);
       break;
     }
-    startw = (rcount == 0 ? promptw : cpromptw);
     ssize_t termcol = rcol + w + startw + 1 /* for the cursor */;
     if (termw != 0 && i != 0 && termcol >= termw) {  
       // wrap
@@ -375,6 +442,13 @@ static ssize_t str_for_each_row( const char* s, ssize_t len, ssize_t termw, ssiz
   return rcount+1;
 }
 
+// invoke a function for each terminal row; returns total row count.
+static ssize_t str_for_each_row( const char* s, ssize_t len, ssize_t termw, ssize_t promptw, ssize_t cpromptw,
+                                 row_fun_t* fun, const void* arg, void* res ) 
+{
+  return str_for_each_row_from(s, len, termw, promptw, cpromptw, 0, 0, fun, arg, res);
+}
+
 //-------------------------------------------------------------
 // String: get row/column position
 //-------------------------------------------------------------
@@ -545,9 +619,32 @@ static ssize_t str_get_pos_at_rc(const char* s, ssize_t len, ssize_t termw, ssiz
 //-------------------------------------------------------------
 // String buffer
 //-------------------------------------------------------------
+
+// move the gap to `pos`
+static void sbuf_move_gap(stringbuf_t* s, ssize_t pos) {
+  assert(pos >= 0 && pos <= s->count);
+  const ssize_t gaplen = s->buflen - s->count;
+  if (pos < s->gap) {
+    ic_memmove(s->buf + pos + gaplen, s->buf + pos, s->gap - pos);
+  }
+  else if (pos > s->gap) {
+    ic_memmove(s->buf + s->gap, s->buf + s->gap + gaplen, pos - s->gap);
+  }
+  s->gap = pos;
+}
+
+// close the gap and return the text as a zero terminated string
+static const char* sbuf_text(stringbuf_t* s) {
+  if (s->buf == NULL) return "";
+  if (s->gap != s->count) { sbuf_move_gap(s, s->count); }
+  s->buf[s->count] = 0;
+  return s->buf;
+}
+
 static bool sbuf_ensure_extra(stringbuf_t* s, ssize_t extra) 
 {
   if (s->buflen >= s->count + extra) return true;   
+  if (s->buf != NULL) { sbuf_text(s); }  // reallocate with the gap at the end
   // reallocate; pick good initial size and multiples to increase reuse on allocation
   ssize_t newlen = (s->buflen <= 0 ? 120 : (s->buflen > 1000 ? s->buflen + 1000 : 2*s->buflen));
   if (newlen < s->count + extra) newlen = s->count + extra;
@@ -561,23 +658,112 @@ static bool sbuf_ensure_extra(stringbuf_t* s, ssize_t extra)
   }
   s->buf = newbuf;
   s->buflen = newlen;
+  s->gap = s->count;
   s->buf[s->count] = s->buf[s->buflen] = 0;
   assert(s->buflen >= s->count + extra);
   return true;
 }
 
+
+//-------------------------------------------------------------
+// Row index: the rows for the last used terminal and prompt widths
+// are cached; an edit only invalidates the rows from the edit position
+// onward, and these are recomputed on the next use.
+//-------------------------------------------------------------
+
+// the last valid row that starts at or before `pos` (or 0)
+static ssize_t sbuf_rows_find(const stringbuf_t* sbuf, ssize_t pos) {
+  ssize_t lo = 0;
+  ssize_t hi = sbuf->rows_valid;
+  while (lo < hi) {
+    ssize_t mid = lo + (hi - lo)/2;
+    if (sbuf->rows[mid].start <= pos) { lo = mid + 1; }
+                                 else { hi = mid; }
+  }
+  return (lo > 0 ? lo - 1 : 0);
+}
+
+static void sbuf_rows_invalidate(stringbuf_t* sbuf, ssize_t pos) {
+  sbuf->rows_complete = false;
+  if (sbuf->rows_valid <= 0) return;
+  // an edit can also change where the previous row wraps
+  ssize_t row = sbuf_rows_find(sbuf, pos) - 1;
+  if (row < 0) row = 0;
+  if (row < sbuf->rows_valid) sbuf->rows_valid = row;
+}
+
+static bool sbuf_rows_push_iter(
+    const char* s,
+    ssize_t row, ssize_t row_start, ssize_t row_len, 
+    ssize_t startw, bool is_wrap, const void* arg, void* res)
+{
+  ic_unused(s); ic_unused(arg);
+  stringbuf_t* sbuf = (stringbuf_t*)res;
+  if (row >= sbuf->rows_capacity) {
+    ssize_t newcap = (sbuf->rows_capacity <= 0 ? 16 : 2*sbuf->rows_capacity);
+    sbuf_row_t* newrows = mem_realloc_tp(sbuf->mem, sbuf_row_t, sbuf->rows, newcap);
+    if (newrows == NULL) { sbuf->rows_valid = 0; return true; }
+    sbuf->rows = newrows;
+    sbuf->rows_capacity = newcap;
+  }
+  sbuf_row_t* r = &sbuf->rows[row];
+  r->start   = row_start;
+  r->len     = row_len;
+  r->startw  = startw;
+  r->is_wrap = is_wrap;
+  sbuf->rows_valid = row + 1;
+  return false;
+}
+
+// bring the row index up to date; returns `false` if it could not be allocated
+static bool sbuf_rows_ensure(stringbuf_t* sbuf, ssize_t termw, ssize_t promptw, ssize_t cpromptw) {
+  if (sbuf->rows_termw != termw || sbuf->rows_promptw != promptw || sbuf->rows_cpromptw != cpromptw) {
+    sbuf->rows_termw    = termw;
+    sbuf->rows_promptw  = promptw;
+    sbuf->rows_cpromptw = cpromptw;
+    sbuf->rows_valid    = 0;
+    sbuf->rows_complete = false;
+  }
+  if (sbuf->rows_complete) return true;
+  // continue after the last valid row
+  ssize_t row   = sbuf->rows_valid;
+  ssize_t start = 0;
+  if (row > 0) {
+    const sbuf_row_t* last = &sbuf->rows[row-1];
+    start = last->start + last->len + (last->is_wrap ? 0 : 1);
+  }
+  const char* s = sbuf_text(sbuf);
+  str_for_each_row_from(s, sbuf->count, termw, promptw, cpromptw, start, row, &sbuf_rows_push_iter, NULL, sbuf);
+  sbuf->rows_complete = (sbuf->rows_valid > 0);  // there is always at least one row
+  return sbuf->rows_complete;
+}
+
 static void sbuf_init( stringbuf_t* sbuf, alloc_t* mem ) {
   sbuf->mem = mem;
   sbuf->buf = NULL;
   sbuf->buflen = 0;
   sbuf->count = 0;
+  sbuf->gap = 0;
+  sbuf->observer = NULL;
+  sbuf->observer_arg = NULL;
+  sbuf->rows = NULL;
+  sbuf->rows_valid = 0;
+  sbuf->rows_capacity = 0;
+  sbuf->rows_complete = false;
+  sbuf->rows_termw = sbuf->rows_promptw = sbuf->rows_cpromptw = -1;
 }
 
 static void sbuf_done( stringbuf_t* sbuf ) {
   mem_free( sbuf->mem, sbuf->buf );
+  mem_free( sbuf->mem, sbuf->rows );
   sbuf->buf = NULL;
   sbuf->buflen = 0;
   sbuf->count = 0;
+  sbuf->gap = 0;
+  sbuf->rows = NULL;
+  sbuf->rows_valid = 0;
+  sbuf->rows_capacity = 0;
+  sbuf->rows_complete = false;
 }
 
 
@@ -599,21 +785,26 @@ ic_private char* sbuf_free_dup(stringbuf_t* sbuf) {
   if (sbuf == NULL) return NULL;
   char* s = NULL;
   if (sbuf->buf != NULL) {
+    sbuf_text(sbuf);
     s = mem_realloc_tp(sbuf->mem, char, sbuf->buf, sbuf_len(sbuf)+1);
     if (s == NULL) { s = sbuf->buf; }
     sbuf->buf = 0;
     sbuf->buflen = 0;
     sbuf->count = 0;
+    sbuf->gap = 0;
   }
   sbuf_free(sbuf);
   return s;
 }
 
+ic_private void sbuf_set_observer(stringbuf_t* sbuf, sbuf_observer_fun_t* observer, void* arg) {
+  sbuf->observer = observer;
+  sbuf->observer_arg = arg;
+}
+
 ic_private const char* sbuf_string_at( stringbuf_t* sbuf, ssize_t pos ) {
   if (pos < 0 || sbuf->count < pos) return NULL;
-  if (sbuf->buf == NULL) return "";
-  assert(sbuf->buf[sbuf->count] == 0);
-  return sbuf->buf + pos;
+  return sbuf_text(sbuf) + pos;
 }
 
 ic_private const char* sbuf_string( stringbuf_t* sbuf ) {
@@ -621,8 +812,8 @@ ic_private const char* sbuf_string( stringbuf_t* sbuf ) {
 }
 
 ic_private char sbuf_char_at(stringbuf_t* sbuf, ssize_t pos) {
-  if (sbuf->buf == NULL || pos < 0 || sbuf->count < pos) return 0;
-  return sbuf->buf[pos];
+  if (sbuf->buf == NULL || pos < 0 || sbuf->count <= pos) return 0;
+  return sbuf->buf[pos < sbuf->gap ? pos : pos + (sbuf->buflen - sbuf->count)];
 }
 
 ic_private char* sbuf_strdup_at( stringbuf_t* sbuf, ssize_t pos ) {
@@ -641,6 +832,7 @@ ic_private ssize_t sbuf_len(const stringbuf_t* s) {
 ic_private ssize_t sbuf_append_vprintf(stringbuf_t* sb, const char* fmt, va_list args) {
   const ssize_t min_needed = ic_strlen(fmt);
   if (!sbuf_ensure_extra(sb,min_needed + 16)) return sb->count;
+  sbuf_text(sb);  // append after the text
   ssize_t avail = sb->buflen - sb->count;
   va_list args0;
   va_copy(args0, args);
@@ -652,9 +844,15 @@ ic_private ssize_t sbuf_append_vprintf(stringbuf_t* sb, const char* fmt, va_list
     needed = vsnprintf(sb->buf + sb->count, to_size_t(avail), fmt, args);
   }
   assert(needed <= avail);
+  const ssize_t start = sb->count;
   sb->count += (needed > avail ? avail : (needed >= 0 ? needed : 0));
   assert(sb->count <= sb->buflen);
+  sb->gap = sb->count;
   sb->buf[sb->count] = 0;
+  sbuf_rows_invalidate(sb, start);
+  if (sb->observer != NULL && sb->count > start) {
+    sb->observer(sb->observer_arg, start, NULL, 0, sb->buf + start, sb->count - start);
+  }
   return sb->count;
 }
 
@@ -671,10 +869,14 @@ ic_private ssize_t sbuf_insert_at_n(stringbuf_t* sbuf, const char* s, ssize_t n,
   if (pos < 0 || pos > sbuf->count || s == NULL) return pos;
   n = str_limit_to_length(s,n);
   if (n <= 0 || !sbuf_ensure_extra(sbuf,n)) return pos;
-  ic_memmove(sbuf->buf + pos + n, sbuf->buf + pos, sbuf->count - pos);
+  sbuf_move_gap(sbuf, pos);
   ic_memcpy(sbuf->buf + pos, s, n);
+  sbuf->gap += n;
   sbuf->count += n;
-  sbuf->buf[sbuf->count] = 0;
+  sbuf_rows_invalidate(sbuf, pos);
+  if (sbuf->observer != NULL) {
+    sbuf->observer(sbuf->observer_arg, pos, NULL, 0, sbuf->buf + pos, n);
+  }
   return (pos + n);
 }
 
@@ -682,8 +884,14 @@ ic_private stringbuf_t* sbuf_split_at( stringbuf_t* sb, ssize_t pos ) {
   stringbuf_t* res = sbuf_new(sb->mem);
   if (res==NULL || pos < 0) return NULL;
   if (pos < sb->count) {
-    sbuf_append_n(res, sb->buf + pos, sb->count - pos);
+    const char* text = sbuf_text(sb);
+    sbuf_append_n(res, text + pos, sb->count - pos);
+    if (sb->observer != NULL) {
+      sb->observer(sb->observer_arg, pos, text + pos, sb->count - pos, NULL, 0);
+    }
     sb->count = pos;
+    sb->gap = pos;
+    sbuf_rows_invalidate(sb, pos);
   }
   return res;
 }
@@ -710,9 +918,14 @@ ic_private ssize_t sbuf_insert_unicode_at(stringbuf_t* sbuf, unicode_t u, ssize_
 ic_private void sbuf_delete_at( stringbuf_t* sbuf, ssize_t pos, ssize_t count ) {
   if (pos < 0 || pos >= sbuf->count) return;
   if (pos + count > sbuf->count) count = sbuf->count - pos;
-  ic_memmove(sbuf->buf + pos, sbuf->buf + pos + count, sbuf->count - pos - count);
+  if (count <= 0) return;
+  sbuf_move_gap(sbuf, pos + count);  // the deleted text is now just before the gap
+  if (sbuf->observer != NULL) {
+    sbuf->observer(sbuf->observer_arg, pos, sbuf->buf + pos, count, NULL, 0);
+  }
+  sbuf->gap = pos;
   sbuf->count -= count;
-  sbuf->buf[sbuf->count] = 0;
+  sbuf_rows_invalidate(sbuf, pos);
 }
 
 ic_private void sbuf_delete_from_to( stringbuf_t* sbuf, ssize_t pos, ssize_t end ) {
@@ -750,10 +963,12 @@ ic_private void sbuf_replace(stringbuf_t* sbuf, const char* s) {
 }
 
 ic_private ssize_t sbuf_next_ofs( stringbuf_t* sbuf, ssize_t pos, ssize_t* cwidth ) {
-  return str_next_ofs( sbuf->buf, sbuf->count, pos, cwidth);
+  return str_next_ofs( sbuf_text(sbuf), sbuf->count, pos, cwidth);
 }
 
 ic_private ssize_t sbuf_prev_ofs( stringbuf_t* sbuf, ssize_t pos, ssize_t* cwidth ) {
+  // only the text before `pos` is needed, which is contiguous if it is before the gap
+  if (pos > sbuf->gap) { sbuf_text(sbuf); }
   return str_prev_ofs( sbuf->buf, pos, cwidth);
 }
 
@@ -792,55 +1007,86 @@ ic_private ssize_t sbuf_swap_char( stringbuf_t* sbuf, ssize_t pos ) {
   if (next <= 0) return 0;  
   ssize_t prev = sbuf_prev_ofs(sbuf, pos, NULL);
   if (prev <= 0) return 0;  
-  char buf[64];
-  if (prev >= 63) return 0;
-  ic_memcpy(buf, sbuf->buf + pos - prev, prev );
+  char buf[128];
+  if (prev >= 63 || next >= 63) return 0;
+  sbuf_text(sbuf);
+  ic_memcpy(buf, sbuf->buf + pos - prev, prev + next );  // also keep the original for the observer
   ic_memmove(sbuf->buf + pos - prev, sbuf->buf + pos, next);
   ic_memmove(sbuf->buf + pos - prev + next, buf, prev);
+  if (sbuf->observer != NULL) {
+    sbuf->observer(sbuf->observer_arg, pos - prev, buf, prev + next, sbuf->buf + pos - prev, prev + next);
+  }
+  sbuf_rows_invalidate(sbuf, pos - prev);
   return pos - prev;
 }
 
 ic_private ssize_t sbuf_find_line_start( stringbuf_t* sbuf, ssize_t pos ) {
-  return str_find_line_start( sbuf->buf, sbuf->count, pos);
+  return str_find_line_start( sbuf_text(sbuf), sbuf->count, pos);
 }
 
 ic_private ssize_t sbuf_find_line_end( stringbuf_t* sbuf, ssize_t pos ) {
-  return str_find_line_end( sbuf->buf, sbuf->count, pos);
+  return str_find_line_end( sbuf_text(sbuf), sbuf->count, pos);
 }
 
 ic_private ssize_t sbuf_find_word_start( stringbuf_t* sbuf, ssize_t pos ) {
-  return str_find_word_start( sbuf->buf, sbuf->count, pos);
+  return str_find_word_start( sbuf_text(sbuf), sbuf->count, pos);
 }
 
 ic_private ssize_t sbuf_find_word_end( stringbuf_t* sbuf, ssize_t pos ) {
-  return str_find_word_end( sbuf->buf, sbuf->count, pos);
+  return str_find_word_end( sbuf_text(sbuf), sbuf->count, pos);
 }
 
 ic_private ssize_t sbuf_find_ws_word_start( stringbuf_t* sbuf, ssize_t pos ) {
-  return str_find_ws_word_start( sbuf->buf, sbuf->count, pos);
+  return str_find_ws_word_start( sbuf_text(sbuf), sbuf->count, pos);
 }
 
 ic_private ssize_t sbuf_find_ws_word_end( stringbuf_t* sbuf, ssize_t pos ) {
-  return str_find_ws_word_end( sbuf->buf, sbuf->count, pos);
+  return str_find_ws_word_end( sbuf_text(sbuf), sbuf->count, pos);
 }
 
 // find row/col position
 ic_private ssize_t sbuf_get_pos_at_rc( stringbuf_t* sbuf, ssize_t termw, ssize_t promptw, ssize_t cpromptw, ssize_t row, ssize_t col ) {
-  return str_get_pos_at_rc( sbuf->buf, sbuf->count, termw, promptw, cpromptw, row, col);
+  if (!sbuf_rows_ensure(sbuf, termw, promptw, cpromptw)) {
+    return str_get_pos_at_rc( sbuf_text(sbuf), sbuf->count, termw, promptw, cpromptw, row, col);
+  }
+  if (row < 0 || row >= sbuf->rows_valid) return -1;
+  rowcol_t rc;
+  memset(&rc,0,ssizeof(rc));
+  rc.row = row;
+  rc.col = col;
+  ssize_t pos = -1;
+  const sbuf_row_t* r = &sbuf->rows[row];
+  str_set_pos_iter(sbuf->buf, row, r->start, r->len, r->startw, r->is_wrap, &rc, &pos);
+  return pos;
 }
 
 // get row/col for a given position
 ic_private ssize_t sbuf_get_rc_at_pos( stringbuf_t* sbuf, ssize_t termw, ssize_t promptw, ssize_t cpromptw, ssize_t pos, rowcol_t* rc ) {
-  return str_get_rc_at_pos( sbuf->buf, sbuf->count, termw, promptw, cpromptw, pos, rc);
+  if (!sbuf_rows_ensure(sbuf, termw, promptw, cpromptw)) {
+    return str_get_rc_at_pos( sbuf_text(sbuf), sbuf->count, termw, promptw, cpromptw, pos, rc);
+  }
+  memset(rc, 0, sizeof(*rc));
+  // the cursor is on the last row that starts at or before it
+  ssize_t row = sbuf_rows_find(sbuf, pos);
+  const sbuf_row_t* r = &sbuf->rows[row];
+  str_get_current_pos_iter(sbuf->buf, row, r->start, r->len, r->startw, r->is_wrap, &pos, rc);
+  return sbuf->rows_valid;
 }
 
 ic_private ssize_t sbuf_get_wrapped_rc_at_pos( stringbuf_t* sbuf, ssize_t termw, ssize_t newtermw, ssize_t promptw, ssize_t cpromptw, ssize_t pos, rowcol_t* rc ) {
-  return str_get_wrapped_rc_at_pos( sbuf->buf, sbuf->count, termw, newtermw, promptw, cpromptw, pos, rc);
+  return str_get_wrapped_rc_at_pos( sbuf_text(sbuf), sbuf->count, termw, newtermw, promptw, cpromptw, pos, rc);
 }
 
 ic_private ssize_t sbuf_for_each_row( stringbuf_t* sbuf, ssize_t termw, ssize_t promptw, ssize_t cpromptw, row_fun_t* fun, void* arg, void* res ) {
   if (sbuf == NULL) return 0;
-  return str_for_each_row( sbuf->buf, sbuf->count, termw, promptw, cpromptw, fun, arg, res);
+  if (!sbuf_rows_ensure(sbuf, termw, promptw, cpromptw)) {
+    return str_for_each_row( sbuf_text(sbuf), sbuf->count, termw, promptw, cpromptw, fun, arg, res);
+  }
+  for (ssize_t row = 0; row < sbuf->rows_valid; row++) {
+    const sbuf_row_t* r = &sbuf->rows[row];
+    if (fun(sbuf->buf, row, r->start, r->len, r->startw, r->is_wrap, arg, res)) return row;
+  }
+  return sbuf->rows_valid;
 }
 
 
@@ -850,6 +1096,7 @@ ic_private char* sbuf_strdup_from_utf8(stringbuf_t* sbuf) {
   if (sbuf == NULL || len <= 0) return NULL;
   char* s = mem_zalloc_tp_n(sbuf->mem, char, len);
   if (s == NULL) return NULL;
+  const char* text = sbuf_text(sbuf);
   ssize_t dest = 0;
   for (ssize_t i = 0; i < len; ) {
     ssize_t ofs = sbuf_next_ofs(sbuf, i, NULL);
@@ -859,15 +1106,15 @@ ic_private char* sbuf_strdup_from_utf8(stringbuf_t* sbuf) {
     }
     else if (ofs == 1) {
       // regular character
-      s[dest++] = sbuf->buf[i];
+      s[dest++] = text[i];
     }
-    else if (sbuf->buf[i] == '\x1B') {
+    else if (text[i] == '\x1B') {
       // skip escape sequences
     }
     else {
       // decode unicode
       ssize_t nread;
-      unicode_t uchr = unicode_from_qutf8( (const uint8_t*)(sbuf->buf + i), ofs, &nread);
+      unicode_t uchr = unicode_from_qutf8( (const uint8_t*)(text + i), ofs, &nread);
       uint8_t c;
       if (unicode_is_raw(uchr, &c)) {
         // raw byte, output as is (this will take care of locale specific input)
@@ -39,6 +39,11 @@ ic_private ssize_t sbuf_append_vprintf(stringbuf_t* sb, const char* fmt, va_list
 
 ic_private stringbuf_t* sbuf_split_at( stringbuf_t* sb, ssize_t pos );
 
+// observe the primitive edit operations (used for undo).
+// Called with the removed text right before it is deleted, and with the inserted text right after it is inserted.
+typedef void (sbuf_observer_fun_t)(void* arg, ssize_t pos, const char* removed, ssize_t removed_len, const char* inserted, ssize_t inserted_len);
+ic_private void    sbuf_set_observer(stringbuf_t* sbuf, sbuf_observer_fun_t* observer, void* arg);
+
 // primitive edit operations (inserts return the new position)
 ic_private void    sbuf_clear(stringbuf_t* sbuf);
 ic_private void    sbuf_replace(stringbuf_t* sbuf, const char* s);
@@ -113,6 +118,7 @@ ic_private ssize_t sbuf_for_each_row( stringbuf_t* sbuf, ssize_t termw, ssize_t
 ic_private bool    skip_csi_esc( const char* s, ssize_t len, ssize_t* esclen ); // used in term.c
 
 ic_private ssize_t str_column_width( const char* s );
+ic_private ssize_t str_column_width_n( const char* s, ssize_t len );
 ic_private ssize_t str_prev_ofs( const char* s, ssize_t pos, ssize_t* cwidth );
 ic_private ssize_t str_next_ofs( const char* s, ssize_t len, ssize_t pos, ssize_t* cwidth );
 ic_private ssize_t str_skip_until_fit( const char* s, ssize_t max_width);  // tail that fits
@@ -51,6 +51,8 @@ struct term_s {
   palette_t     palette;            // color support
   buffer_mode_t bufmode;            // buffer mode
   stringbuf_t*  buf;                // buffer for buffered output
+  ssize_t       written;            // total bytes of output (to measure refresh costs)
+  ssize_t       write_calls;        // total write calls to the output handle
   tty_t*        tty;                // used on posix to get the cursor position
   alloc_t*      mem;                // allocator
   #ifdef _WIN32
@@ -210,7 +212,9 @@ ic_private void term_writef(term_t* term, const char* fmt, ...) {
 }
 
 ic_private void term_vwritef(term_t* term, const char* fmt, va_list args ) {
+  const ssize_t start = sbuf_len(term->buf);
   sbuf_append_vprintf(term->buf, fmt, args);
+  term->written += sbuf_len(term->buf) - start;
 }
 
 ic_private void term_write_formatted( term_t* term, const char* s, const attr_t* attrs ) {
@@ -266,6 +270,15 @@ ic_private void term_beep(term_t* term) {
   fflush(stderr);
 }
 
+// ask the terminal to bracket pasted text with ESC [ 200 ~ and ESC [ 201 ~
+ic_private void term_enable_bracketed_paste(term_t* term, bool enable) {
+  #if !defined(_WIN32)
+  term_write(term, (enable ? "\x1B[?2004h" : "\x1B[?2004l"));
+  #else
+  ic_unused(term); ic_unused(enable);
+  #endif
+}
+
 ic_private void term_write_repeat(term_t* term, const char* s, ssize_t count) {
   for (; count > 0; count--) {
     term_write(term, s);
@@ -300,6 +313,16 @@ ic_private void term_flush(term_t* term) {
   }  
 }
 
+// Total bytes written to the terminal (buffered or not).
+ic_private ssize_t term_get_written(const term_t* term) {
+  return term->written;
+}
+
+// Total write calls made to the output (a frame should take just one).
+ic_private ssize_t term_get_write_calls(const term_t* term) {
+  return term->write_calls;
+}
+
 ic_private buffer_mode_t term_set_buffer_mode(term_t* term, buffer_mode_t mode) {
   buffer_mode_t oldmode = term->bufmode;
   if (oldmode != mode) {
@@ -311,10 +334,11 @@ ic_private buffer_mode_t term_set_buffer_mode(term_t* term, buffer_mode_t mode)
   return oldmode;
 }
 
+// In BUFFERED mode the buffer grows until the frame is flushed explicitly
+// so a whole frame goes out in a single write.
 static void term_check_flush(term_t* term, bool contains_nl) {
   if (term->bufmode == UNBUFFERED || 
-      sbuf_len(term->buf) > 4000 ||
-      (term->bufmode == LINEBUFFERED && contains_nl)) 
+      (term->bufmode == LINEBUFFERED && (contains_nl || sbuf_len(term->buf) > 4000))) 
   {
     term_flush(term);
   }  
@@ -476,6 +500,7 @@ static void term_append_utf8(term_t* term, const char* s, ssize_t len) {
 }
 
 static void term_append_buf( term_t* term, const char* s, ssize_t len ) {
+  const ssize_t start = sbuf_len(term->buf);
   ssize_t pos = 0;
   bool newline = false;
   while (pos < len) {
@@ -511,6 +536,7 @@ static void term_append_buf( term_t* term, const char* s, ssize_t len ) {
     }
     pos += next;
   }  
+  term->written += sbuf_len(term->buf) - start;
   // possibly flush
   term_check_flush(term, newline);  
 }
@@ -526,6 +552,7 @@ static bool term_write_direct(term_t* term, const char* s, ssize_t n) {
   ssize_t count = 0; 
   while( count < n ) {
     ssize_t nwritten = write(term->fd_out, s + count, to_size_t(n - count));
+    term->write_calls++;
     if (nwritten > 0) {
       count += nwritten;
     }
@@ -559,6 +586,7 @@ static bool term_write_console(term_t* term, const char* s, ssize_t n ) {
   DWORD written;
   // WriteConsoleA(term->hcon, s, (DWORD)(to_size_t(n)), &written, NULL);
   WriteFile(term->hcon, s, (DWORD)(to_size_t(n)), &written, NULL); // so it can be redirected
+  term->write_calls++;
   return (written == (DWORD)(to_size_t(n)));
 }
 
@@ -871,6 +899,7 @@ static bool term_esc_query_raw( term_t* term, const char* query, char* buf, ssiz
 {
   if (buf==NULL || buflen <= 0 || query[0] == 0) return false;
   bool osc = (query[1] == ']');
+  term_flush(term);  // keep pending output ordered before the query
   if (!term_write_direct(term, query, ic_strlen(query))) return false;
   debug_msg("term: read tty query response to: ESC %s\n", query + 1);  
   return tty_read_esc_response( term->tty, query[1], osc, buf, buflen );
@@ -35,6 +35,8 @@ ic_private bool term_enable_color(term_t* term, bool enable);
 
 ic_private void term_flush(term_t* term);
 ic_private buffer_mode_t term_set_buffer_mode(term_t* term, buffer_mode_t mode);
+ic_private ssize_t term_get_written(const term_t* term);
+ic_private ssize_t term_get_write_calls(const term_t* term);
 
 ic_private void term_write_n(term_t* term, const char* s, ssize_t n);
 ic_private void term_write(term_t* term, const char* s);
@@ -43,6 +45,7 @@ ic_private void term_write_char(term_t* term, char c);
 
 ic_private void term_write_repeat(term_t* term, const char* s, ssize_t count );
 ic_private void term_beep(term_t* term);
+ic_private void term_enable_bracketed_paste(term_t* term, bool enable);
 
 ic_private bool term_update_dim(term_t* term);
 
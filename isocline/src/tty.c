@@ -48,6 +48,9 @@ struct tty_s {
   ssize_t   cpush_count;
   long      esc_initial_timeout;    // initial ms wait to see if ESC starts an escape sequence
   long      esc_timeout;            // follow up delay for characters in an escape sequence
+  stringbuf_t* paste;               // text of the last bracketed paste
+  int       event_fd;               // also wait for this handle in a blocking read (or -1)
+  bool      event_ready;            // did a blocking read return because `event_fd` is readable?
   #if defined(_WIN32)               
   HANDLE    hcon;                   // console input handle
   DWORD     hcon_orig_mode;         // original console mode
@@ -154,7 +157,12 @@ ic_private bool tty_read_timeout(tty_t* tty, long timeout_ms, code_t* code)
 
   // read a single char/byte from a character stream
   uint8_t c;
-  if (!tty_readc_noblock(tty, &c, timeout_ms)) return false;
+  if (!tty_readc_noblock(tty, &c, timeout_ms)) {
+    if (!tty->event_ready) return false;
+    tty->event_ready = false;
+    *code = KEY_EVENT_FD;
+    return true;
+  }
   
   if (c == KEY_ESC) {
     // escape sequence?
@@ -289,6 +297,15 @@ ic_private void tty_code_pushback( tty_t* tty, code_t c ) {
   tty->push_count++;
 }
 
+// Is there typeahead? Peeks with a zero timeout and pushes back what was read.
+ic_private bool tty_has_input(tty_t* tty) {
+  if (tty->push_count > 0 || tty->cpush_count > 0) return true;
+  uint8_t c;
+  if (!tty_readc_noblock(tty, &c, 0)) return false;
+  tty_cpush_char(tty, c);
+  return true;
+}
+
 
 //-------------------------------------------------------------
 // low-level character pushback (for escape sequences and windows)
@@ -397,6 +414,7 @@ ic_private tty_t* tty_new(alloc_t* mem, int fd_in)
   tty_t* tty = mem_zalloc_tp(mem, tty_t);
   tty->mem = mem;
   tty->fd_in = (fd_in < 0 ? STDIN_FILENO : fd_in);
+  tty->event_fd = -1;
   #if defined(__APPLE__)
   tty->esc_initial_timeout = 200;  // apple use ESC+<key> for alt-<key>
   #else
@@ -414,9 +432,17 @@ ic_private void tty_free(tty_t* tty) {
   if (tty==NULL) return;
   tty_end_raw(tty);
   tty_done_raw(tty);
+  sbuf_free(tty->paste);
   mem_free(tty->mem,tty);
 }
 
+ic_private stringbuf_t* tty_paste_buf(tty_t* tty) {
+  if (tty->paste == NULL) {
+    tty->paste = sbuf_new(tty->mem);
+  }
+  return tty->paste;
+}
+
 ic_private bool tty_is_utf8(const tty_t* tty) {
   if (tty == NULL) return true;
   return (tty->is_utf8);
@@ -431,6 +457,11 @@ ic_private bool tty_term_resize_event(tty_t* tty) {
   return true;  // always return true on systems without a resize event (more expensive but still ok)
 }
 
+ic_private void tty_set_event_fd(tty_t* tty, int fd) {
+  tty->event_fd = fd;
+  tty->event_ready = false;
+}
+
 ic_private void tty_set_esc_delay(tty_t* tty, long initial_delay_ms, long followup_delay_ms) {
   tty->esc_initial_timeout = (initial_delay_ms < 0 ? 0 : (initial_delay_ms > 1000 ? 1000 : initial_delay_ms));
   tty->esc_timeout = (followup_delay_ms < 0 ? 0 : (followup_delay_ms > 1000 ? 1000 : followup_delay_ms));
@@ -444,6 +475,21 @@ ic_private void tty_set_esc_delay(tty_t* tty, long initial_delay_ms, long follow
 static bool tty_readc_blocking(tty_t* tty, uint8_t* c) {
   if (tty_cpop(tty,c)) return true;
   *c = 0;
+  #if defined(FD_SET)
+  if (tty->event_fd >= 0) {
+    // wait until either a key is pressed or the event handle is readable
+    fd_set readset;
+    FD_ZERO(&readset);
+    FD_SET(tty->fd_in, &readset);
+    FD_SET(tty->event_fd, &readset);
+    const int maxfd = (tty->fd_in > tty->event_fd ? tty->fd_in : tty->event_fd);
+    if (select(maxfd + 1, &readset, NULL, NULL, NULL) <= 0) return false;  // interrupted by a signal
+    if (!FD_ISSET(tty->fd_in, &readset)) {
+      tty->event_ready = true;
+      return false;
+    }
+  }
+  #endif
   ssize_t nread = read(tty->fd_in, (char*)c, 1);
   if (nread < 0 && errno == EINTR) {
     // can happen on SIGWINCH signal for terminal resize
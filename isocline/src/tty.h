@@ -9,6 +9,7 @@
 #define IC_TTY_H
 
 #include "common.h"
+#include "stringbuf.h"
 
 //-------------------------------------------------------------
 // TTY/Keyboard input 
@@ -32,6 +33,7 @@ ic_private code_t tty_read(tty_t* tty);
 ic_private bool   tty_read_timeout(tty_t* tty, long timeout_ms, code_t* c );
 
 ic_private void   tty_code_pushback( tty_t* tty, code_t c );
+ic_private bool   tty_has_input(tty_t* tty);  // is more input immediately available? (does not block)
 ic_private bool   code_is_ascii_char(code_t c, char* chr );
 ic_private bool   code_is_unicode(code_t c, unicode_t* uchr);
 ic_private bool   code_is_virt_key(code_t c );
@@ -39,12 +41,14 @@ ic_private bool   code_is_virt_key(code_t c );
 ic_private bool   tty_term_resize_event(tty_t* tty); // did the terminal resize?
 ic_private bool   tty_async_stop(const tty_t* tty);  // unblock the read asynchronously
 ic_private void   tty_set_esc_delay(tty_t* tty, long initial_delay_ms, long followup_delay_ms);
+ic_private void   tty_set_event_fd(tty_t* tty, int fd);  // a blocking read returns KEY_EVENT_FD when `fd` is readable (or -1)
 
 // shared between tty.c and tty_esc.c: low level character push
 ic_private void   tty_cpush_char(tty_t* tty, uint8_t c);
 ic_private bool   tty_cpop(tty_t* tty, uint8_t* c);
 ic_private bool   tty_readc_noblock(tty_t* tty, uint8_t* c, long timeout_ms);
 ic_private code_t tty_read_esc(tty_t* tty, long esc_initial_timeout, long esc_timeout); // in tty_esc.c
+ic_private stringbuf_t* tty_paste_buf(tty_t* tty);  // raw text of the last bracketed paste (KEY_EVENT_PASTE)
 
 // used by term.c to read back ANSI escape responses
 ic_private bool   tty_read_esc_response(tty_t* tty, char esc_start, bool final_st, char* buf, ssize_t buflen ); 
@@ -142,6 +146,8 @@ static inline code_t key_unicode( unicode_t u ) {
 #define KEY_EVENT_RESIZE  (KEY_EVENT_BASE+1)
 #define KEY_EVENT_AUTOTAB (KEY_EVENT_BASE+2)
 #define KEY_EVENT_STOP    (KEY_EVENT_BASE+3)
+#define KEY_EVENT_PASTE   (KEY_EVENT_BASE+4)  // bracketed paste; the text is in `tty_paste_buf`
+#define KEY_EVENT_FD      (KEY_EVENT_BASE+5)  // the event file descriptor is readable
 
 // Convenience
 #define KEY_CTRL_UP       (WITH_CTRL(KEY_UP))
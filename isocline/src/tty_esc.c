@@ -236,6 +236,30 @@ static void tty_read_csi_num(tty_t* tty, uint8_t* ppeek, uint32_t* num, long esc
   if (count > 0) *num = i;
 }
 
+//-------------------------------------------------------------
+// Bracketed paste: ESC [ 200 ~ <text> ESC [ 201 ~
+//-------------------------------------------------------------
+#define TTY_PASTE_TIMEOUT  (500)   // ms to wait for the rest of a paste
+
+static code_t tty_read_paste(tty_t* tty) {
+  stringbuf_t* buf = tty_paste_buf(tty);
+  if (buf == NULL) return KEY_NONE;
+  sbuf_clear(buf);
+  const char* end_marker = "\x1B[201~";
+  const ssize_t end_len = 6;
+  uint8_t c;
+  while (tty_readc_noblock(tty, &c, TTY_PASTE_TIMEOUT)) {
+    sbuf_append_char(buf, (char)c);
+    const ssize_t len = sbuf_len(buf);
+    if (c == '~' && len >= end_len && strcmp(sbuf_string_at(buf, len - end_len), end_marker) == 0) {
+      sbuf_delete_from(buf, len - end_len);
+      break;
+    }
+  }
+  debug_msg("tty: bracketed paste of %zd bytes\n", sbuf_len(buf));
+  return (sbuf_len(buf) > 0 ? KEY_EVENT_PASTE : KEY_NONE);
+}
+
 static code_t tty_read_csi(tty_t* tty, uint8_t c1, uint8_t peek, code_t mods0, long esc_timeout) {
   // CSI starts with 0x9b (c1=='[') | ESC [ (c1=='[') | ESC [Oo?] (c1 == 'O')  /* = SS3 */
   
@@ -311,7 +335,11 @@ static code_t tty_read_csi(tty_t* tty, uint8_t c1, uint8_t peek, code_t mods0, l
 
   // and translate
   code_t code = KEY_NONE;
-  if (final == '~') {
+  if (final == '~' && c1 == '[' && num1 == 200) {
+    // start of a bracketed paste
+    return tty_read_paste(tty);
+  }
+  else if (final == '~') {
     // vt codes
     code = esc_decode_vt(num1);
   }
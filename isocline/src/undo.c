@@ -18,11 +18,29 @@
 
 //-------------------------------------------------------------
 // edit state
+// Instead of snapshots of the input, the undo (and redo) stack
+// records the edits themselves: a capture pushes a group marker
+// and every following edit is recorded as its position with the
+// removed and inserted text. Restoring reverts the edits of the
+// top group in reverse order, so both memory and time are
+// proportional to the size of the edits instead of the input.
 //-------------------------------------------------------------
+
+#define IC_UNDO_MAX_SIZE  (1024*1024)  // when a stack grows larger, the oldest half of the groups is dropped
+
+typedef struct editop_s {
+  ssize_t pos;            // position of the edit, or the cursor position for a group marker
+  ssize_t removed_len;    // length of the removed text, or -1 for a group marker
+  ssize_t inserted_len;   // length of the inserted text
+  ssize_t text;           // offset of the removed text (followed by the inserted text) in `text`
+} editop_t;
+
 struct editstate_s {
-  struct editstate_s* next;
-  const char* input;          // input
-  ssize_t     pos;            // cursor position
+  editop_t*    ops;       // edits and group markers
+  ssize_t      count;
+  ssize_t      capacity;
+  ssize_t      groups;    // number of group markers
+  stringbuf_t* text;      // removed and inserted text of all edits
 };
 
 ic_private void editstate_init( editstate_t** es ) {
@@ -30,38 +48,115 @@ ic_private void editstate_init( editstate_t** es ) {
 }
 
 ic_private void editstate_done( alloc_t* mem, editstate_t** es ) {
-  while (*es != NULL) {
-    editstate_t* next = (*es)->next;
-    mem_free(mem, (*es)->input);
-    mem_free(mem, *es );
-    *es = next;
-  }
+  if (*es == NULL) return;
+  sbuf_free((*es)->text);
+  mem_free(mem, (*es)->ops);
+  mem_free(mem, *es);
   *es = NULL;
 }
 
-ic_private void editstate_capture( alloc_t* mem, editstate_t** es, const char* input, ssize_t pos) {
-  if (input==NULL) input = "";
-  // alloc
-  editstate_t* entry = mem_zalloc_tp(mem, editstate_t);
-  if (entry == NULL) return;
-  // initialize
-  entry->input = mem_strdup( mem, input);
-  entry->pos   = pos;
-  if (entry->input == NULL) { mem_free(mem, entry); return; }
-  // and push
-  entry->next = *es;
-  *es = entry;
+static bool editop_is_group( const editop_t* op ) {
+  return (op->removed_len < 0);
 }
 
-// caller should free *input
-ic_private bool editstate_restore( alloc_t* mem, editstate_t** es, const char** input, ssize_t* pos ) {
-  if (*es == NULL) return false;
-  // pop 
-  editstate_t* entry = *es;
-  *es = entry->next;
-  *input = entry->input;
-  *pos = entry->pos;
-  mem_free(mem, entry);
+static bool editstate_push( alloc_t* mem, editstate_t* es, ssize_t pos, const char* removed, ssize_t removed_len, const char* inserted, ssize_t inserted_len ) {
+  if (es->count >= es->capacity) {
+    ssize_t newcap = (es->capacity <= 0 ? 64 : 2*es->capacity);
+    editop_t* newops = mem_realloc_tp(mem, editop_t, es->ops, newcap);
+    if (newops == NULL) return false;
+    es->ops = newops;
+    es->capacity = newcap;
+  }
+  editop_t* op = &es->ops[es->count++];
+  op->pos = pos;
+  op->removed_len = removed_len;
+  op->inserted_len = inserted_len;
+  op->text = sbuf_len(es->text);
+  if (removed_len > 0)  { sbuf_append_n(es->text, removed, removed_len); }
+  if (inserted_len > 0) { sbuf_append_n(es->text, inserted, inserted_len); }
   return true;
 }
 
+// drop the oldest groups when the stack grows too large (but always keep the newest group)
+static void editstate_limit( editstate_t* es ) {
+  if (sbuf_len(es->text) + es->count*ssizeof(editop_t) <= IC_UNDO_MAX_SIZE) return;
+  ssize_t keep = (es->groups > 1 ? es->groups/2 : 1);
+  ssize_t start = es->count;
+  ssize_t found = 0;
+  while (start > 0 && found < keep) {
+    start--;
+    if (editop_is_group(&es->ops[start])) found++;
+  }
+  if (start <= 0) return;
+  const ssize_t text_start = es->ops[start].text;
+  sbuf_delete_at(es->text, 0, text_start);
+  ic_memmove(es->ops, es->ops + start, (es->count - start)*ssizeof(editop_t));
+  es->count -= start;
+  for (ssize_t i = 0; i < es->count; i++) {
+    es->ops[i].text -= text_start;
+  }
+  es->groups = keep;
+  debug_msg("undo: dropped %zd oldest edits\n", start);
+}
+
+ic_private void editstate_capture( alloc_t* mem, editstate_t** es, ssize_t pos) {
+  if (*es == NULL) {
+    editstate_t* entry = mem_zalloc_tp(mem, editstate_t);
+    if (entry == NULL) return;
+    entry->text = sbuf_new(mem);
+    if (entry->text == NULL) { mem_free(mem, entry); return; }
+    *es = entry;
+  }
+  editstate_limit(*es);
+  if (editstate_push(mem, *es, pos, NULL, -1, NULL, 0)) {
+    (*es)->groups++;
+  }
+}
+
+ic_private void editstate_record( alloc_t* mem, editstate_t** es, ssize_t pos, const char* removed, ssize_t removed_len, const char* inserted, ssize_t inserted_len ) {
+  if (*es == NULL || (*es)->groups == 0) return;
+  if (removed_len <= 0 && inserted_len <= 0) return;
+  editstate_push(mem, *es, pos, removed, (removed_len > 0 ? removed_len : 0), inserted, (inserted_len > 0 ? inserted_len : 0));
+}
+
+ic_private void editstate_forget( editstate_t** es ) {
+  editstate_t* state = *es;
+  if (state == NULL || state->groups == 0) return;
+  if (state->groups == 1) {
+    // no earlier group to join, so these edits can no longer be undone
+    state->count = 0;
+    state->groups = 0;
+    sbuf_clear(state->text);
+    return;
+  }
+  ssize_t i = state->count - 1;
+  while (!editop_is_group(&state->ops[i])) { i--; }
+  ic_memmove(state->ops + i, state->ops + i + 1, (state->count - i - 1)*ssizeof(editop_t));
+  state->count--;
+  state->groups--;
+}
+
+ic_private bool editstate_restore( alloc_t* mem, editstate_t** es, editstate_t** to, stringbuf_t* input, ssize_t* pos ) {
+  editstate_t* state = *es;
+  if (state == NULL || state->groups == 0) return false;
+  if (to != NULL) { editstate_capture(mem, to, *pos); }
+  // revert the edits of the top group in reverse order
+  while (state->count > 0 && !editop_is_group(&state->ops[state->count-1])) {
+    const editop_t* op = &state->ops[state->count-1];
+    const char* removed = sbuf_string_at(state->text, op->text);
+    const char* inserted = removed + op->removed_len;
+    if (to != NULL) {
+      editstate_record(mem, to, op->pos, inserted, op->inserted_len, removed, op->removed_len);
+    }
+    sbuf_delete_at(input, op->pos, op->inserted_len);
+    sbuf_insert_at_n(input, removed, op->removed_len, op->pos);
+    sbuf_delete_from(state->text, op->text);
+    state->count--;
+  }
+  // and pop the group marker
+  assert(state->count > 0);
+  state->count--;
+  state->groups--;
+  *pos = state->ops[state->count].pos;
+  return true;
+}
@@ -9,6 +9,7 @@
 #define IC_UNDO_H
 
 #include "common.h"
+#include "stringbuf.h"
 
 //-------------------------------------------------------------
 // Edit state
@@ -18,7 +19,14 @@ typedef struct editstate_s editstate_t;
 
 ic_private void editstate_init( editstate_t** es );
 ic_private void editstate_done( alloc_t* mem, editstate_t** es );
-ic_private void editstate_capture( alloc_t* mem, editstate_t** es, const char* input, ssize_t pos);
-ic_private bool editstate_restore( alloc_t* mem, editstate_t** es, const char** input, ssize_t* pos ); // caller needs to free input
+// start a new undo group at cursor position `pos`
+ic_private void editstate_capture( alloc_t* mem, editstate_t** es, ssize_t pos);
+// record an edit in the current group (ignored if no group was captured)
+ic_private void editstate_record( alloc_t* mem, editstate_t** es, ssize_t pos, const char* removed, ssize_t removed_len, const char* inserted, ssize_t inserted_len );
+// forget the current group; its edits become part of the previous group
+ic_private void editstate_forget( editstate_t** es );
+// revert the edits of the current group on `input` and set `pos` to the captured cursor position.
+// If `to` is not NULL, the reverting edits are recorded there as a new group (for redo).
+ic_private bool editstate_restore( alloc_t* mem, editstate_t** es, editstate_t** to, stringbuf_t* input, ssize_t* pos );
 
 #endif // IC_UNDO_H
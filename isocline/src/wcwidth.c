@@ -61,6 +61,7 @@
  */
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <string.h>
 
 struct interval {
@@ -290,3 +291,62 @@ static int mk_wcwidth(int32_t ucs) {
   return ( mk_is_wide_char( ucs ) ? 2 : 1 );
 }
 
+
+/* ----------------------------------------------------------------------------
+  Cached widths (added for isocline)
+
+  A two-level lookup table in front of `mk_wcwidth`: the first level maps
+  each block of 256 code points to either a uniform width (most blocks) or
+  to a page of per code point widths in the second level. Blocks are filled
+  in lazily on first use so startup does not pay for scripts never seen.
+-----------------------------------------------------------------------------*/
+
+#define WC_BLOCK_SHIFT  (8)
+#define WC_BLOCK_SIZE   (1 << WC_BLOCK_SHIFT)
+#define WC_BLOCKS       (0x110000 >> WC_BLOCK_SHIFT)
+#define WC_MAX_PAGES    (128)     // currently 85 blocks have mixed widths
+
+// block entries: 0 = not computed yet, 1..4 = uniform width (w+2),
+// WC_PAGE_BASE+i = page i, WC_NO_PAGE = mixed but out of pages.
+#define WC_UNIFORM(w)   ((uint8_t)((w) + 2))
+#define WC_PAGE_BASE    (5)
+#define WC_NO_PAGE      (255)
+
+static uint8_t wc_blocks[WC_BLOCKS];
+static int8_t  wc_pages[WC_MAX_PAGES][WC_BLOCK_SIZE];
+static int     wc_page_count;
+
+static uint8_t wc_block_init(int32_t block) {
+  int8_t  widths[WC_BLOCK_SIZE];
+  int32_t base = block << WC_BLOCK_SHIFT;
+  bool    uniform = true;
+  for (int i = 0; i < WC_BLOCK_SIZE; i++) {
+    widths[i] = (int8_t)mk_wcwidth(base + i);
+    if (widths[i] != widths[0]) uniform = false;
+  }
+  uint8_t entry;
+  if (uniform) {
+    entry = WC_UNIFORM(widths[0]);
+  }
+  else if (wc_page_count < WC_MAX_PAGES) {
+    memcpy(wc_pages[wc_page_count], widths, sizeof(widths));
+    entry = (uint8_t)(WC_PAGE_BASE + wc_page_count);
+    wc_page_count++;
+  }
+  else {
+    entry = WC_NO_PAGE;
+  }
+  wc_blocks[block] = entry;
+  return entry;
+}
+
+static int mk_wcwidth_cached(int32_t ucs) {
+  if (ucs >= 0x20 && ucs < 0x7F) return 1;
+  if (ucs < 0 || ucs >= 0x110000) return mk_wcwidth(ucs);
+  int32_t block = ucs >> WC_BLOCK_SHIFT;
+  uint8_t entry = wc_blocks[block];
+  if (entry == 0) entry = wc_block_init(block);
+  if (entry < WC_PAGE_BASE) return (int)entry - 2;
+  if (entry == WC_NO_PAGE) return mk_wcwidth(ucs);
+  return wc_pages[entry - WC_PAGE_BASE][ucs & (WC_BLOCK_SIZE - 1)];
+}
@@ -0,0 +1,269 @@
+#include "array.h"
+
+#include "ealloc.h"
+#include "stringhashmap.h"
+#include "utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ARRAY_MAP_BUCKETS 256
+#define ASSOCIATIVE_ARRAY_BUCKETS 64
+#define DEFAULT_ARRAY_CAPACITY 8
+#define DEFAULT_ARRAY_DATA_CAPACITY 64
+
+struct Array {
+    char *data; //NUL terminated elements stored back to back
+    size_t dataSize;
+    size_t dataCapacity;
+    size_t unusedSize; //Bytes in data that belong to replaced elements
+    size_t *offsets; //Where each element starts in data
+    int size;
+    int capacity;
+    StringHashMap *keys; //Maps keys to values for associative arrays, NULL for indexed arrays
+    char *joined; //Cached result of Array_join, NULL if it needs to be rebuilt
+};
+
+Array* Array_create(bool associative) {
+    Array *array = emalloc(sizeof(Array));
+    array->data = NULL;
+    array->dataSize = 0;
+    array->dataCapacity = 0;
+    array->unusedSize = 0;
+    array->offsets = NULL;
+    array->size = 0;
+    array->capacity = 0;
+    array->keys = associative ? StringHashMap_createSize(ASSOCIATIVE_ARRAY_BUCKETS) : NULL;
+    array->joined = NULL;
+    return array;
+}
+
+void Array_free(Array *array) {
+    if (array->keys != NULL) {
+        StringHashMap_free(array->keys);
+    }
+    free(array->data);
+    free(array->offsets);
+    free(array->joined);
+    free(array);
+}
+
+bool Array_isAssociative(Array *array) {
+    return array->keys != NULL;
+}
+
+int Array_size(Array *array) {
+    return array->size;
+}
+
+char* Array_get(Array *array, int index) {
+    if (array->keys != NULL || index < 0 || index >= array->size) {
+        return NULL;
+    }
+    return array->data + array->offsets[index];
+}
+
+/**
+ * Moves the live elements to the front of data, dropping the
+ * space left behind by elements that were replaced with longer values
+*/
+void Array_compact(Array *array) {
+    char *newData = emalloc(sizeof(char) * array->dataCapacity);
+    size_t newSize = 0;
+    for (int i = 0; i < array->size; i++) {
+        size_t elementSize = strlen(array->data + array->offsets[i]) + 1;
+        memcpy(newData + newSize, array->data + array->offsets[i], elementSize);
+        array->offsets[i] = newSize;
+        newSize += elementSize;
+    }
+    free(array->data);
+    array->data = newData;
+    array->dataSize = newSize;
+    array->unusedSize = 0;
+}
+
+//Copies value to the end of data and returns its offset
+size_t Array_store(Array *array, char *value) {
+    size_t valueSize = strlen(value) + 1;
+    if (array->unusedSize > array->dataSize / 2 && array->unusedSize >= DEFAULT_ARRAY_DATA_CAPACITY) {
+        Array_compact(array);
+    }
+    if (array->dataSize + valueSize > array->dataCapacity) {
+        size_t newCapacity = array->dataCapacity > 0 ? array->dataCapacity : DEFAULT_ARRAY_DATA_CAPACITY;
+        while (array->dataSize + valueSize > newCapacity) {
+            newCapacity *= 2;
+        }
+        array->data = erealloc(array->data, sizeof(char) * newCapacity);
+        array->dataCapacity = newCapacity;
+    }
+    size_t offset = array->dataSize;
+    memcpy(array->data + offset, value, valueSize);
+    array->dataSize += valueSize;
+    return offset;
+}
+
+void Array_append(Array *array, char *value) {
+    if (array->keys != NULL) {
+        return;
+    }
+    if (array->size >= array->capacity) {
+        array->capacity = array->capacity > 0 ? array->capacity * 2 : DEFAULT_ARRAY_CAPACITY;
+        array->offsets = erealloc(array->offsets, sizeof(size_t) * (size_t) array->capacity);
+    }
+    array->offsets[array->size++] = Array_store(array, value);
+    free(array->joined);
+    array->joined = NULL;
+}
+
+void Array_set(Array *array, int index, char *value) {
+    if (array->keys != NULL || index < 0) {
+        return;
+    }
+    while (array->size < index) {
+        Array_append(array, "");
+    }
+    if (index == array->size) {
+        Array_append(array, value);
+        return;
+    }
+
+    //A value that fits in the space of the old one is written in place
+    char *element = array->data + array->offsets[index];
+    size_t elementLen = strlen(element);
+    size_t valueLen = strlen(value);
+    if (valueLen <= elementLen) {
+        memcpy(element, value, valueLen + 1);
+        array->unusedSize += elementLen - valueLen;
+    } else {
+        array->unusedSize += elementLen + 1;
+        array->offsets[index] = Array_store(array, value);
+    }
+    free(array->joined);
+    array->joined = NULL;
+}
+
+char* Array_getKey(Array *array, char *key) {
+    if (array->keys == NULL) {
+        return NULL;
+    }
+    return StringHashMap_get(array->keys, key);
+}
+
+void Array_setKey(Array *array, char *key, char *value) {
+    if (array->keys == NULL) {
+        return;
+    }
+    bool replacing = StringHashMap_get(array->keys, key) != NULL;
+    StringHashMap_put(array->keys, replacing ? key : strdup(key), !replacing, strdup(value), true);
+    if (!replacing) {
+        array->size++;
+    }
+    free(array->joined);
+    array->joined = NULL;
+}
+
+char** Array_keys(Array *array) {
+    char **keys = emalloc(sizeof(char*) * (size_t) (array->size + 1));
+    if (array->keys == NULL) {
+        return keys;
+    }
+    char ***entries = StringHashMap_entries(array->keys);
+    for (int i = 0; i < array->size; i++) {
+        keys[i] = entries[i][0];
+        free(entries[i]);
+    }
+    free(entries);
+    qsort(keys, (size_t) array->size, sizeof(char*), compareStrings);
+    return keys;
+}
+
+char* Array_join(Array *array) {
+    if (array->joined != NULL) {
+        return array->joined;
+    }
+
+    char **keys = array->keys != NULL ? Array_keys(array) : NULL;
+    size_t joinedSize = 1;
+    for (int i = 0; i < array->size; i++) {
+        char *value = keys != NULL ? Array_getKey(array, keys[i]) : Array_get(array, i);
+        joinedSize += strlen(value) + 1;
+    }
+    array->joined = emalloc(sizeof(char) * joinedSize);
+    char *joinedPtr = array->joined;
+    for (int i = 0; i < array->size; i++) {
+        char *value = keys != NULL ? Array_getKey(array, keys[i]) : Array_get(array, i);
+        size_t valueLen = strlen(value);
+        if (i > 0) {
+            *joinedPtr++ = ' ';
+        }
+        memcpy(joinedPtr, value, valueLen);
+        joinedPtr += valueLen;
+    }
+    *joinedPtr = '\0';
+    free(keys);
+    return array->joined;
+}
+
+struct ArrayMap {
+    StringHashMap *arrays; //Maps names to Array pointers, which the hash map itself never frees
+    int size;
+};
+
+ArrayMap* ArrayMap_create(void) {
+    ArrayMap *map = emalloc(sizeof(ArrayMap));
+    map->arrays = StringHashMap_createSize(ARRAY_MAP_BUCKETS);
+    map->size = 0;
+    return map;
+}
+
+void ArrayMap_free(ArrayMap *map) {
+    char ***entries = StringHashMap_entries(map->arrays);
+    for (int i = 0; i < map->size; i++) {
+        Array_free((Array*) entries[i][1]);
+        free(entries[i]);
+    }
+    free(entries);
+    StringHashMap_free(map->arrays);
+    free(map);
+}
+
+Array* ArrayMap_get(ArrayMap *map, char *name) {
+    return (Array*) StringHashMap_get(map->arrays, name);
+}
+
+void ArrayMap_put(ArrayMap *map, char *name, Array *array) {
+    Array *oldArray = ArrayMap_get(map, name);
+    if (oldArray == array) {
+        return;
+    }
+    if (oldArray != NULL) {
+        Array_free(oldArray);
+    } else {
+        map->size++;
+    }
+    StringHashMap_put(map->arrays, oldArray != NULL ? name : strdup(name), oldArray == NULL, (char*) array, false);
+}
+
+void ArrayMap_remove(ArrayMap *map, char *name) {
+    Array *array = ArrayMap_get(map, name);
+    if (array != NULL) {
+        StringHashMap_remove(map->arrays, name);
+        Array_free(array);
+        map->size--;
+    }
+}
+
+char** ArrayMap_names(ArrayMap *map) {
+    char **names = emalloc(sizeof(char*) * (size_t) (map->size + 1));
+    char ***entries = StringHashMap_entries(map->arrays);
+    for (int i = 0; i < map->size; i++) {
+        names[i] = entries[i][0];
+        free(entries[i]);
+    }
+    free(entries);
+    qsort(names, (size_t) map->size, sizeof(char*), compareStrings);
+    return names;
+}
+
+int ArrayMap_size(ArrayMap *map) {
+    return map->size;
+}
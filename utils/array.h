@@ -0,0 +1,53 @@
+#ifndef ALSH_ARRAY_
+#define ALSH_ARRAY_
+
+#include <stdbool.h>
+
+/**
+ * Array variable, either indexed or associative
+ * The elements of an indexed array are stored back to back in one buffer
+ * and found through an array of offsets, so reading an element or iterating
+ * over all of them never splits or copies strings
+ * Associative arrays map keys to values with a StringHashMap
+*/
+typedef struct Array Array;
+
+Array* Array_create(bool associative);
+void Array_free(Array *array);
+
+bool Array_isAssociative(Array *array);
+int Array_size(Array *array);
+
+//Indexed arrays only; returns NULL if index is out of range
+char* Array_get(Array *array, int index);
+void Array_append(Array *array, char *value);
+//Setting an index past the end fills the elements in between with empty strings
+void Array_set(Array *array, int index, char *value);
+
+//Associative arrays only; returns NULL if key is not set
+char* Array_getKey(Array *array, char *key);
+void Array_setKey(Array *array, char *key, char *value);
+//Returns an array of Array_size sorted keys, which must be freed but not the keys themselves
+char** Array_keys(Array *array);
+
+//Returns the values separated by spaces, which stays valid until the array changes
+char* Array_join(Array *array);
+
+/**
+ * Named array variables
+ * The arrays are owned by the map and freed when they are replaced or removed
+*/
+typedef struct ArrayMap ArrayMap;
+
+ArrayMap* ArrayMap_create(void);
+void ArrayMap_free(ArrayMap *map);
+
+//Returns the array with the given name, or NULL if there is none
+Array* ArrayMap_get(ArrayMap *map, char *name);
+void ArrayMap_put(ArrayMap *map, char *name, Array *array);
+void ArrayMap_remove(ArrayMap *map, char *name);
+//Returns an array of ArrayMap_size sorted names, which must be freed but not the names themselves
+char** ArrayMap_names(ArrayMap *map);
+int ArrayMap_size(ArrayMap *map);
+
+#endif // ALSH_ARRAY_
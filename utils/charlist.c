@@ -52,9 +52,24 @@ void CharList_add(CharList *list, char value) {
 }
 
 void CharList_addStr(CharList *list, char *str) {
-    while (*str) {
-        CharList_add(list, *str++);
+    CharList_addStrN(list, str, (int) strlen(str));
+}
+
+void CharList_addStrN(CharList *list, const char *str, int n) {
+    if (n <= 0) {
+        return;
+    }
+    if (list->size + n >= list->capacity) {
+        int oldCapacity = list->capacity;
+        while (list->size + n >= list->capacity) {
+            list->capacity *= 2;
+        }
+        list->data = erealloc(list->data, sizeof(char) * (size_t) list->capacity);
+        memset(list->data + oldCapacity, 0, (size_t) (list->capacity - oldCapacity));
     }
+    memcpy(list->data + list->size, str, (size_t) n);
+    list->size += n;
+    list->data[list->size] = '\0';
 }
 
 void CharList_clear(CharList *list) {
@@ -16,6 +16,7 @@ void CharList_free(CharList *list);
 void CharList_addAt(CharList *list, int index, char value);
 void CharList_add(CharList *list, char value);
 void CharList_addStr(CharList *list, char *str);
+void CharList_addStrN(CharList *list, const char *str, int n);
 void CharList_clear(CharList *list);
 char CharList_get(CharList *list, int index);
 int CharList_indexOf(CharList *list, char value);
@@ -0,0 +1,126 @@
+#include "environment.h"
+
+#include "ealloc.h"
+#include "stringhashmap.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ENVIRONMENT_BUCKETS 256
+
+//An envp array that was replaced by a rebuild
+typedef struct RetiredEnvp {
+    char **envp;
+    char *envpData;
+    struct RetiredEnvp *next;
+} RetiredEnvp;
+
+struct Environment {
+    StringHashMap *vars; //Maps variable names to their values
+    int size;
+    char **envp; //Array handed to new processes
+    char *envpData; //name=value strings that envp points into
+    bool dirty; //Has a variable changed since envp was built?
+    RetiredEnvp *retired; //Old arrays, still reachable through pointers returned by getenv
+};
+
+Environment* Environment_create(char **envp) {
+    Environment *env = emalloc(sizeof(Environment));
+    env->vars = StringHashMap_createSize(ENVIRONMENT_BUCKETS);
+    env->size = 0;
+    env->envp = NULL;
+    env->envpData = NULL;
+    env->dirty = true;
+    env->retired = NULL;
+    for (char **envPtr = envp; envPtr != NULL && *envPtr != NULL; envPtr++) {
+        char *equalsSign = strchr(*envPtr, '=');
+        if (equalsSign == NULL || equalsSign == *envPtr) {
+            continue;
+        }
+        size_t nameLen = (size_t) (equalsSign - *envPtr);
+        char *name = emalloc(sizeof(char) * (nameLen + 1));
+        memcpy(name, *envPtr, nameLen);
+        name[nameLen] = '\0';
+        Environment_set(env, name, equalsSign + 1);
+        free(name);
+    }
+    return env;
+}
+
+void Environment_free(Environment *env) {
+    StringHashMap_free(env->vars);
+    free(env->envp);
+    free(env->envpData);
+    while (env->retired != NULL) {
+        RetiredEnvp *next = env->retired->next;
+        free(env->retired->envp);
+        free(env->retired->envpData);
+        free(env->retired);
+        env->retired = next;
+    }
+    free(env);
+}
+
+char* Environment_get(Environment *env, char *name) {
+    return StringHashMap_get(env->vars, name);
+}
+
+void Environment_set(Environment *env, char *name, char *value) {
+    bool replacing = StringHashMap_get(env->vars, name) != NULL;
+    StringHashMap_put(env->vars, replacing ? name : strdup(name), !replacing, strdup(value), true);
+    if (!replacing) {
+        env->size++;
+    }
+    env->dirty = true;
+}
+
+void Environment_unset(Environment *env, char *name) {
+    if (StringHashMap_get(env->vars, name) != NULL) {
+        StringHashMap_remove(env->vars, name);
+        env->size--;
+        env->dirty = true;
+    }
+}
+
+char** Environment_envp(Environment *env) {
+    if (!env->dirty) {
+        return env->envp;
+    }
+
+    //All strings go in a single block so the array is rebuilt with two allocations
+    char ***entries = StringHashMap_entries(env->vars);
+    size_t dataSize = 0;
+    for (int i = 0; i < env->size; i++) {
+        dataSize += strlen(entries[i][0]) + strlen(entries[i][1]) + 2;
+    }
+    //The old array stays allocated, since environ or a value returned by getenv may still point into it
+    if (env->envp != NULL) {
+        RetiredEnvp *retired = emalloc(sizeof(RetiredEnvp));
+        retired->envp = env->envp;
+        retired->envpData = env->envpData;
+        retired->next = env->retired;
+        env->retired = retired;
+    }
+    env->envp = emalloc(sizeof(char*) * (size_t) (env->size + 1));
+    env->envpData = emalloc(sizeof(char) * (dataSize + 1));
+
+    char *dataPtr = env->envpData;
+    for (int i = 0; i < env->size; i++) {
+        size_t nameLen = strlen(entries[i][0]);
+        size_t valueLen = strlen(entries[i][1]);
+        env->envp[i] = dataPtr;
+        memcpy(dataPtr, entries[i][0], nameLen);
+        dataPtr[nameLen] = '=';
+        memcpy(dataPtr + nameLen + 1, entries[i][1], valueLen + 1);
+        dataPtr += nameLen + valueLen + 2;
+        free(entries[i]);
+    }
+    env->envp[env->size] = NULL;
+    free(entries);
+
+    env->dirty = false;
+    return env->envp;
+}
+
+int Environment_size(Environment *env) {
+    return env->size;
+}
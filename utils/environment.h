@@ -0,0 +1,26 @@
+#ifndef ALSH_ENVIRONMENT_
+#define ALSH_ENVIRONMENT_
+
+#include <stdbool.h>
+
+/**
+ * Hashed mirror of the environment variables
+ * Lookups do not scan environ, and the envp array handed to new
+ * processes is only rebuilt when a variable changed since it was last built
+*/
+typedef struct Environment Environment;
+
+Environment* Environment_create(char **envp);
+void Environment_free(Environment *env);
+
+//Returns the value of a variable, or NULL if it is not set
+char* Environment_get(Environment *env, char *name);
+void Environment_set(Environment *env, char *name, char *value);
+void Environment_unset(Environment *env, char *name);
+
+//Returns a NULL terminated array of name=value strings
+//Arrays replaced by a later change stay valid until the environment is freed
+char** Environment_envp(Environment *env);
+int Environment_size(Environment *env);
+
+#endif // ALSH_ENVIRONMENT_
@@ -0,0 +1,238 @@
+#include "eventloop.h"
+
+#include "ealloc.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+#ifdef __linux__
+
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+#define DEFAULT_WATCHES_CAPACITY 64
+
+typedef struct Watch {
+    bool used;
+    EventType type;
+    pid_t pid; //Child that the pidfd refers to
+} Watch;
+
+struct EventLoop {
+    int epollFd;
+    Watch *watches; //Indexed by the watched file descriptor
+    int watchesCapacity;
+};
+
+static int pidfdOpen(pid_t pid) {
+    return (int) syscall(SYS_pidfd_open, pid, 0);
+}
+
+EventLoop* EventLoop_create(void) {
+    int pidfd = pidfdOpen(getpid());
+    if (pidfd < 0) {
+        return NULL;
+    }
+    close(pidfd);
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) {
+        return NULL;
+    }
+
+    EventLoop *loop = emalloc(sizeof(EventLoop));
+    loop->epollFd = epollFd;
+    loop->watches = ecalloc(DEFAULT_WATCHES_CAPACITY, sizeof(Watch));
+    loop->watchesCapacity = DEFAULT_WATCHES_CAPACITY;
+    return loop;
+}
+
+void EventLoop_free(EventLoop *loop) {
+    for (int fd = 0; fd < loop->watchesCapacity; fd++) {
+        if (loop->watches[fd].used && loop->watches[fd].type != EVENT_FD) {
+            close(fd);
+        }
+    }
+    close(loop->epollFd);
+    free(loop->watches);
+    free(loop);
+}
+
+int EventLoop_fd(EventLoop *loop) {
+    return loop->epollFd;
+}
+
+static bool EventLoop_add(EventLoop *loop, int fd, EventType type, pid_t pid) {
+    if (fd >= loop->watchesCapacity) {
+        int newCapacity = loop->watchesCapacity;
+        while (fd >= newCapacity) {
+            newCapacity *= 2;
+        }
+        loop->watches = erealloc(loop->watches, sizeof(Watch) * (size_t) newCapacity);
+        for (int i = loop->watchesCapacity; i < newCapacity; i++) {
+            loop->watches[i].used = false;
+        }
+        loop->watchesCapacity = newCapacity;
+    }
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(loop->epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+        return false;
+    }
+    loop->watches[fd].used = true;
+    loop->watches[fd].type = type;
+    loop->watches[fd].pid = pid;
+    return true;
+}
+
+static void EventLoop_remove(EventLoop *loop, int fd) {
+    if (fd < 0 || fd >= loop->watchesCapacity || !loop->watches[fd].used) {
+        return;
+    }
+    epoll_ctl(loop->epollFd, EPOLL_CTL_DEL, fd, NULL);
+    if (loop->watches[fd].type != EVENT_FD) {
+        close(fd);
+    }
+    loop->watches[fd].used = false;
+}
+
+bool EventLoop_watchChild(EventLoop *loop, pid_t pid) {
+    int pidfd = pidfdOpen(pid);
+    if (pidfd < 0) {
+        return false;
+    }
+    if (!EventLoop_add(loop, pidfd, EVENT_CHILD, pid)) {
+        close(pidfd);
+        return false;
+    }
+    return true;
+}
+
+bool EventLoop_watchFd(EventLoop *loop, int fd) {
+    return EventLoop_add(loop, fd, EVENT_FD, 0);
+}
+
+void EventLoop_unwatchFd(EventLoop *loop, int fd) {
+    EventLoop_remove(loop, fd);
+}
+
+int EventLoop_addTimer(EventLoop *loop, long ms) {
+    int timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (timerFd < 0) {
+        return -1;
+    }
+    struct itimerspec spec = {0};
+    spec.it_value.tv_sec = ms / 1000;
+    spec.it_value.tv_nsec = (ms % 1000) * 1000000;
+    if (ms <= 0) {
+        spec.it_value.tv_sec = 0;
+        spec.it_value.tv_nsec = 1; //A zero it_value would disarm the timer
+    }
+    if (timerfd_settime(timerFd, 0, &spec, NULL) != 0 || !EventLoop_add(loop, timerFd, EVENT_TIMER, 0)) {
+        close(timerFd);
+        return -1;
+    }
+    return timerFd;
+}
+
+void EventLoop_removeTimer(EventLoop *loop, int id) {
+    if (id >= 0 && id < loop->watchesCapacity && loop->watches[id].type == EVENT_TIMER) {
+        EventLoop_remove(loop, id);
+    }
+}
+
+bool EventLoop_wait(EventLoop *loop, int timeoutMs, Event *event) {
+    while (true) {
+        struct epoll_event epollEvent;
+        int numEvents = epoll_wait(loop->epollFd, &epollEvent, 1, timeoutMs);
+        if (numEvents <= 0) {
+            return false;
+        }
+
+        int fd = epollEvent.data.fd;
+        Watch *watch = &loop->watches[fd];
+        event->type = watch->type;
+        event->id = fd;
+        switch (watch->type) {
+            case EVENT_CHILD: {
+                pid_t pid = watch->pid;
+                int status;
+                //The pidfd is readable once the child exits, but with threads it can be a moment before it can be reaped
+                pid_t waitStatus = wait4(pid, &status, WNOHANG, &event->usage);
+                if (waitStatus == 0) {
+                    waitStatus = wait4(pid, &status, 0, &event->usage);
+                }
+                EventLoop_remove(loop, fd);
+                if (waitStatus < 0) {
+                    continue;
+                }
+                event->pid = pid;
+                event->status = status;
+                return true;
+            }
+            case EVENT_TIMER:
+                EventLoop_remove(loop, fd);
+                return true;
+            case EVENT_FD:
+                return true;
+        }
+    }
+}
+
+#else
+
+EventLoop* EventLoop_create(void) {
+    return NULL;
+}
+
+void EventLoop_free(EventLoop *loop) {
+    (void) loop;
+}
+
+int EventLoop_fd(EventLoop *loop) {
+    (void) loop;
+    return -1;
+}
+
+bool EventLoop_watchChild(EventLoop *loop, pid_t pid) {
+    (void) loop;
+    (void) pid;
+    return false;
+}
+
+bool EventLoop_watchFd(EventLoop *loop, int fd) {
+    (void) loop;
+    (void) fd;
+    return false;
+}
+
+void EventLoop_unwatchFd(EventLoop *loop, int fd) {
+    (void) loop;
+    (void) fd;
+}
+
+int EventLoop_addTimer(EventLoop *loop, long ms) {
+    (void) loop;
+    (void) ms;
+    return -1;
+}
+
+void EventLoop_removeTimer(EventLoop *loop, int id) {
+    (void) loop;
+    (void) id;
+}
+
+bool EventLoop_wait(EventLoop *loop, int timeoutMs, Event *event) {
+    (void) loop;
+    (void) timeoutMs;
+    (void) event;
+    return false;
+}
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef ALSH_EVENT_LOOP_
+#define ALSH_EVENT_LOOP_
+
+#include <stdbool.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+
+/**
+ * Waits for several kinds of events at once with epoll: child processes
+ * exiting (through pidfds), one-shot timers (through timerfds) and file
+ * descriptors becoming readable
+ * The epoll file descriptor itself is readable whenever an event is pending,
+ * so the loop can be waited on by something else that polls file descriptors
+*/
+typedef struct EventLoop EventLoop;
+
+typedef enum EventType {
+    EVENT_CHILD, //A watched child process exited and was reaped
+    EVENT_TIMER, //A timer expired
+    EVENT_FD //A watched file descriptor is readable
+} EventType;
+
+typedef struct Event {
+    EventType type;
+    pid_t pid; //Child that exited
+    int status; //Status of the child as returned by waitpid
+    struct rusage usage; //Resources used by the child and the children it waited for
+    int id; //Timer that expired, or file descriptor that is readable
+} Event;
+
+//Returns NULL if epoll, pidfds or timerfds aren't supported
+EventLoop* EventLoop_create(void);
+void EventLoop_free(EventLoop *loop);
+int EventLoop_fd(EventLoop *loop);
+
+//Returns false if the child can't be watched, in which case it must be waited for some other way
+bool EventLoop_watchChild(EventLoop *loop, pid_t pid);
+bool EventLoop_watchFd(EventLoop *loop, int fd);
+void EventLoop_unwatchFd(EventLoop *loop, int fd);
+
+//Returns the id of a timer that expires once after ms milliseconds, or -1 on failure
+int EventLoop_addTimer(EventLoop *loop, long ms);
+void EventLoop_removeTimer(EventLoop *loop, int id);
+
+/**
+ * Waits at most timeoutMs milliseconds for an event, or forever if timeoutMs is negative
+ * Children that were reaped somewhere else are forgotten without an event
+ *
+ * Returns false if the timeout expired or a signal interrupted the wait
+*/
+bool EventLoop_wait(EventLoop *loop, int timeoutMs, Event *event);
+
+#endif // ALSH_EVENT_LOOP_
@@ -0,0 +1,496 @@
+#include "pathglob.h"
+
+#include "charlist.h"
+#include "ealloc.h"
+#include "utils.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#define DIR_BUFFER_SIZE 65536
+#define DEFAULT_MATCHES_CAPACITY 16
+
+typedef enum {
+    GLOB_LITERAL, //Matches literal text
+    GLOB_ANY_CHAR, //?
+    GLOB_ANY_STRING, //*
+    GLOB_CLASS //[...]
+} GlobOpType;
+
+typedef struct {
+    GlobOpType type;
+    size_t literalStart; //Where the text of a literal starts in literals
+    size_t literalLen;
+    unsigned char charClass[32]; //Bitmap of the characters a class matches
+} GlobOp;
+
+struct GlobPattern {
+    GlobOp *ops;
+    int numOps;
+    char *literals; //Unescaped text of all literals
+    bool matchesDotFiles; //Does the pattern start with a literal dot?
+};
+
+static GlobOp* GlobPattern_addOp(GlobPattern *pattern, GlobOpType type, int *capacity) {
+    if (pattern->numOps == *capacity) {
+        *capacity *= 2;
+        pattern->ops = erealloc(pattern->ops, sizeof(GlobOp) * (size_t) *capacity);
+    }
+    GlobOp *op = &pattern->ops[pattern->numOps++];
+    op->type = type;
+    op->literalStart = 0;
+    op->literalLen = 0;
+    return op;
+}
+
+//Parses the class starting at the [ in patternPtr into op and returns a pointer past its ], or NULL if it isn't closed
+static char* GlobPattern_parseClass(char *patternPtr, GlobOp *op) {
+    char *classPtr = patternPtr + 1;
+    bool negate = *classPtr == '!' || *classPtr == '^';
+    if (negate) {
+        classPtr++;
+    }
+    memset(op->charClass, 0, sizeof(op->charClass));
+
+    //A ] right after the opening bracket is part of the class
+    bool first = true;
+    while (*classPtr && (first || *classPtr != ']')) {
+        unsigned char from = (unsigned char) *classPtr;
+        if (from == '\\' && classPtr[1]) {
+            from = (unsigned char) *++classPtr;
+        }
+        unsigned char to = from;
+        if (classPtr[1] == '-' && classPtr[2] && classPtr[2] != ']') {
+            classPtr += 2;
+            if (*classPtr == '\\' && classPtr[1]) {
+                classPtr++;
+            }
+            to = (unsigned char) *classPtr;
+        }
+        for (unsigned int c = from; c <= to; c++) {
+            op->charClass[c / 8] |= (unsigned char) (1 << (c % 8));
+        }
+        classPtr++;
+        first = false;
+    }
+    if (!*classPtr) {
+        return NULL;
+    }
+
+    if (negate) {
+        for (size_t i = 0; i < sizeof(op->charClass); i++) {
+            op->charClass[i] = (unsigned char) ~op->charClass[i];
+        }
+    }
+    //Never match the NUL at the end of a name
+    op->charClass[0] &= (unsigned char) ~1;
+    return classPtr + 1;
+}
+
+GlobPattern* GlobPattern_compile(char *pattern) {
+    GlobPattern *compiled = emalloc(sizeof(GlobPattern));
+    int opsCapacity = 8;
+    compiled->ops = emalloc(sizeof(GlobOp) * (size_t) opsCapacity);
+    compiled->numOps = 0;
+    compiled->matchesDotFiles = *pattern == '.';
+    CharList *literals = CharList_create();
+
+    char *patternPtr = pattern;
+    while (*patternPtr) {
+        GlobOp *lastOp = compiled->numOps > 0 ? &compiled->ops[compiled->numOps - 1] : NULL;
+        if (*patternPtr == '*') {
+            //Consecutive stars match the same as one
+            if (lastOp == NULL || lastOp->type != GLOB_ANY_STRING) {
+                GlobPattern_addOp(compiled, GLOB_ANY_STRING, &opsCapacity);
+            }
+            patternPtr++;
+            continue;
+        } else if (*patternPtr == '?') {
+            GlobPattern_addOp(compiled, GLOB_ANY_CHAR, &opsCapacity);
+            patternPtr++;
+            continue;
+        } else if (*patternPtr == '[') {
+            GlobOp classOp;
+            char *classEnd = GlobPattern_parseClass(patternPtr, &classOp);
+            if (classEnd != NULL) {
+                GlobOp *op = GlobPattern_addOp(compiled, GLOB_CLASS, &opsCapacity);
+                memcpy(op->charClass, classOp.charClass, sizeof(op->charClass));
+                patternPtr = classEnd;
+                continue;
+            }
+        }
+
+        if (*patternPtr == '\\' && patternPtr[1]) {
+            patternPtr++;
+        }
+        if (lastOp == NULL || lastOp->type != GLOB_LITERAL) {
+            lastOp = GlobPattern_addOp(compiled, GLOB_LITERAL, &opsCapacity);
+            lastOp->literalStart = (size_t) literals->size;
+        }
+        CharList_add(literals, *patternPtr++);
+        lastOp->literalLen++;
+    }
+
+    compiled->literals = CharList_toStr(literals);
+    CharList_free(literals);
+    return compiled;
+}
+
+void GlobPattern_free(GlobPattern *pattern) {
+    free(pattern->ops);
+    free(pattern->literals);
+    free(pattern);
+}
+
+bool GlobPattern_matches(GlobPattern *pattern, char *name) {
+    if (*name == '.' && !pattern->matchesDotFiles) {
+        return false;
+    }
+
+    //Most patterns end with literal text like an extension, which rejects most names right away
+    size_t nameLen = strlen(name);
+    if (pattern->numOps > 0 && pattern->ops[pattern->numOps - 1].type == GLOB_LITERAL) {
+        GlobOp *lastOp = &pattern->ops[pattern->numOps - 1];
+        if (nameLen < lastOp->literalLen
+            || memcmp(name + nameLen - lastOp->literalLen, pattern->literals + lastOp->literalStart, lastOp->literalLen) != 0
+        ) {
+            return false;
+        }
+    }
+
+    //On a mismatch, the last * takes one more character and matching resumes after it
+    int opIndex = 0;
+    char *namePtr = name;
+    int starOpIndex = -1;
+    char *starNamePtr = NULL;
+    while (*namePtr || opIndex < pattern->numOps) {
+        if (opIndex < pattern->numOps) {
+            GlobOp *op = &pattern->ops[opIndex];
+            unsigned char c = (unsigned char) *namePtr;
+            switch (op->type) {
+                case GLOB_ANY_STRING:
+                    starOpIndex = opIndex++;
+                    starNamePtr = namePtr;
+                    continue;
+                case GLOB_LITERAL:
+                    if (strncmp(namePtr, pattern->literals + op->literalStart, op->literalLen) == 0) {
+                        namePtr += op->literalLen;
+                        opIndex++;
+                        continue;
+                    }
+                    break;
+                case GLOB_ANY_CHAR:
+                    if (c) {
+                        namePtr++;
+                        opIndex++;
+                        continue;
+                    }
+                    break;
+                case GLOB_CLASS:
+                    if (op->charClass[c / 8] & (1 << (c % 8))) {
+                        namePtr++;
+                        opIndex++;
+                        continue;
+                    }
+                    break;
+            }
+        }
+        if (starOpIndex >= 0 && *starNamePtr) {
+            namePtr = ++starNamePtr;
+            opIndex = starOpIndex + 1;
+            continue;
+        }
+        return false;
+    }
+    return true;
+}
+
+bool PathGlob_hasWildcards(char *word) {
+    for (char *wordPtr = word; *wordPtr; wordPtr++) {
+        if (*wordPtr == '\\' && wordPtr[1]) {
+            wordPtr++;
+        } else if (*wordPtr == '*' || *wordPtr == '?' || (*wordPtr == '[' && wordPtr[1] && strchr(wordPtr + 2, ']') != NULL)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Reads the entries of a directory in large batches
+ * On Linux, getdents64 fills a buffer with many entries per system call, including their
+ * types, so most entries never need to be stat'ed
+*/
+typedef struct {
+#ifdef __linux__
+    int fd;
+    char *buffer;
+    long size;
+    long pos;
+#else
+    DIR *dir;
+#endif
+} DirReader;
+
+#ifdef __linux__
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+#endif
+
+static bool DirReader_open(DirReader *reader, int fd) {
+#ifdef __linux__
+    //The directory may have been read before
+    if (lseek(fd, 0, SEEK_SET) < 0) {
+        return false;
+    }
+    reader->fd = fd;
+    reader->buffer = emalloc(DIR_BUFFER_SIZE);
+    reader->size = 0;
+    reader->pos = 0;
+    return true;
+#else
+    int dupFd = dup(fd);
+    reader->dir = dupFd >= 0 ? fdopendir(dupFd) : NULL;
+    if (reader->dir == NULL) {
+        if (dupFd >= 0) {
+            close(dupFd);
+        }
+        return false;
+    }
+    //The duplicate shares its offset with fd, which may have been read before
+    rewinddir(reader->dir);
+    return true;
+#endif
+}
+
+//Returns the name of the next entry and sets type to its d_type, or returns NULL at the end
+static char* DirReader_next(DirReader *reader, unsigned char *type) {
+#ifdef __linux__
+    if (reader->pos >= reader->size) {
+        reader->size = syscall(SYS_getdents64, reader->fd, reader->buffer, DIR_BUFFER_SIZE);
+        reader->pos = 0;
+        if (reader->size <= 0) {
+            return NULL;
+        }
+    }
+    struct linux_dirent64 *entry = (struct linux_dirent64*) (reader->buffer + reader->pos);
+    reader->pos += entry->d_reclen;
+    *type = entry->d_type;
+    return entry->d_name;
+#else
+    struct dirent *entry = readdir(reader->dir);
+    if (entry == NULL) {
+        return NULL;
+    }
+    *type = entry->d_type;
+    return entry->d_name;
+#endif
+}
+
+static void DirReader_close(DirReader *reader) {
+#ifdef __linux__
+    free(reader->buffer);
+#else
+    closedir(reader->dir);
+#endif
+}
+
+typedef struct {
+    char **segments; //Components of the pattern
+    GlobPattern **patterns; //Compiled components, or NULL for components without wildcards
+    int numSegments;
+    CharList *path; //Path of the directory being read, ending with a slash unless empty
+    char **matches;
+    int numMatches;
+    int matchesCapacity;
+} GlobWalk;
+
+static void GlobWalk_addMatch(GlobWalk *walk, char *name) {
+    if (walk->numMatches == walk->matchesCapacity) {
+        walk->matchesCapacity = walk->matchesCapacity > 0 ? walk->matchesCapacity * 2 : DEFAULT_MATCHES_CAPACITY;
+        walk->matches = erealloc(walk->matches, sizeof(char*) * (size_t) walk->matchesCapacity);
+    }
+    size_t nameLen = strlen(name);
+    char *match = emalloc(sizeof(char) * ((size_t) walk->path->size + nameLen + 1));
+    memcpy(match, walk->path->data, (size_t) walk->path->size);
+    memcpy(match + walk->path->size, name, nameLen + 1);
+    walk->matches[walk->numMatches++] = match;
+}
+
+//Returns true if the entry name of dirfd with the given d_type is a directory
+static bool GlobWalk_isDir(int dirfd, char *name, unsigned char type, bool followLinks) {
+    if (type == DT_DIR) {
+        return true;
+    } else if (type != DT_UNKNOWN && (type != DT_LNK || !followLinks)) {
+        return false;
+    }
+    struct stat st;
+    return fstatat(dirfd, name, &st, followLinks ? 0 : AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+}
+
+static void GlobWalk_walk(GlobWalk *walk, int dirfd, int index);
+
+//Appends name to the path and matches the remaining segments starting at index in that directory
+static void GlobWalk_descend(GlobWalk *walk, int dirfd, char *name, int index) {
+    int fd = openat(dirfd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    int pathSize = walk->path->size;
+    CharList_addStr(walk->path, name);
+    CharList_add(walk->path, '/');
+    GlobWalk_walk(walk, fd, index);
+    walk->path->size = pathSize;
+    walk->path->data[pathSize] = '\0';
+    close(fd);
+}
+
+//Matches the segments starting at index against the directory dirfd
+static void GlobWalk_walk(GlobWalk *walk, int dirfd, int index) {
+    char *segment = walk->segments[index];
+    GlobPattern *pattern = walk->patterns[index];
+    bool isLast = index == walk->numSegments - 1;
+
+    if (!*segment) {
+        //The pattern ends with a slash, so only the directory itself matches
+        GlobWalk_addMatch(walk, "");
+        return;
+    } else if (pattern == NULL) {
+        struct stat st;
+        if (!isLast) {
+            GlobWalk_descend(walk, dirfd, segment, index + 1);
+        } else if (fstatat(dirfd, segment, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+            GlobWalk_addMatch(walk, segment);
+        }
+        return;
+    }
+
+    bool isRecursive = strcmp(segment, "**") == 0;
+    if (isRecursive && !isLast) {
+        GlobWalk_walk(walk, dirfd, index + 1);
+    }
+
+    DirReader reader;
+    if (!DirReader_open(&reader, dirfd)) {
+        return;
+    }
+    char *name;
+    unsigned char type;
+    while ((name = DirReader_next(&reader, &type)) != NULL) {
+        if (*name == '.' && (!name[1] || (name[1] == '.' && !name[2]))) {
+            continue;
+        }
+        if (isRecursive) {
+            //Symbolic links are not followed so that cycles can't make the walk endless
+            if (*name == '.') {
+                continue;
+            }
+            if (isLast) {
+                GlobWalk_addMatch(walk, name);
+            }
+            if (GlobWalk_isDir(dirfd, name, type, false)) {
+                GlobWalk_descend(walk, dirfd, name, index);
+            }
+        } else if (GlobPattern_matches(pattern, name)) {
+            if (isLast) {
+                GlobWalk_addMatch(walk, name);
+            } else if (GlobWalk_isDir(dirfd, name, type, true)) {
+                GlobWalk_descend(walk, dirfd, name, index + 1);
+            }
+        }
+    }
+    DirReader_close(&reader);
+}
+
+char** PathGlob_expand(char *pattern, int *numMatches) {
+    SET_FUNCTION_STATUS(numMatches, 0);
+    bool isAbsolute = *pattern == '/';
+    int dirfd = open(isAbsolute ? "/" : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0) {
+        return NULL;
+    }
+
+    //Split the pattern at its slashes, keeping an empty last segment if it ends with one
+    char *patternDup = strdup(pattern);
+    int segmentsCapacity = 8;
+    GlobWalk walk;
+    walk.segments = emalloc(sizeof(char*) * (size_t) segmentsCapacity);
+    walk.numSegments = 0;
+    char *segmentStart = patternDup + isAbsolute;
+    while (true) {
+        char *slash = strchr(segmentStart, '/');
+        if (slash != NULL) {
+            *slash = '\0';
+        }
+        if (*segmentStart || slash == NULL) {
+            if (walk.numSegments == segmentsCapacity) {
+                segmentsCapacity *= 2;
+                walk.segments = erealloc(walk.segments, sizeof(char*) * (size_t) segmentsCapacity);
+            }
+            walk.segments[walk.numSegments++] = segmentStart;
+        }
+        if (slash == NULL) {
+            break;
+        }
+        segmentStart = slash + 1;
+    }
+
+    //Each segment with wildcards is compiled once, no matter how many directories it is matched in
+    walk.patterns = emalloc(sizeof(GlobPattern*) * (size_t) walk.numSegments);
+    for (int i = 0; i < walk.numSegments; i++) {
+        char *segment = walk.segments[i];
+        if (PathGlob_hasWildcards(segment)) {
+            walk.patterns[i] = GlobPattern_compile(segment);
+            continue;
+        }
+        walk.patterns[i] = NULL;
+        char *unescaped = segment;
+        for (char *segmentPtr = segment; *segmentPtr; segmentPtr++) {
+            if (*segmentPtr == '\\' && segmentPtr[1]) {
+                segmentPtr++;
+            }
+            *unescaped++ = *segmentPtr;
+        }
+        *unescaped = '\0';
+    }
+
+    walk.path = CharList_create();
+    if (isAbsolute) {
+        CharList_add(walk.path, '/');
+    }
+    walk.matches = NULL;
+    walk.numMatches = 0;
+    walk.matchesCapacity = 0;
+    GlobWalk_walk(&walk, dirfd, 0);
+    close(dirfd);
+
+    for (int i = 0; i < walk.numSegments; i++) {
+        if (walk.patterns[i] != NULL) {
+            GlobPattern_free(walk.patterns[i]);
+        }
+    }
+    free(walk.patterns);
+    free(walk.segments);
+    free(patternDup);
+    CharList_free(walk.path);
+
+    if (walk.numMatches == 0) {
+        return NULL;
+    }
+    qsort(walk.matches, (size_t) walk.numMatches, sizeof(char*), compareStrings);
+    SET_FUNCTION_STATUS(numMatches, walk.numMatches);
+    return walk.matches;
+}
@@ -0,0 +1,27 @@
+#ifndef ALSH_PATH_GLOB_
+#define ALSH_PATH_GLOB_
+
+#include <stdbool.h>
+
+/**
+ * Compiled wildcard pattern for a single file name
+ * Supports *, ?, [abc], [a-z] and [!abc] or [^abc]; a backslash makes the next character literal
+ * Names that start with a dot are only matched if the pattern starts with one too
+*/
+typedef struct GlobPattern GlobPattern;
+
+GlobPattern* GlobPattern_compile(char *pattern);
+void GlobPattern_free(GlobPattern *pattern);
+bool GlobPattern_matches(GlobPattern *pattern, char *name);
+
+//Returns true if word contains a wildcard that isn't escaped with a backslash
+bool PathGlob_hasWildcards(char *word);
+
+/**
+ * Returns the paths that match pattern in sorted order and sets numMatches,
+ * or NULL if nothing matches; the array and each path in it must be freed
+ * A ** path component matches any number of directories, including none
+*/
+char** PathGlob_expand(char *pattern, int *numMatches);
+
+#endif // ALSH_PATH_GLOB_
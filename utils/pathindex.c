@@ -0,0 +1,168 @@
+#include "pathindex.h"
+
+#include "ealloc.h"
+#include "stringhashmap.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PATH_INDEX_BUCKETS 4096
+
+struct PathIndex {
+    StringHashMap *commands; //Maps command names to their full paths
+    char *path; //Value of PATH the index was built from
+    char **dirs; //Directories in PATH
+    struct timespec *dirMtimes; //Modification times of the directories when indexed
+    int numDirs;
+    time_t lastChecked; //Last time the directories were checked for changes
+};
+
+PathIndex* PathIndex_create(void) {
+    PathIndex *index = emalloc(sizeof(PathIndex));
+    index->commands = NULL;
+    index->path = NULL;
+    index->dirs = NULL;
+    index->dirMtimes = NULL;
+    index->numDirs = 0;
+    index->lastChecked = 0;
+    return index;
+}
+
+static void PathIndex_clear(PathIndex *index) {
+    if (index->commands != NULL) {
+        StringHashMap_free(index->commands);
+        index->commands = NULL;
+    }
+    for (int i = 0; i < index->numDirs; i++) {
+        free(index->dirs[i]);
+    }
+    free(index->dirs);
+    free(index->dirMtimes);
+    free(index->path);
+    index->dirs = NULL;
+    index->dirMtimes = NULL;
+    index->path = NULL;
+    index->numDirs = 0;
+}
+
+void PathIndex_free(PathIndex *index) {
+    PathIndex_clear(index);
+    free(index);
+}
+
+void PathIndex_invalidate(PathIndex *index) {
+    PathIndex_clear(index);
+}
+
+static void PathIndex_addDir(PathIndex *index, char *dir, struct timespec *mtime) {
+    int dirfd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (dirfd < 0) return;
+    DIR *dp = fdopendir(dirfd);
+    if (dp == NULL) {
+        close(dirfd);
+        return;
+    }
+
+    struct stat statbuf;
+    if (fstat(dirfd, &statbuf) == 0) {
+        *mtime = statbuf.st_mtim;
+    }
+
+    size_t dirLen = strlen(dir);
+    struct dirent *entry;
+    while ((entry = readdir(dp)) != NULL) {
+        char *name = entry->d_name;
+        if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2]))) continue;
+
+        //Earlier directories in PATH take precedence
+        if (StringHashMap_get(index->commands, name) != NULL) continue;
+
+        bool isCandidate;
+#ifdef DT_UNKNOWN
+        if (entry->d_type != DT_UNKNOWN && entry->d_type != DT_LNK) {
+            isCandidate = entry->d_type == DT_REG;
+        } else
+#endif
+        {
+            isCandidate = fstatat(dirfd, name, &statbuf, 0) == 0 && S_ISREG(statbuf.st_mode);
+        }
+        if (!isCandidate || faccessat(dirfd, name, X_OK, 0) != 0) continue;
+
+        size_t nameLen = strlen(name);
+        char *fullPath = emalloc(dirLen + 1 + nameLen + 1);
+        memcpy(fullPath, dir, dirLen);
+        fullPath[dirLen] = '/';
+        memcpy(fullPath + dirLen + 1, name, nameLen + 1);
+        StringHashMap_put(index->commands, strdup(name), true, fullPath, true);
+    }
+    closedir(dp);
+}
+
+static void PathIndex_build(PathIndex *index, char *path) {
+    PathIndex_clear(index);
+    index->commands = StringHashMap_createSize(PATH_INDEX_BUCKETS);
+    index->path = strdup(path);
+
+    int capacity = 1;
+    for (char *p = path; *p; p++) {
+        if (*p == ':') capacity++;
+    }
+    index->dirs = emalloc(sizeof(char*) * (size_t) capacity);
+    index->dirMtimes = ecalloc((size_t) capacity, sizeof(struct timespec));
+
+    //An empty entry, including a leading or trailing ':', means the current directory like it does for execvp
+    char *start = path;
+    bool hasNext = *path != '\0';
+    while (hasNext) {
+        char *end = strchr(start, ':');
+        size_t dirLen = end != NULL ? (size_t) (end - start) : strlen(start);
+        char *dir = dirLen > 0 ? strndup(start, dirLen) : strdup(".");
+        int i = index->numDirs++;
+        index->dirs[i] = dir;
+        PathIndex_addDir(index, dir, &index->dirMtimes[i]);
+        hasNext = end != NULL;
+        if (hasNext) start = end + 1;
+    }
+    index->lastChecked = time(NULL);
+}
+
+static bool PathIndex_isStale(PathIndex *index, char *path) {
+    if (index->commands == NULL || strcmp(index->path, path) != 0) {
+        return true;
+    }
+    time_t now = time(NULL);
+    if (now == index->lastChecked) {
+        return false;
+    }
+    index->lastChecked = now;
+    for (int i = 0; i < index->numDirs; i++) {
+        struct stat statbuf;
+        struct timespec mtime = {0, 0};
+        if (stat(index->dirs[i], &statbuf) == 0) {
+            mtime = statbuf.st_mtim;
+        }
+        if (mtime.tv_sec != index->dirMtimes[i].tv_sec || mtime.tv_nsec != index->dirMtimes[i].tv_nsec) {
+            return true;
+        }
+    }
+    return false;
+}
+
+char* PathIndex_get(PathIndex *index, char *command) {
+    char *path = getenv("PATH");
+    if (path == NULL) {
+        path = "";
+    }
+    if (PathIndex_isStale(index, path)) {
+        PathIndex_build(index, path);
+    }
+    return StringHashMap_get(index->commands, command);
+}
+
+bool PathIndex_contains(PathIndex *index, char *command) {
+    return PathIndex_get(index, command) != NULL;
+}
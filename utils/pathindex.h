@@ -0,0 +1,23 @@
+#ifndef ALSH_PATH_INDEX_
+#define ALSH_PATH_INDEX_
+
+#include <stdbool.h>
+
+/**
+ * Index of the commands in the directories of the PATH environment variable
+ * The index is rebuilt lazily when PATH changes or when one of its
+ * directories is modified, which is checked at most once per second
+*/
+typedef struct PathIndex PathIndex;
+
+PathIndex* PathIndex_create(void);
+void PathIndex_free(PathIndex *index);
+
+//Returns the full path of a command in PATH, or NULL if it is not found
+char* PathIndex_get(PathIndex *index, char *command);
+bool PathIndex_contains(PathIndex *index, char *command);
+
+//Forces the index to be rebuilt on the next lookup
+void PathIndex_invalidate(PathIndex *index);
+
+#endif // ALSH_PATH_INDEX_
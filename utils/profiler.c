@@ -0,0 +1,188 @@
+#include "profiler.h"
+
+#include "ealloc.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PROFILER_DEFAULT_CAPACITY 64
+#define PROFILER_EXIT_MAX_ROWS 30
+
+typedef struct ProfileEntry {
+    ProfileKind kind;
+    char *name; //NULL if the slot is empty
+    char *detail;
+    long calls;
+    double total;
+    double self;
+} ProfileEntry;
+
+typedef struct ProfileFrame {
+    double start;
+    double childTime; //Time of the entries profiled inside this one
+} ProfileFrame;
+
+bool profileEnabled = false;
+
+static ProfileEntry *entries = NULL; //Hash table with linear probing
+static int entriesCapacity = 0;
+static int numEntries = 0;
+static ProfileFrame *frames = NULL;
+static int framesCapacity = 0;
+static int numFrames = 0;
+static pid_t ownerPid = 0; //Process that prints the entries at exit
+
+static double now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double) time.tv_sec + (double) time.tv_nsec / 1e9;
+}
+
+static unsigned int hash(ProfileKind kind, const char *name) {
+    unsigned int result = 2166136261u ^ (unsigned int) kind;
+    for (const unsigned char *c = (const unsigned char *) name; *c; c++) {
+        result = (result ^ *c) * 16777619u;
+    }
+    return result;
+}
+
+static ProfileEntry* findEntry(ProfileEntry *table, int capacity, ProfileKind kind, const char *name) {
+    unsigned int index = hash(kind, name) & (unsigned int) (capacity - 1);
+    while (table[index].name != NULL
+        && (table[index].kind != kind || strcmp(table[index].name, name) != 0)) {
+        index = (index + 1) & (unsigned int) (capacity - 1);
+    }
+    return &table[index];
+}
+
+static void growEntries(void) {
+    int newCapacity = entriesCapacity > 0 ? entriesCapacity * 2 : PROFILER_DEFAULT_CAPACITY;
+    ProfileEntry *newEntries = ecalloc((size_t) newCapacity, sizeof(ProfileEntry));
+    for (int i = 0; i < entriesCapacity; i++) {
+        if (entries[i].name != NULL) {
+            *findEntry(newEntries, newCapacity, entries[i].kind, entries[i].name) = entries[i];
+        }
+    }
+    free(entries);
+    entries = newEntries;
+    entriesCapacity = newCapacity;
+}
+
+static void printAtExit(void) {
+    if (getpid() == ownerPid && numEntries > 0) {
+        Profiler_print(stderr, PROFILER_EXIT_MAX_ROWS);
+    }
+    Profiler_clear();
+    free(entries);
+    free(frames);
+}
+
+void Profiler_start(void) {
+    if (ownerPid == 0) {
+        ownerPid = getpid();
+        atexit(printAtExit);
+    }
+    profileEnabled = true;
+}
+
+void Profiler_stop(void) {
+    profileEnabled = false;
+}
+
+void Profiler_clear(void) {
+    for (int i = 0; i < entriesCapacity; i++) {
+        free(entries[i].name);
+        free(entries[i].detail);
+        entries[i].name = NULL;
+    }
+    numEntries = 0;
+}
+
+void Profiler_begin(void) {
+    if (numFrames == framesCapacity) {
+        framesCapacity = framesCapacity > 0 ? framesCapacity * 2 : 16;
+        frames = erealloc(frames, sizeof(ProfileFrame) * (size_t) framesCapacity);
+    }
+    frames[numFrames].start = now();
+    frames[numFrames].childTime = 0;
+    numFrames++;
+}
+
+static void addTime(ProfileKind kind, const char *name, const char *detail, double total, double self) {
+    //The table is kept at most half full
+    if ((numEntries + 1) * 2 > entriesCapacity) {
+        growEntries();
+    }
+    ProfileEntry *entry = findEntry(entries, entriesCapacity, kind, name);
+    if (entry->name == NULL) {
+        entry->kind = kind;
+        entry->name = strdup(name);
+        entry->detail = detail != NULL ? strdup(detail) : NULL;
+        entry->calls = 0;
+        entry->total = 0;
+        entry->self = 0;
+        numEntries++;
+    }
+    entry->calls++;
+    entry->total += total;
+    entry->self += self;
+}
+
+void Profiler_end(ProfileKind kind, const char *name, const char *detail) {
+    if (numFrames == 0) {
+        return;
+    }
+    ProfileFrame *frame = &frames[--numFrames];
+    if (name == NULL) {
+        return;
+    }
+    double total = now() - frame->start;
+    if (numFrames > 0) {
+        frames[numFrames - 1].childTime += total;
+    }
+    addTime(kind, name, detail, total, total - frame->childTime);
+}
+
+void Profiler_add(ProfileKind kind, const char *name, const char *detail, double seconds) {
+    addTime(kind, name, detail, seconds, seconds);
+}
+
+static int compareEntries(const void *a, const void *b) {
+    const ProfileEntry *entryA = *(const ProfileEntry* const*) a;
+    const ProfileEntry *entryB = *(const ProfileEntry* const*) b;
+    if (entryA->self != entryB->self) {
+        return entryA->self < entryB->self ? 1 : -1;
+    }
+    if (entryA->total != entryB->total) {
+        return entryA->total < entryB->total ? 1 : -1;
+    }
+    return strcmp(entryA->name, entryB->name);
+}
+
+void Profiler_print(FILE *stream, int maxRows) {
+    const char *kindNames[] = {"line", "builtin", "command"};
+    ProfileEntry **sorted = emalloc(sizeof(ProfileEntry*) * (size_t) (numEntries > 0 ? numEntries : 1));
+    int numSorted = 0;
+    for (int i = 0; i < entriesCapacity; i++) {
+        if (entries[i].name != NULL) {
+            sorted[numSorted++] = &entries[i];
+        }
+    }
+    qsort(sorted, (size_t) numSorted, sizeof(ProfileEntry*), compareEntries);
+
+    int numRows = maxRows > 0 && maxRows < numSorted ? maxRows : numSorted;
+    fprintf(stream, "%-8s %8s %10s %10s  %s\n", "kind", "calls", "self(s)", "total(s)", "name");
+    for (int i = 0; i < numRows; i++) {
+        ProfileEntry *entry = sorted[i];
+        fprintf(stream, "%-8s %8ld %10.6f %10.6f  %s", kindNames[entry->kind], entry->calls, entry->self, entry->total, entry->name);
+        if (entry->detail != NULL) {
+            fprintf(stream, "  %s", entry->detail);
+        }
+        fputc('\n', stream);
+    }
+    if (numRows < numSorted) {
+        fprintf(stream, "(%d more)\n", numSorted - numRows);
+    }
+    free(sorted);
+}
@@ -0,0 +1,44 @@
+#ifndef ALSH_PROFILER_
+#define ALSH_PROFILER_
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/**
+ * Adds up the time spent in each line of a script, each builtin command and each external command,
+ * along with how many times each ran
+ * Total time includes everything that ran inside an entry, like the commands of a line,
+ * and self time leaves out the entries that were profiled inside it
+*/
+
+typedef enum ProfileKind {
+    PROFILE_LINE,
+    PROFILE_BUILTIN,
+    PROFILE_COMMAND
+} ProfileKind;
+
+extern bool profileEnabled; //Is the profiler collecting times?
+
+//Turns on the profiler; the first time, the collected times are also set to be printed to stderr at exit
+void Profiler_start(void);
+void Profiler_stop(void);
+void Profiler_clear(void);
+
+/**
+ * Profiler_begin starts timing an entry, and Profiler_end stops timing the most recent one and adds
+ * its time to the entry with the given kind and name, keeping detail as a description of it
+ * A NULL name drops the time instead, like when a command turned out not to be a builtin
+*/
+void Profiler_begin(void);
+void Profiler_end(ProfileKind kind, const char *name, const char *detail);
+
+/**
+ * Adds a time that was measured elsewhere, like in the child process of a pipeline stage
+ * It ran alongside the entry being timed, so it isn't left out of that entry's self time
+*/
+void Profiler_add(ProfileKind kind, const char *name, const char *detail, double seconds);
+
+//Prints the entries sorted by self time, at most maxRows of them or all of them if maxRows is 0
+void Profiler_print(FILE *stream, int maxRows);
+
+#endif // ALSH_PROFILER_
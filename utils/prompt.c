@@ -0,0 +1,236 @@
+#include "prompt.h"
+
+#include "charlist.h"
+#include "ealloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define HOST_NAME_BUFFER_SIZE 256
+
+typedef enum {
+    SEGMENT_LITERAL,
+    SEGMENT_CWD,
+    SEGMENT_CWD_BASENAME,
+    SEGMENT_EXIT_STATUS,
+    SEGMENT_NUM_JOBS
+} SegmentType;
+
+typedef struct Segment {
+    SegmentType type;
+    CharList *text; //Rendered text of the segment
+    unsigned long key; //Input the text was rendered from
+    bool rendered;
+} Segment;
+
+struct Prompt {
+    char *template;
+    Segment *segments;
+    int numSegments;
+    CharList *output;
+    bool outputValid;
+};
+
+/**
+ * The line editor treats '[' as the start of a style tag, so '[' and '\\'
+ * are escaped unless the '[' starts an ANSI escape sequence
+*/
+void Prompt_addChr(CharList *text, char chr) {
+    if (chr == '\\' || (chr == '[' && (text->size == 0 || text->data[text->size - 1] != '\033'))) {
+        CharList_add(text, '\\');
+    }
+    CharList_add(text, chr);
+}
+
+void Prompt_addStr(CharList *text, char *str) {
+    while (*str) {
+        Prompt_addChr(text, *str++);
+    }
+}
+
+Segment* Prompt_addSegment(Prompt *prompt, SegmentType type) {
+    //Consecutive literals are merged into one segment
+    if (type == SEGMENT_LITERAL && prompt->numSegments > 0
+        && prompt->segments[prompt->numSegments - 1].type == SEGMENT_LITERAL
+    ) {
+        return &prompt->segments[prompt->numSegments - 1];
+    }
+    prompt->segments = erealloc(prompt->segments, sizeof(Segment) * (size_t) (prompt->numSegments + 1));
+    Segment *segment = &prompt->segments[prompt->numSegments++];
+    segment->type = type;
+    segment->text = CharList_create();
+    segment->key = 0;
+    segment->rendered = type == SEGMENT_LITERAL;
+    return segment;
+}
+
+Prompt* Prompt_create(char *template, PromptInfo *info) {
+    Prompt *prompt = emalloc(sizeof(Prompt));
+    prompt->template = strdup(template);
+    prompt->segments = NULL;
+    prompt->numSegments = 0;
+    prompt->output = CharList_create();
+    prompt->outputValid = false;
+
+    for (char *chr = template; *chr; chr++) {
+        if (*chr != '\\' || !chr[1]) {
+            Prompt_addChr(Prompt_addSegment(prompt, SEGMENT_LITERAL)->text, *chr);
+            continue;
+        }
+
+        switch (*++chr) {
+            case 's':
+                Prompt_addStr(Prompt_addSegment(prompt, SEGMENT_LITERAL)->text, info->shellName);
+                break;
+            case 'u':
+                Prompt_addStr(Prompt_addSegment(prompt, SEGMENT_LITERAL)->text, info->userName);
+                break;
+            case 'h': {
+                char hostName[HOST_NAME_BUFFER_SIZE];
+                if (gethostname(hostName, HOST_NAME_BUFFER_SIZE) != 0) {
+                    hostName[0] = '\0';
+                }
+                hostName[HOST_NAME_BUFFER_SIZE - 1] = '\0';
+                char *dot = strchr(hostName, '.');
+                if (dot != NULL) {
+                    *dot = '\0';
+                }
+                Prompt_addStr(Prompt_addSegment(prompt, SEGMENT_LITERAL)->text, hostName);
+                break;
+            }
+            case '$':
+                Prompt_addChr(Prompt_addSegment(prompt, SEGMENT_LITERAL)->text, info->isRoot ? '#' : '$');
+                break;
+            case 'e':
+                Prompt_addChr(Prompt_addSegment(prompt, SEGMENT_LITERAL)->text, '\033');
+                break;
+            case 'n':
+                Prompt_addChr(Prompt_addSegment(prompt, SEGMENT_LITERAL)->text, '\n');
+                break;
+            case 'w':
+                (void) Prompt_addSegment(prompt, SEGMENT_CWD);
+                break;
+            case 'W':
+                (void) Prompt_addSegment(prompt, SEGMENT_CWD_BASENAME);
+                break;
+            case '?':
+                (void) Prompt_addSegment(prompt, SEGMENT_EXIT_STATUS);
+                break;
+            case 'j':
+                (void) Prompt_addSegment(prompt, SEGMENT_NUM_JOBS);
+                break;
+            case '[':
+            case ']':
+                break;
+            default:
+                if (*chr >= '0' && *chr <= '7') {
+                    int code = 0;
+                    for (int i = 0; i < 3 && *chr >= '0' && *chr <= '7'; i++) {
+                        code = code * 8 + (*chr++ - '0');
+                    }
+                    chr--;
+                    if (code != 0) {
+                        Prompt_addChr(Prompt_addSegment(prompt, SEGMENT_LITERAL)->text, (char) code);
+                    }
+                } else {
+                    //Unknown escapes are kept as they are
+                    CharList *literal = Prompt_addSegment(prompt, SEGMENT_LITERAL)->text;
+                    if (*chr != '\\') {
+                        Prompt_addChr(literal, '\\');
+                    }
+                    Prompt_addChr(literal, *chr);
+                }
+                break;
+        }
+    }
+    return prompt;
+}
+
+void Prompt_free(Prompt *prompt) {
+    for (int i = 0; i < prompt->numSegments; i++) {
+        CharList_free(prompt->segments[i].text);
+    }
+    free(prompt->segments);
+    CharList_free(prompt->output);
+    free(prompt->template);
+    free(prompt);
+}
+
+char* Prompt_template(Prompt *prompt) {
+    return prompt->template;
+}
+
+/**
+ * Renders a segment if its input changed since it was last rendered
+ * Returns true if the text of the segment changed
+*/
+bool Prompt_renderSegment(Segment *segment, PromptInfo *info) {
+    unsigned long key;
+    switch (segment->type) {
+        case SEGMENT_CWD:
+        case SEGMENT_CWD_BASENAME:
+            key = info->cwdVersion;
+            break;
+        case SEGMENT_EXIT_STATUS:
+            key = (unsigned long) info->exitStatus;
+            break;
+        case SEGMENT_NUM_JOBS:
+            key = (unsigned long) info->numJobs;
+            break;
+        default:
+            return false;
+    }
+    if (segment->rendered && segment->key == key) {
+        return false;
+    }
+    segment->key = key;
+    segment->rendered = true;
+
+    CharList *text = segment->text;
+    CharList_clear(text);
+    switch (segment->type) {
+        case SEGMENT_CWD: {
+            //Show ~ instead of the home directory
+            size_t homeDirLen = info->homeDir != NULL ? strlen(info->homeDir) : 0;
+            if (homeDirLen > 0 && strncmp(info->cwd, info->homeDir, homeDirLen) == 0
+                && (!info->cwd[homeDirLen] || info->cwd[homeDirLen] == '/')
+            ) {
+                Prompt_addChr(text, '~');
+                Prompt_addStr(text, info->cwd + homeDirLen);
+            } else {
+                Prompt_addStr(text, info->cwd);
+            }
+            break;
+        }
+        case SEGMENT_CWD_BASENAME: {
+            char *lastSlash = strrchr(info->cwd, '/');
+            Prompt_addStr(text, lastSlash != NULL && lastSlash[1] ? lastSlash + 1 : info->cwd);
+            break;
+        }
+        default: {
+            char num[24];
+            snprintf(num, sizeof(num), "%d", segment->type == SEGMENT_EXIT_STATUS ? info->exitStatus : info->numJobs);
+            Prompt_addStr(text, num);
+            break;
+        }
+    }
+    return true;
+}
+
+char* Prompt_render(Prompt *prompt, PromptInfo *info) {
+    bool changed = !prompt->outputValid;
+    for (int i = 0; i < prompt->numSegments; i++) {
+        if (Prompt_renderSegment(&prompt->segments[i], info)) {
+            changed = true;
+        }
+    }
+    if (changed) {
+        CharList_clear(prompt->output);
+        for (int i = 0; i < prompt->numSegments; i++) {
+            CharList_addStr(prompt->output, prompt->segments[i].text->data);
+        }
+        prompt->outputValid = true;
+    }
+    return prompt->output->data;
+}
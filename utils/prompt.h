@@ -0,0 +1,40 @@
+#ifndef ALSH_PROMPT_
+#define ALSH_PROMPT_
+
+#include <stdbool.h>
+
+//Values that a prompt template can refer to
+typedef struct PromptInfo {
+    char *shellName;
+    char *userName;
+    char *homeDir;
+    bool isRoot;
+    char *cwd;
+    unsigned long cwdVersion; //Must change whenever cwd changes
+    int exitStatus;
+    int numJobs;
+} PromptInfo;
+
+/**
+ * A prompt template compiled into segments
+ * Supported escapes: \s shell name, \u user name, \h host name,
+ * \w working directory, \W basename of the working directory,
+ * \$ '#' if root else '$', \? exit status of the last command,
+ * \j number of background jobs, \e escape, \n newline, \nnn octal
+ * character code and \\ backslash; \[ and \] are accepted and ignored
+*/
+typedef struct Prompt Prompt;
+
+//Values that don't change during a shell session are resolved at compile time
+Prompt* Prompt_create(char *template, PromptInfo *info);
+void Prompt_free(Prompt *prompt);
+
+char* Prompt_template(Prompt *prompt);
+
+/**
+ * Renders the prompt, recomputing only the segments whose inputs changed
+ * The returned string is owned by the prompt and is valid until the next call
+*/
+char* Prompt_render(Prompt *prompt, PromptInfo *info);
+
+#endif // ALSH_PROMPT_
@@ -0,0 +1,285 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include "resourcelimits.h"
+
+#include "charlist.h"
+#include "ealloc.h"
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#ifdef __linux__
+#include <sched.h>
+#define MAX_CPUS CPU_SETSIZE
+#else
+#define MAX_CPUS 1024
+#endif
+
+struct ResourceLimits {
+    bool hasCpus;
+    bool cpus[MAX_CPUS];
+    bool hasNice;
+    int nice; //Added to the nice value of the shell
+    bool hasMem;
+    rlim_t mem; //Bytes of address space
+    bool hasNofile;
+    rlim_t nofile;
+};
+
+ResourceLimits* ResourceLimits_create(void) {
+    return ecalloc(1, sizeof(ResourceLimits));
+}
+
+ResourceLimits* ResourceLimits_copy(ResourceLimits *limits) {
+    ResourceLimits *copy = ResourceLimits_create();
+    if (limits != NULL) {
+        *copy = *limits;
+    }
+    return copy;
+}
+
+void ResourceLimits_free(ResourceLimits *limits) {
+    free(limits);
+}
+
+void ResourceLimits_clear(ResourceLimits *limits) {
+    memset(limits, 0, sizeof(ResourceLimits));
+}
+
+bool ResourceLimits_isEmpty(ResourceLimits *limits) {
+    return !limits->hasCpus && !limits->hasNice && !limits->hasMem && !limits->hasNofile;
+}
+
+static bool parseNumber(char *str, long long *num) {
+    if (!isdigit((unsigned char) *str)) {
+        return false;
+    }
+    errno = 0;
+    char *end;
+    *num = strtoll(str, &end, 10);
+    return errno == 0 && *end == '\0';
+}
+
+static bool parseCpus(char *str, bool *cpus) {
+    bool tempCpus[MAX_CPUS] = {false};
+    char *range = str;
+    while (true) {
+        char *end;
+        if (!isdigit((unsigned char) *range)) {
+            return false;
+        }
+        long first = strtol(range, &end, 10);
+        long last = first;
+        if (*end == '-') {
+            range = end + 1;
+            if (!isdigit((unsigned char) *range)) {
+                return false;
+            }
+            last = strtol(range, &end, 10);
+        }
+        if (first > last || last >= MAX_CPUS) {
+            return false;
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            tempCpus[cpu] = true;
+        }
+
+        if (*end == '\0') {
+            break;
+        }
+        if (*end != ',') {
+            return false;
+        }
+        range = end + 1;
+    }
+    memcpy(cpus, tempCpus, sizeof(tempCpus));
+    return true;
+}
+
+static bool parseSize(char *str, rlim_t *size) {
+    if (!isdigit((unsigned char) *str)) {
+        return false;
+    }
+    errno = 0;
+    char *end;
+    unsigned long long num = strtoull(str, &end, 10);
+    if (errno != 0) {
+        return false;
+    }
+
+    const char *suffixes = "KMGT";
+    char *suffix = *end != '\0' ? strchr(suffixes, toupper((unsigned char) *end)) : NULL;
+    if (suffix != NULL) {
+        for (const char *c = suffixes; c <= suffix; c++) {
+            if (num > ULLONG_MAX / 1024) {
+                return false;
+            }
+            num *= 1024;
+        }
+        end++;
+        if (toupper((unsigned char) *end) == 'B') {
+            end++;
+        }
+    }
+    if (*end != '\0' || num == 0) {
+        return false;
+    }
+    *size = (rlim_t) num;
+    return true;
+}
+
+bool ResourceLimits_set(ResourceLimits *limits, char *option, char *value) {
+    long long num;
+    if (strcmp(option, "--cpus") == 0) {
+        if (!parseCpus(value, limits->cpus)) {
+            return false;
+        }
+        limits->hasCpus = true;
+    } else if (strcmp(option, "--nice") == 0) {
+        bool negative = *value == '-';
+        if (!parseNumber(negative || *value == '+' ? value + 1 : value, &num) || num > 40) {
+            return false;
+        }
+        limits->nice = negative ? (int) -num : (int) num;
+        limits->hasNice = true;
+    } else if (strcmp(option, "--mem") == 0) {
+        if (!parseSize(value, &limits->mem)) {
+            return false;
+        }
+        limits->hasMem = true;
+    } else if (strcmp(option, "--nofile") == 0) {
+        if (!parseNumber(value, &num) || num == 0) {
+            return false;
+        }
+        limits->nofile = (rlim_t) num;
+        limits->hasNofile = true;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool ResourceLimits_isOption(char *option) {
+    return strcmp(option, "--cpus") == 0
+        || strcmp(option, "--nice") == 0
+        || strcmp(option, "--mem") == 0
+        || strcmp(option, "--nofile") == 0;
+}
+
+//Sets the soft limit, leaving the hard limit alone unless value is above it, so that the command can still raise its own limit
+static bool setLimit(int resource, rlim_t value) {
+    struct rlimit limit;
+    if (getrlimit(resource, &limit) != 0) {
+        return false;
+    }
+    limit.rlim_cur = value;
+    if (limit.rlim_max != RLIM_INFINITY && value > limit.rlim_max) {
+        limit.rlim_max = value;
+    }
+    return setrlimit(resource, &limit) == 0;
+}
+
+const char* ResourceLimits_apply(ResourceLimits *limits) {
+    if (limits->hasCpus) {
+#ifdef __linux__
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (size_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+            if (limits->cpus[cpu]) {
+                CPU_SET(cpu, &cpus);
+            }
+        }
+        if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+            return "sched_setaffinity";
+        }
+#else
+        errno = ENOSYS;
+        return "sched_setaffinity";
+#endif
+    }
+    if (limits->hasNice) {
+        //getpriority can return -1 as a valid nice value, so errno is the only way to tell that it failed
+        errno = 0;
+        int nice = getpriority(PRIO_PROCESS, 0);
+        if (errno != 0 || setpriority(PRIO_PROCESS, 0, nice + limits->nice) != 0) {
+            return "setpriority";
+        }
+    }
+    if (limits->hasMem && !setLimit(RLIMIT_AS, limits->mem)) {
+        return "setrlimit";
+    }
+    if (limits->hasNofile && !setLimit(RLIMIT_NOFILE, limits->nofile)) {
+        return "setrlimit";
+    }
+    return NULL;
+}
+
+static void appendNumber(CharList *list, unsigned long long num) {
+    char numStr[32];
+    snprintf(numStr, sizeof(numStr), "%llu", num);
+    CharList_addStr(list, numStr);
+}
+
+char* ResourceLimits_toStr(ResourceLimits *limits) {
+    CharList *list = CharList_create();
+    if (limits->hasCpus) {
+        CharList_addStr(list, " --cpus ");
+        bool first = true;
+        for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+            if (!limits->cpus[cpu]) {
+                continue;
+            }
+            int last = cpu;
+            while (last + 1 < MAX_CPUS && limits->cpus[last + 1]) {
+                last++;
+            }
+            if (!first) {
+                CharList_add(list, ',');
+            }
+            appendNumber(list, (unsigned long long) cpu);
+            if (last > cpu) {
+                CharList_add(list, '-');
+                appendNumber(list, (unsigned long long) last);
+            }
+            first = false;
+            cpu = last;
+        }
+    }
+    if (limits->hasNice) {
+        char niceStr[32];
+        snprintf(niceStr, sizeof(niceStr), " --nice %d", limits->nice);
+        CharList_addStr(list, niceStr);
+    }
+    if (limits->hasMem) {
+        CharList_addStr(list, " --mem ");
+        unsigned long long mem = (unsigned long long) limits->mem;
+        const char *suffixes = "KMGT";
+        int suffix = -1;
+        while (suffix < 3 && mem % 1024 == 0) {
+            mem /= 1024;
+            suffix++;
+        }
+        appendNumber(list, mem);
+        if (suffix >= 0) {
+            CharList_add(list, suffixes[suffix]);
+        }
+    }
+    if (limits->hasNofile) {
+        CharList_addStr(list, " --nofile ");
+        appendNumber(list, (unsigned long long) limits->nofile);
+    }
+
+    char *str = CharList_toStr(list);
+    CharList_free(list);
+    //Skip the leading space
+    if (*str != '\0') {
+        memmove(str, str + 1, strlen(str));
+    }
+    return str;
+}
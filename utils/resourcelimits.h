@@ -0,0 +1,41 @@
+#ifndef ALSH_RESOURCE_LIMITS_
+#define ALSH_RESOURCE_LIMITS_
+
+#include <stdbool.h>
+
+/**
+ * Resources that a command is allowed to use: the CPUs it runs on, its nice value,
+ * the size of its address space and the number of files it can have open
+ * They are applied by the child process between fork and exec
+*/
+typedef struct ResourceLimits ResourceLimits;
+
+ResourceLimits* ResourceLimits_create(void);
+//Returns a copy of limits, or new empty limits if limits is NULL
+ResourceLimits* ResourceLimits_copy(ResourceLimits *limits);
+void ResourceLimits_free(ResourceLimits *limits);
+void ResourceLimits_clear(ResourceLimits *limits);
+bool ResourceLimits_isEmpty(ResourceLimits *limits);
+
+/**
+ * Sets the limit of an option like --cpus from its value
+ * --cpus takes a list of CPUs like 0-3,6, --nice an increment of the nice value,
+ * --mem a size in bytes with an optional K, M, G or T suffix, and --nofile a number of files
+ *
+ * Returns false if the option or its value is invalid
+*/
+bool ResourceLimits_set(ResourceLimits *limits, char *option, char *value);
+//Returns true if option is one of the options that ResourceLimits_set accepts
+bool ResourceLimits_isOption(char *option);
+
+/**
+ * Applies the limits to the calling process, which should be a child that is about to exec
+ *
+ * Returns NULL on success, otherwise the name of the call that failed with errno set
+*/
+const char* ResourceLimits_apply(ResourceLimits *limits);
+
+//Returns the limits as options for the run builtin, which must be freed
+char* ResourceLimits_toStr(ResourceLimits *limits);
+
+#endif // ALSH_RESOURCE_LIMITS_
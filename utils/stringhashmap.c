@@ -85,14 +85,7 @@ char*** StringHashMap_entries(StringHashMap *map) {
 
 char* StringHashMap_get(StringHashMap *map, char *key) {
     unsigned long keyHash = hash(map, key);
-    StringHashMapNode *mapNode = map->buckets[keyHash];
-    if (mapNode == NULL) {
-        return NULL;
-    }
-    if (mapNode->next == NULL) {
-        return mapNode->value;
-    }
-    for (StringHashMapNode *temp = mapNode->next; temp != NULL; temp = temp->next) {
+    for (StringHashMapNode *temp = map->buckets[keyHash]; temp != NULL; temp = temp->next) {
         if (strcmp(key, temp->key) == 0) {
             return temp->value;
         }
@@ -102,17 +95,7 @@ char* StringHashMap_get(StringHashMap *map, char *key) {
 
 bool* StringHashMap_getMustBeFreed(StringHashMap *map, char *key) {
     unsigned long keyHash = hash(map, key);
-    StringHashMapNode *mapNode = map->buckets[keyHash];
-    if (mapNode == NULL) {
-        return NULL;
-    }
-    if (mapNode->next == NULL) {
-        bool *vals = emalloc(sizeof(bool) * 2);
-        vals[0] = mapNode->keyMustBeFreed;
-        vals[1] = mapNode->valueMustBeFreed;
-        return vals;
-    }
-    for (StringHashMapNode *temp = mapNode->next; temp != NULL; temp = temp->next) {
+    for (StringHashMapNode *temp = map->buckets[keyHash]; temp != NULL; temp = temp->next) {
         if (strcmp(key, temp->key) == 0) {
             bool *vals = emalloc(sizeof(bool) * 2);
             vals[0] = temp->keyMustBeFreed;
@@ -139,7 +122,14 @@ void StringHashMap_put(StringHashMap *map,
         map->buckets[keyHash] = node;
     } else if (strcmp(key, mapNode->key) != 0) {
         for (StringHashMapNode *temp = mapNode; ; temp = temp->next) {
-            if (temp->next == NULL) {
+            if (strcmp(key, temp->key) == 0) {
+                if (temp->valueMustBeFreed) {
+                    free(temp->value);
+                }
+                temp->value = value;
+                temp->valueMustBeFreed = valueMustBeFreed;
+                break;
+            } else if (temp->next == NULL) {
                 StringHashMapNode *node = emalloc(sizeof(StringHashMapNode));
                 node->key = key;
                 node->value = value;
@@ -148,13 +138,6 @@ void StringHashMap_put(StringHashMap *map,
                 node->valueMustBeFreed = valueMustBeFreed;
                 temp->next = node;
                 break;
-            } else if (strcmp(key, temp->key) == 0) {
-                if (temp->valueMustBeFreed) {
-                    free(temp->value);
-                }
-                temp->value = value;
-                temp->valueMustBeFreed = valueMustBeFreed;
-                break;
             }
         }
     } else {
@@ -168,33 +151,24 @@ void StringHashMap_put(StringHashMap *map,
 
 void StringHashMap_remove(StringHashMap *map, char *key) {
     unsigned long keyHash = hash(map, key);
-    StringHashMapNode *mapNode = map->buckets[keyHash];
-    if (mapNode == NULL) return;
-    if (mapNode->next == NULL) {
-        if (mapNode->keyMustBeFreed) {
-            free(mapNode->key);
-        }
-        if (mapNode->valueMustBeFreed) {
-            free(mapNode->value);
-        }
-        free(mapNode);
-        map->buckets[keyHash] = NULL;
-    } else {
-        StringHashMapNode *prev = mapNode;
-        for (StringHashMapNode *temp = mapNode->next; temp != NULL; temp = temp->next) {
-            if (strcmp(key, temp->key) == 0) {
+    StringHashMapNode *prev = NULL;
+    for (StringHashMapNode *temp = map->buckets[keyHash]; temp != NULL; temp = temp->next) {
+        if (strcmp(key, temp->key) == 0) {
+            if (prev == NULL) {
+                map->buckets[keyHash] = temp->next;
+            } else {
                 prev->next = temp->next;
-                if (temp->keyMustBeFreed) {
-                    free(temp->key);
-                }
-                if (temp->valueMustBeFreed) {
-                    free(temp->value);
-                }
-                free(temp);
-                break;
             }
-            prev = temp;
+            if (temp->keyMustBeFreed) {
+                free(temp->key);
+            }
+            if (temp->valueMustBeFreed) {
+                free(temp->value);
+            }
+            free(temp);
+            break;
         }
+        prev = temp;
     }
 }
 
@@ -67,6 +67,19 @@ void StringLinkedList_append(StringLinkedList *list, char *str, bool strMustBeFr
     StringLinkedList_addAt(list, list->size, str, strMustBeFreed);
 }
 
+StringNode* StringLinkedList_insertAfter(StringLinkedList *list, StringNode *node, char *str, bool strMustBeFreed) {
+    StringNode *newNode = emalloc(sizeof(StringNode));
+    newNode->str = str;
+    newNode->strMustBeFreed = strMustBeFreed;
+    newNode->next = node->next;
+    node->next = newNode;
+    if (list->tail == node) {
+        list->tail = newNode;
+    }
+    list->size++;
+    return newNode;
+}
+
 char* StringLinkedList_get(StringLinkedList *list, int index) {
     if (index < 0 || index >= list->size) {
         return NULL;
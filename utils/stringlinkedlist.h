@@ -20,6 +20,8 @@ void StringLinkedList_free(StringLinkedList *list);
 
 void StringLinkedList_addAt(StringLinkedList *list, int index, char *str, bool strMustBeFreed);
 void StringLinkedList_append(StringLinkedList *list, char *str, bool strMustBeFreed);
+//Inserts str after node in constant time and returns the new node
+StringNode* StringLinkedList_insertAfter(StringLinkedList *list, StringNode *node, char *str, bool strMustBeFreed);
 char* StringLinkedList_get(StringLinkedList *list, int index);
 int StringLinkedList_indexOf(StringLinkedList *list, char *str);
 bool StringLinkedList_contains(StringLinkedList *list, char *str);
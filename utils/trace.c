@@ -0,0 +1,189 @@
+#include "trace.h"
+
+#include "charlist.h"
+#include "ealloc.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TRACE_FLUSH_SIZE 65536
+
+typedef struct TracedChild {
+    pid_t pid;
+    long long start;
+    char *command;
+} TracedChild;
+
+bool traceEnabled = false;
+
+static CharList *buffer = NULL; //Events that haven't been written yet
+static pid_t bufferPid; //Process that the events in buffer belong to
+static TracedChild *children = NULL;
+static int childrenCapacity = 0;
+static int numChildren = 0;
+static pid_t ownerPid; //Process that started the trace
+static int traceFd = -1;
+
+static void addJsonString(CharList *list, const char *str) {
+    CharList_add(list, '"');
+    for (const unsigned char *c = (const unsigned char *) str; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            CharList_add(list, '\\');
+            CharList_add(list, (char) *c);
+        } else if (*c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", *c);
+            CharList_addStr(list, escaped);
+        } else {
+            CharList_add(list, (char) *c);
+        }
+    }
+    CharList_add(list, '"');
+}
+
+static void flush(void) {
+    size_t written = 0;
+    size_t size = (size_t) buffer->size;
+    while (written < size) {
+        ssize_t result = write(traceFd, buffer->data + written, size - written);
+        if (result <= 0) {
+            break;
+        }
+        written += (size_t) result;
+    }
+    CharList_clear(buffer);
+}
+
+//Returns the buffer for the calling process, dropping events that a forked child inherited from its parent
+static CharList* getBuffer(void) {
+    pid_t pid = getpid();
+    if (pid != bufferPid) {
+        CharList_clear(buffer);
+        for (int i = 0; i < numChildren; i++) {
+            free(children[i].command);
+        }
+        numChildren = 0;
+        bufferPid = pid;
+    }
+    return buffer;
+}
+
+static void addEvent(CharList *list, const char *name, const char *phase, pid_t pid, long long start, long long duration) {
+    char fields[128];
+    CharList_addStr(list, "{\"name\": ");
+    addJsonString(list, name);
+    snprintf(fields, sizeof(fields), ", \"ph\": \"%s\", \"ts\": %lld, \"dur\": %lld, \"pid\": %d, \"tid\": %d",
+        phase, start, duration, (int) pid, (int) pid);
+    CharList_addStr(list, fields);
+}
+
+static void endEvent(CharList *list) {
+    CharList_addStr(list, "},\n");
+    if (list->size >= TRACE_FLUSH_SIZE) {
+        flush();
+    }
+}
+
+bool Trace_start(const char *path) {
+    traceFd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (traceFd < 0) {
+        return false;
+    }
+    buffer = CharList_create();
+    ownerPid = bufferPid = getpid();
+    traceEnabled = true;
+    atexit(Trace_stop); //Forked children that exit write the events they recorded too
+
+    CharList_addStr(buffer, "[\n");
+    addEvent(buffer, "process_name", "M", ownerPid, 0, 0);
+    CharList_addStr(buffer, ", \"args\": {\"name\": \"alsh\"}");
+    endEvent(buffer);
+    flush(); //Children can append events before the shell flushes again
+    return true;
+}
+
+void Trace_stop(void) {
+    if (!traceEnabled) {
+        return;
+    }
+    CharList *list = getBuffer();
+    if (bufferPid == ownerPid) {
+        //The last event has no comma after it so that the array can be closed
+        addEvent(list, "trace_end", "i", ownerPid, Trace_now(), 0);
+        CharList_addStr(list, ", \"s\": \"g\"}\n]\n");
+    }
+    flush();
+    for (int i = 0; i < numChildren; i++) {
+        free(children[i].command);
+    }
+    free(children);
+    children = NULL;
+    childrenCapacity = numChildren = 0;
+    CharList_free(buffer);
+    buffer = NULL;
+    close(traceFd);
+    traceFd = -1;
+    traceEnabled = false;
+}
+
+long long Trace_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long) now.tv_sec * 1000000 + now.tv_nsec / 1000 + 1;
+}
+
+void Trace_span(const char *name, const char *detail, long long start) {
+    CharList *list = getBuffer();
+    addEvent(list, name, "X", bufferPid, start, Trace_now() - start);
+    if (detail != NULL) {
+        CharList_addStr(list, ", \"args\": {\"detail\": ");
+        addJsonString(list, detail);
+        CharList_add(list, '}');
+    }
+    endEvent(list);
+}
+
+void Trace_childStarted(pid_t pid, const char *command) {
+    (void) getBuffer();
+    if (numChildren == childrenCapacity) {
+        childrenCapacity = childrenCapacity > 0 ? childrenCapacity * 2 : 8;
+        children = erealloc(children, sizeof(TracedChild) * (size_t) childrenCapacity);
+    }
+    children[numChildren].pid = pid;
+    children[numChildren].start = Trace_now();
+    children[numChildren].command = strdup(command);
+    numChildren++;
+}
+
+void Trace_childExited(pid_t pid, int status) {
+    CharList *list = getBuffer();
+    for (int i = 0; i < numChildren; i++) {
+        if (children[i].pid != pid) {
+            continue;
+        }
+        TracedChild *child = &children[i];
+        addEvent(list, "process_name", "M", pid, 0, 0);
+        CharList_addStr(list, ", \"args\": {\"name\": ");
+        addJsonString(list, child->command);
+        CharList_add(list, '}');
+        endEvent(list);
+
+        char args[64];
+        addEvent(list, child->command, "X", pid, child->start, Trace_now() - child->start);
+        if (WIFEXITED(status)) {
+            snprintf(args, sizeof(args), ", \"args\": {\"exit_status\": %d}", WEXITSTATUS(status));
+        } else {
+            snprintf(args, sizeof(args), ", \"args\": {\"signal\": %d}", WIFSIGNALED(status) ? WTERMSIG(status) : 0);
+        }
+        CharList_addStr(list, args);
+        endEvent(list);
+
+        free(child->command);
+        children[i] = children[--numChildren];
+        return;
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef ALSH_TRACE_
+#define ALSH_TRACE_
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+/**
+ * Records spans of time in the trace event format, which can be opened in Perfetto or chrome://tracing
+ * Every process buffers its own events and appends them to the trace file, so spans recorded
+ * by forked children show up under their own pid
+*/
+
+extern bool traceEnabled; //Is a trace being recorded?
+
+//Starts a span named start; when tracing is off this costs only the check of traceEnabled
+#define TRACE_BEGIN(start) long long start = traceEnabled ? Trace_now() : 0
+//Records the span started by TRACE_BEGIN, with detail as an argument of the event if it isn't NULL
+#define TRACE_END(start, name, detail) do { if ((start) != 0) Trace_span(name, detail, start); } while (0)
+
+//Truncates the trace file at path and starts recording; returns false if it can't be opened
+bool Trace_start(const char *path);
+//Writes the buffered events; the process that called Trace_start also finishes the file
+void Trace_stop(void);
+
+//Microseconds on a monotonic clock shared by all processes, never 0
+long long Trace_now(void);
+void Trace_span(const char *name, const char *detail, long long start);
+
+//Child processes are shown as their own process in the trace, lasting from when they started until they were reaped
+void Trace_childStarted(pid_t pid, const char *command);
+//status is the status of the child as returned by waitpid
+void Trace_childExited(pid_t pid, int status);
+
+#endif // ALSH_TRACE_
@@ -2,6 +2,38 @@
 
 #include <string.h>
 
+int compareStrings(const void *a, const void *b) {
+    return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+void fprintJsonString(FILE *stream, const char *str) {
+    fputc('"', stream);
+    for (const unsigned char *c = (const unsigned char *) str; *c; c++) {
+        switch (*c) {
+            case '"':
+                fputs("\\\"", stream);
+                break;
+            case '\\':
+                fputs("\\\\", stream);
+                break;
+            case '\n':
+                fputs("\\n", stream);
+                break;
+            case '\t':
+                fputs("\\t", stream);
+                break;
+            default:
+                if (*c < 0x20) {
+                    fprintf(stream, "\\u%04x", *c);
+                } else {
+                    fputc(*c, stream);
+                }
+                break;
+        }
+    }
+    fputc('"', stream);
+}
+
 int numDigits(long num) {
     if (num < 0) num = -num;
     int count;
@@ -9,6 +41,12 @@ int numDigits(long num) {
     return count;
 }
 
+double secondsSince(struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) (now.tv_sec - start->tv_sec) + (double) (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
 void removeNewlineIfExists(char *str) {
     size_t len = strlen(str);
     if (len > 0 && str[len - 1] == '\n') {
@@ -2,13 +2,24 @@
 #define ALSH_UTILS_
 
 #include <stdbool.h>
+#include <stdio.h>
 #include <sys/types.h>
+#include <time.h>
 
 #define SET_FUNCTION_STATUS(ptr, val) if (ptr != NULL) *ptr = val
 
+//Compares two char* array elements with strcmp, for use with qsort
+int compareStrings(const void *a, const void *b);
+
+//Writes str to stream as a JSON string, with quotes around it and special characters escaped
+void fprintJsonString(FILE *stream, const char *str);
+
 //Returns the number of digits in a number
 int numDigits(long num);
 
+//Returns the number of seconds since start, which must be a CLOCK_MONOTONIC time
+double secondsSince(struct timespec *start);
+
 //Removes the newline character from the end of a string if it exists
 void removeNewlineIfExists(char *str);
 